@@ -14,6 +14,10 @@ void Controller::SetFPFunc(std::function<void(double)> func) {
   model_->SetFPFunc(func);
 }
 
+void Controller::SetEventChannel(std::shared_ptr<EventChannel> channel) {
+  model_->SetEventChannel(std::move(channel));
+}
+
 void Controller::SetType(int idx) {
   idx == 0 ? model_->SetType(s21::Config::ModelType::kMatrix)
            : model_->SetType(s21::Config::ModelType::kGraph);
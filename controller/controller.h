@@ -22,6 +22,7 @@ class Controller {
   void SetMFunc(std::function<void(Metrics)> func);
   void SetPFunc(std::function<void(int)> func);
   void SetFPFunc(std::function<void(double)> func);
+  void SetEventChannel(std::shared_ptr<EventChannel> channel);
 
   void SetType(int idx);
   void UpdateTopology(int hidden_num);
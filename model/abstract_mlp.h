@@ -1,10 +1,13 @@
 #ifndef MLP_MODEL_ABSTRACT_MLP_H_
 #define MLP_MODEL_ABSTRACT_MLP_H_
 
+#include <memory>
 #include <vector>
 
 namespace s21 {
 
+class Optimizer;
+
 using Vector = std::vector<double>;
 using Matrix = std::vector<Vector>;
 using Tensor = std::vector<Matrix>;
@@ -26,9 +29,11 @@ class AbstractMlp {
   virtual void SetInputLayer(const Vector &) = 0;
   virtual void ForwardPropagation() = 0;
   virtual void BackPropagation(const Vector &, double) = 0;
-  virtual Vector GetOutput() const = 0;
+  // Valid until the next forward pass; training loops read it without a copy
+  virtual const Vector &GetOutput() const = 0;
   virtual std::pair<const Tensor, const Tensor> GetMlp() const = 0;
   virtual void SetMlp(const Tensor &, const Tensor &) = 0;
+  virtual void SetOptimizer(std::shared_ptr<Optimizer>) = 0;
 };
 }  // namespace s21
 
@@ -1,9 +1,13 @@
 #ifndef MLP_MODEL_CONFIG_H_
 #define MLP_MODEL_CONFIG_H_
 
+#include <algorithm>
 #include <cstddef>
+#include <stdexcept>
 #include <vector>
 
+#include "utility/activation_functions.h"
+
 namespace s21 {
 
 /**
@@ -12,17 +16,21 @@ namespace s21 {
  *
  * The Topology class provides methods to retrieve and modify the architecture
  * of a neural network, including the number of layers, sizes of layers,
- * input and output sizes, and hidden layer sizes.
+ * input and output sizes, and hidden layer sizes. Every layer except the
+ * input one also has its own activation function, sigmoid by default.
  */
 class Topology {
  public:
-  Topology() : sizes_{784, 100, 100, 26} {}
+  Topology() : sizes_{784, 100, 100, 26}, activations_(3) {}
   explicit Topology(std::size_t hidden_num) : sizes_{784} {
     sizes_.insert(sizes_.end(), hidden_num, 100);
     sizes_.push_back(26);
+    activations_.resize(sizes_.size() - 1);
   }
-  explicit Topology(std::initializer_list<std::size_t> sizes) : sizes_{sizes} {}
-  explicit Topology(const std::vector<std::size_t>& sizes) : sizes_{sizes} {}
+  explicit Topology(std::initializer_list<std::size_t> sizes)
+      : sizes_{sizes}, activations_(sizes_.size() - 1) {}
+  explicit Topology(const std::vector<std::size_t>& sizes)
+      : sizes_{sizes}, activations_(sizes_.size() - 1) {}
 
   std::size_t GetInputSize() const { return sizes_.front(); }
   void SetInputSize(std::size_t size) { sizes_.front() = size; }
@@ -33,10 +41,54 @@ class Topology {
   std::size_t GetLayerSize(std::size_t idx) const { return sizes_[idx]; }
   void SetLayerSize(std::size_t size, std::size_t idx) { sizes_[idx] = size; }
   std::size_t GetLastHidden() const { return sizes_[sizes_.size() - 2]; }
-  void SetTopology(const std::vector<std::size_t>& sizes) { sizes_ = sizes; }
+  void SetTopology(const std::vector<std::size_t>& sizes) {
+    // New hidden layers copy the first hidden one. Without hidden layers the
+    // only entry is the output one, which may be softmax, so they use sigmoid
+    Activation hidden = Activation::kSigmoid, output = Activation::kSigmoid;
+    if (activations_.size() > 1) hidden = activations_.front();
+    if (!activations_.empty()) output = activations_.back();
+    sizes_ = sizes;
+    activations_.assign(sizes_.size() - 1, hidden);
+    activations_.back() = output;
+  }
+
+  // Activations are indexed by weight layer: idx 0 is the first hidden layer
+  // and the last one is the output layer. Softmax is allowed for the output
+  // layer only.
+  Activation GetActivation(std::size_t idx) const { return activations_[idx]; }
+  void SetActivation(Activation activation, std::size_t idx) {
+    if (activation == Activation::kSoftmax and idx + 1 != activations_.size()) {
+      throw std::invalid_argument("Softmax is only valid for the output layer");
+    }
+    activations_[idx] = activation;
+  }
+  const std::vector<Activation>& GetActivations() const {
+    return activations_;
+  }
+  void SetActivations(const std::vector<Activation>& activations) {
+    if (activations.size() != activations_.size()) return;
+    if (std::count(activations.begin(), activations.end() - 1,
+                   Activation::kSoftmax)) {
+      throw std::invalid_argument("Softmax is only valid for the output layer");
+    }
+    activations_ = activations;
+  }
+  void SetHiddenActivation(Activation activation) {
+    for (std::size_t i = 0; i + 1 < activations_.size(); ++i) {
+      SetActivation(activation, i);
+    }
+  }
+  Activation GetOutputActivation() const { return activations_.back(); }
+  void SetOutputActivation(Activation activation) {
+    activations_.back() = activation;
+  }
+  bool IsCrossEntropy() const {
+    return activations_.back() == Activation::kSoftmax;
+  }
 
  private:
   std::vector<std::size_t> sizes_;
+  std::vector<Activation> activations_;
 };
 
 /**
@@ -50,7 +102,10 @@ class Topology {
 class Config {
  public:
   enum class ModelType { kMatrix, kGraph };
-  enum class TrainType { kTrain, kCrossValidation };
+  enum class TrainType { kTrain, kCrossValidation, kHogwild, kPipeline };
+  enum class OptimizerType { kSgd, kMomentum, kNesterov, kAdam };
+  enum class Precision { kDouble, kMixed };
+  enum class Schedule { kConstant, kStep, kCosine, kPlateau };
 
   explicit Config()
       : model_type_{ModelType::kMatrix},
@@ -60,6 +115,25 @@ class Config {
         epochs_{5},
         learning_rate_{0.1},
         activate_threshold_{0.5},
+        batch_size_{1},
+        threads_{1},
+        micro_batches_{4},
+        optimizer_{OptimizerType::kSgd},
+        momentum_{0.9},
+        precision_{Precision::kDouble},
+        memory_budget_{0},
+        schedule_{Schedule::kConstant},
+        schedule_step_{10},
+        decay_{0.5},
+        validation_split_{0.0},
+        patience_{0},
+        replay_capacity_{10000},
+        replay_ratio_{1.0},
+        async_validation_{0},
+        importance_sampling_{false},
+        checkpoint_samples_{0},
+        checkpoint_seconds_{0.0},
+        seed_{0},
         verbose_{false} {}
 
   ModelType GetModelType() const { return model_type_; }
@@ -78,6 +152,67 @@ class Config {
   void SetVerbose(bool verbose) { verbose_ = verbose; }
   double GetActivateThreshold() const { return activate_threshold_; }
   void SetActivateThreshold(double thr) { activate_threshold_ = thr; }
+  std::size_t GetBatchSize() const { return batch_size_; }
+  void SetBatchSize(std::size_t size) { batch_size_ = size ? size : 1; }
+  std::size_t GetThreads() const { return threads_; }
+  void SetThreads(std::size_t threads) { threads_ = threads ? threads : 1; }
+  std::size_t GetMicroBatches() const { return micro_batches_; }
+  void SetMicroBatches(std::size_t count) {
+    micro_batches_ = count ? count : 1;
+  }
+  OptimizerType GetOptimizer() const { return optimizer_; }
+  void SetOptimizer(OptimizerType type) { optimizer_ = type; }
+  double GetMomentum() const { return momentum_; }
+  void SetMomentum(double momentum) { momentum_ = momentum; }
+  Precision GetPrecision() const { return precision_; }
+  void SetPrecision(Precision precision) { precision_ = precision; }
+  // Bytes of batch activations kept per training step, 0 for no limit
+  std::size_t GetMemoryBudget() const { return memory_budget_; }
+  void SetMemoryBudget(std::size_t bytes) { memory_budget_ = bytes; }
+  Schedule GetSchedule() const { return schedule_; }
+  void SetSchedule(Schedule schedule) { schedule_ = schedule; }
+  // Epochs between decays of the step schedule, or epochs without
+  // improvement before a decay of the plateau schedule
+  std::size_t GetScheduleStep() const { return schedule_step_; }
+  void SetScheduleStep(std::size_t epochs) {
+    schedule_step_ = epochs ? epochs : 1;
+  }
+  double GetDecay() const { return decay_; }
+  void SetDecay(double decay) { decay_ = decay; }
+  // Fraction of the train dataset held out for validation, 0 for none
+  double GetValidationSplit() const { return validation_split_; }
+  void SetValidationSplit(double split) {
+    validation_split_ = std::clamp(split, 0.0, 0.5);
+  }
+  // Epochs without validation improvement before training stops, 0 to
+  // always run every epoch
+  std::size_t GetPatience() const { return patience_; }
+  void SetPatience(std::size_t epochs) { patience_ = epochs; }
+  // Images kept for replay by online learning, and replayed images per new
+  // image in every online step
+  std::size_t GetReplayCapacity() const { return replay_capacity_; }
+  void SetReplayCapacity(std::size_t size) { replay_capacity_ = size; }
+  double GetReplayRatio() const { return replay_ratio_; }
+  void SetReplayRatio(double ratio) { replay_ratio_ = std::max(ratio, 0.0); }
+  // Epochs between snapshots evaluated on the test dataset in the background
+  // while training goes on, 0 to test only when asked
+  std::size_t GetAsyncValidation() const { return async_validation_; }
+  void SetAsyncValidation(std::size_t epochs) { async_validation_ = epochs; }
+  // Draw the samples of every epoch in proportion to their loss
+  bool GetImportanceSampling() const { return importance_sampling_; }
+  void SetImportanceSampling(bool enable) { importance_sampling_ = enable; }
+  // Samples and seconds between checkpoints of a training run, 0 for never
+  std::size_t GetCheckpointSamples() const { return checkpoint_samples_; }
+  void SetCheckpointSamples(std::size_t samples) {
+    checkpoint_samples_ = samples;
+  }
+  double GetCheckpointSeconds() const { return checkpoint_seconds_; }
+  void SetCheckpointSeconds(double seconds) {
+    checkpoint_seconds_ = std::max(seconds, 0.0);
+  }
+  // Seed of the shuffles of a training run, 0 for a random one
+  unsigned GetSeed() const { return seed_; }
+  void SetSeed(unsigned seed) { seed_ = seed; }
 
  private:
   ModelType model_type_;
@@ -87,6 +222,25 @@ class Config {
   std::size_t epochs_;
   double learning_rate_;
   double activate_threshold_;
+  std::size_t batch_size_;
+  std::size_t threads_;
+  std::size_t micro_batches_;
+  OptimizerType optimizer_;
+  double momentum_;
+  Precision precision_;
+  std::size_t memory_budget_;
+  Schedule schedule_;
+  std::size_t schedule_step_;
+  double decay_;
+  double validation_split_;
+  std::size_t patience_;
+  std::size_t replay_capacity_;
+  double replay_ratio_;
+  std::size_t async_validation_;
+  bool importance_sampling_;
+  std::size_t checkpoint_samples_;
+  double checkpoint_seconds_;
+  unsigned seed_;
   bool verbose_;
 };
 
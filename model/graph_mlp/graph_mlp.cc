@@ -2,20 +2,23 @@
 
 namespace s21 {
 
-GraphMlp::GraphMlp(const Topology& topology) {
+GraphMlp::GraphMlp(const Topology& topology)
+    : activations_{topology.GetActivations()},
+      optimizer_{std::make_shared<Sgd>()},
+      output_(topology.GetOutputSize()) {
   net_.clear();
 
   net_.emplace_back(std::make_shared<Layer>(topology.GetInputSize()));
 
   for (std::size_t i = 1; i <= topology.GetHiddenCount(); ++i) {
-    auto new_layer =
-        std::make_shared<Layer>(topology.GetLayerSize(i), net_[i - 1]);
+    auto new_layer = std::make_shared<Layer>(
+        topology.GetLayerSize(i), net_[i - 1], activations_[i - 1]);
     net_.emplace_back(new_layer);
     net_[i - 1]->SetNextLayer(new_layer);
   }
 
-  auto output_layer =
-      std::make_shared<Layer>(topology.GetOutputSize(), net_.back());
+  auto output_layer = std::make_shared<Layer>(
+      topology.GetOutputSize(), net_.back(), activations_.back());
   net_.emplace_back(output_layer);
   net_[net_.size() - 2]->SetNextLayer(output_layer);
 }
@@ -32,6 +35,12 @@ void GraphMlp::ForwardPropagation() {
   for (std::size_t i = 1; i < net_.size(); ++i) {
     net_[i]->FeedForward();
   }
+
+  auto& output_layer = net_.back()->GetLayer();
+  output_.resize(output_layer.size());
+  for (std::size_t i = 0; i < output_layer.size(); ++i) {
+    output_[i] = output_layer[i].GetValue();
+  }
 }
 
 void GraphMlp::BackPropagation(const Vector& expected, double learning_rate) {
@@ -41,20 +50,13 @@ void GraphMlp::BackPropagation(const Vector& expected, double learning_rate) {
     net_[i]->CalculateError();
   }
 
+  optimizer_->NextStep();
   for (std::size_t i = net_.size() - 1; i > 0; --i) {
-    net_[i]->UpdateWeights(learning_rate);
+    net_[i]->UpdateWeights(learning_rate, *optimizer_);
   }
 }
 
-Vector GraphMlp::GetOutput() const {
-  Vector output;
-  auto& output_layer = net_.back()->GetLayer();
-  for (std::size_t i = 0; i < output_layer.size(); ++i) {
-    output.push_back(output_layer[i].GetValue());
-  }
-
-  return output;
-}
+const Vector& GraphMlp::GetOutput() const { return output_; }
 
 std::pair<const Tensor, const Tensor> GraphMlp::GetMlp() const {
   Tensor weights, biases;
@@ -77,16 +79,20 @@ std::pair<const Tensor, const Tensor> GraphMlp::GetMlp() const {
 
 void GraphMlp::SetMlp(const Tensor& weights, const Tensor& biases) {
   net_.clear();
+  if (activations_.size() != weights.size()) {
+    activations_.assign(weights.size(), Activation::kSigmoid);
+  }
 
   net_.emplace_back(std::make_shared<Layer>(weights[0].size()));
 
   for (std::size_t i = 1; i < weights.size(); ++i) {
-    net_.emplace_back(std::make_shared<Layer>(weights[i].size(), net_[i - 1]));
+    net_.emplace_back(std::make_shared<Layer>(weights[i].size(), net_[i - 1],
+                                              activations_[i - 1]));
     net_[i - 1]->SetNextLayer(net_[i]);
   }
 
-  net_.emplace_back(
-      std::make_shared<Layer>(weights.back()[0].size(), net_.back()));
+  net_.emplace_back(std::make_shared<Layer>(
+      weights.back()[0].size(), net_.back(), activations_.back()));
   net_[net_.size() - 2]->SetNextLayer(net_.back());
 
   for (std::size_t i = 0; i < net_.size() - 1; ++i) {
@@ -98,4 +104,13 @@ void GraphMlp::SetMlp(const Tensor& weights, const Tensor& biases) {
   }
 }
 
+void GraphMlp::SetOptimizer(std::shared_ptr<Optimizer> optimizer) {
+  optimizer_ = optimizer;
+  for (auto& layer : net_) {
+    for (Neuron& neuron : layer->GetLayer()) {
+      neuron.ResetOptimizer(optimizer_->GetSlotsCount());
+    }
+  }
+}
+
 }  // namespace s21
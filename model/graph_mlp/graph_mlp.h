@@ -24,12 +24,16 @@ class GraphMlp : public AbstractMlp {
   void SetInputLayer(const Vector& input_values) override;
   void ForwardPropagation() override;
   void BackPropagation(const Vector& expected, double learning_rate) override;
-  Vector GetOutput() const override;
+  const Vector& GetOutput() const override;
   std::pair<const Tensor, const Tensor> GetMlp() const override;
   void SetMlp(const Tensor&, const Tensor&) override;
+  void SetOptimizer(std::shared_ptr<Optimizer>) override;
 
  private:
   std::vector<std::shared_ptr<Layer>> net_;
+  std::vector<Activation> activations_;
+  std::shared_ptr<Optimizer> optimizer_;
+  Vector output_;
 };
 
 }  // namespace s21
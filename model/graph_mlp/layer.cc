@@ -2,8 +2,12 @@
 
 namespace s21 {
 
-Layer::Layer(std::size_t size, std::shared_ptr<Layer> prev)
-    : layer_(size), prev_layer_(prev), next_layer_(nullptr) {
+Layer::Layer(std::size_t size, std::shared_ptr<Layer> prev,
+             Activation activation)
+    : layer_(size),
+      prev_layer_(prev),
+      next_layer_(nullptr),
+      activation_(activation) {
   for (Neuron& neuron : layer_) {
     neuron = Neuron(prev ? prev->GetSize() : 0);
   }
@@ -20,8 +24,20 @@ void Layer::SetValues(const Vector& values) {
 }
 
 void Layer::FeedForward() {
+  const Vector& prev_values = GetPrevValues();
   for (Neuron& neuron : layer_) {
-    neuron.CalculateValue(GetPrevValues());
+    neuron.CalculateValue(prev_values, activation_);
+  }
+
+  if (activation_ == Activation::kSoftmax) {
+    values_.resize(layer_.size());
+    for (std::size_t i = 0; i < layer_.size(); ++i) {
+      values_[i] = layer_[i].GetValue();
+    }
+    Softmax::Normalize(values_);
+    for (std::size_t i = 0; i < layer_.size(); ++i) {
+      layer_[i].SetValue(values_[i]);
+    }
   }
 }
 
@@ -36,20 +52,21 @@ void Layer::CalculateOutputError(const Vector& expected) {
   for (std::size_t i = 0; i < layer_.size(); ++i) {
     double value = layer_[i].GetValue();
     double target = (i == idx) ? 1.0 : 0.0;
-    layer_[i].CalculateError(target - value);
+    layer_[i].CalculateError(target - value, activation_);
   }
 }
 
 void Layer::CalculateError() {
   for (std::size_t i = 0; i < layer_.size(); ++i) {
-    layer_[i].CalculateError(ErrorSum(i));
+    layer_[i].CalculateError(ErrorSum(i), activation_);
   }
 }
 
-void Layer::UpdateWeights(double learning_rate) {
+void Layer::UpdateWeights(double learning_rate, const Optimizer& optimizer) {
   if (prev_layer_) {
+    const Vector& prev_values = GetPrevValues();
     for (Neuron& neuron : layer_) {
-      neuron.UpdateWeights(GetPrevValues(), learning_rate);
+      neuron.UpdateWeights(prev_values, learning_rate, optimizer);
     }
   }
 }
@@ -67,18 +84,20 @@ double Layer::ErrorSum(std::size_t idx) const {
   return sum;
 }
 
-Vector Layer::GetPrevValues() const {
-  Vector prev_values;
+/**
+ * Gathers the values of the previous layer into a buffer kept between calls.
+ *
+ * @return The values, valid until the next call.
+ */
+const Vector& Layer::GetPrevValues() {
+  prev_values_.clear();
   if (prev_layer_) {
-    auto& prev_layer = prev_layer_->GetLayer();
-    prev_values.reserve(prev_layer.size());
-
-    for (Neuron& neuron : prev_layer) {
-      prev_values.push_back(neuron.GetValue());
+    for (Neuron& neuron : prev_layer_->GetLayer()) {
+      prev_values_.push_back(neuron.GetValue());
     }
   }
 
-  return prev_values;
+  return prev_values_;
 }
 
 }  // namespace s21
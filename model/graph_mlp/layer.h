@@ -17,16 +17,18 @@ namespace s21 {
  */
 class Layer {
  public:
-  explicit Layer(std::size_t size, std::shared_ptr<Layer> prev = nullptr);
+  explicit Layer(std::size_t size, std::shared_ptr<Layer> prev = nullptr,
+                 Activation activation = Activation::kSigmoid);
 
   void SetValues(const Vector& values);
   void FeedForward();
   void CalculateOutputError(const Vector& expected);
   void CalculateError();
-  void UpdateWeights(double learning_rate);
+  void UpdateWeights(double learning_rate, const Optimizer& optimizer);
 
   std::vector<Neuron>& GetLayer() { return layer_; }
   std::size_t GetSize() const { return layer_.size(); }
+  Activation GetActivation() const { return activation_; }
 
   void SetNextLayer(std::shared_ptr<Layer> next) { next_layer_ = next; }
   std::shared_ptr<Layer> GetNext() { return next_layer_; }
@@ -36,9 +38,13 @@ class Layer {
   std::vector<Neuron> layer_;
   std::shared_ptr<Layer> prev_layer_;
   std::shared_ptr<Layer> next_layer_;
+  Activation activation_;
+  // Reused by every pass, so a trained layer never allocates
+  Vector prev_values_;
+  Vector values_;
 
   double ErrorSum(std::size_t idx) const;
-  Vector GetPrevValues() const;
+  const Vector& GetPrevValues();
 };
 
 }  // namespace s21
@@ -7,7 +7,7 @@ Neuron::Neuron(std::size_t prev_size)
   std::generate(weights_.begin(), weights_.end(), RandomWeight);
 }
 
-void Neuron::CalculateValue(const Vector& prev_values) {
+void Neuron::CalculateValue(const Vector& prev_values, Activation activation) {
   if (prev_values.size() != weights_.size()) {
     throw std::invalid_argument("Next size doesn't match weight size");
   }
@@ -16,23 +16,47 @@ void Neuron::CalculateValue(const Vector& prev_values) {
   for (std::size_t i = 0; i < prev_values.size(); ++i) {
     sum += prev_values[i] * weights_[i];
   }
-  value_ = ApplyActivation(sum, sigmoid);
+  value_ = DispatchActivation(activation,
+                              [sum](auto func) { return func.Apply(sum); });
 }
 
-void Neuron::CalculateError(double err) {
-  error_ = err * ApplyActivationDerivative(value_, sigmoid_derivative);
+void Neuron::CalculateError(double err, Activation activation) {
+  error_ = err * DispatchActivation(activation, [this](auto func) {
+             return func.Derivative(value_);
+           });
 }
 
-void Neuron::UpdateWeights(const Vector& prev_values, double learning_rate) {
+void Neuron::UpdateWeights(const Vector& prev_values, double learning_rate,
+                           const Optimizer& optimizer) {
   if (prev_values.size() != weights_.size()) {
     throw std::invalid_argument("Next size doesn't match weight size");
   }
+  if (weight_slots_.size() != optimizer.GetSlotsCount()) {
+    ResetOptimizer(optimizer.GetSlotsCount());
+  }
 
+  grads_.resize(weights_.size());
   for (std::size_t i = 0; i < weights_.size(); ++i) {
-    weights_[i] += learning_rate * error_ * prev_values[i];
+    grads_[i] = -error_ * prev_values[i];
+  }
+
+  double* slots[2] = {nullptr, nullptr};
+  for (std::size_t i = 0; i < weight_slots_.size(); ++i) {
+    slots[i] = weight_slots_[i].data();
   }
+  optimizer.Update(weights_.data(), grads_.data(), slots[0], slots[1],
+                   weights_.size(), learning_rate);
+
+  const double bias_grad = -error_;
+  for (std::size_t i = 0; i < bias_slots_.size(); ++i) {
+    slots[i] = &bias_slots_[i];
+  }
+  optimizer.Update(&bias_, &bias_grad, slots[0], slots[1], 1, learning_rate);
+}
 
-  bias_ += learning_rate * error_;
+void Neuron::ResetOptimizer(std::size_t slots) {
+  weight_slots_.assign(slots, Vector(weights_.size(), 0.0));
+  bias_slots_.assign(slots, 0.0);
 }
 
 }  // namespace s21
@@ -3,6 +3,7 @@
 
 #include "abstract_mlp.h"
 #include "matrix_operations.h"
+#include "optimizer.h"
 
 namespace s21 {
 
@@ -29,15 +30,22 @@ class Neuron {
   const Vector& GetWeights() const { return weights_; }
   double GetWeight(std::size_t idx) const { return weights_[idx]; }
 
-  void CalculateValue(const Vector& prev_values);
-  void CalculateError(double err);
-  void UpdateWeights(const Vector& prev_values, double learning_rate);
+  void CalculateValue(const Vector& prev_values,
+                      Activation activation = Activation::kSigmoid);
+  void CalculateError(double err,
+                      Activation activation = Activation::kSigmoid);
+  void UpdateWeights(const Vector& prev_values, double learning_rate,
+                     const Optimizer& optimizer);
+  void ResetOptimizer(std::size_t slots);
 
  private:
   double value_;
   double error_;
   double bias_;
   Vector weights_;
+  Vector grads_;
+  std::vector<Vector> weight_slots_;
+  Vector bias_slots_;
 };
 
 }  // namespace s21
@@ -0,0 +1,61 @@
+#include "async_validator.h"
+
+#include <numeric>
+
+#include "evaluator.h"
+
+namespace s21 {
+
+AsyncValidator::AsyncValidator(const Topology &topology, std::size_t threads)
+    : topology_{topology}, pool_{threads ? threads : 1} {}
+
+/**
+ * Takes a snapshot of the weights and queues its evaluation.
+ *
+ * @param epoch The number of finished epochs, reported by the metrics.
+ * @param mlp The trained model, matrix or graph.
+ * @param dataset The validation images. They must outlive the evaluation.
+ */
+void AsyncValidator::Submit(std::size_t epoch, const AbstractMlp &mlp,
+                            const Dataset &dataset) {
+  auto snapshot = std::make_shared<MatrixMlp>(topology_);
+  const auto [weights, biases] = mlp.GetMlp();
+  snapshot->SetMlp(weights, biases);
+  pending_.push_back(pool_.enqueue([this, epoch, snapshot, &dataset] {
+    return Evaluate(epoch, *snapshot, dataset);
+  }));
+}
+
+/**
+ * @param wait If true, waits for every queued evaluation.
+ * @return The metrics of the finished evaluations, oldest first. Evaluations
+ * finished after an unfinished older one are returned by a later call.
+ */
+std::vector<Metrics> AsyncValidator::Collect(bool wait) {
+  std::vector<Metrics> results;
+  while (!pending_.empty()) {
+    std::future<Metrics> &front = pending_.front();
+    if (!wait and front.wait_for(std::chrono::seconds(0)) !=
+                      std::future_status::ready) {
+      break;
+    }
+    results.push_back(front.get());
+    pending_.pop_front();
+  }
+  return results;
+}
+
+Metrics AsyncValidator::Evaluate(std::size_t epoch, const MatrixMlp &mlp,
+                                 const Dataset &dataset) const {
+  Metrics metrics{topology_.GetOutputSize()};
+  metrics.SetCrossEntropy(topology_.IsCrossEntropy());
+  metrics.StartMeasure(dataset.size());
+  std::vector<std::size_t> indices(dataset.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  AddPredictions(mlp, dataset, indices, 0, indices.size(), metrics);
+  metrics.StopMeasure();
+  metrics.SetSnapshotEpoch(epoch);
+  return metrics;
+}
+
+}  // namespace s21
@@ -0,0 +1,40 @@
+#ifndef MLP_MODEL_MATRIX_MLP_ASYNC_VALIDATOR_H_
+#define MLP_MODEL_MATRIX_MLP_ASYNC_VALIDATOR_H_
+
+#include <deque>
+
+#include "io.h"
+#include "matrix_mlp.h"
+#include "metrics.h"
+#include "thread_pool.h"
+
+namespace s21 {
+
+/**
+ * @class AsyncValidator
+ * @brief Evaluates snapshots of the weights on background threads.
+ *
+ * Submit copies the current weights into a MatrixMlp of its own, so training
+ * can go on changing the model while the snapshot is evaluated. The copy
+ * costs one pass over the weights, much less than a training epoch. Results
+ * are collected in submission order on the calling thread.
+ */
+class AsyncValidator {
+ public:
+  AsyncValidator(const Topology &, std::size_t threads);
+
+  void Submit(std::size_t epoch, const AbstractMlp &, const Dataset &);
+  std::vector<Metrics> Collect(bool wait);
+  std::size_t GetPending() const { return pending_.size(); }
+
+ private:
+  Metrics Evaluate(std::size_t, const MatrixMlp &, const Dataset &) const;
+
+  Topology topology_;
+  std::deque<std::future<Metrics>> pending_;
+  ThreadPool pool_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_ASYNC_VALIDATOR_H_
@@ -0,0 +1,89 @@
+#include "cross_validator.h"
+
+#include "optimizer.h"
+#include "replica.h"
+
+namespace s21 {
+
+CrossValidator::CrossValidator(const Topology &topology, const Config &config,
+                               std::size_t threads)
+    : topology_{topology}, config_{config}, pool_{threads ? threads : 1} {}
+
+/**
+ * Splits the dataset into the configured number of folds and trains them all.
+ *
+ * @param mlp The model every replica starts from, matrix or graph.
+ * @param dataset The training images, shared by every fold.
+ * @param func Called on the calling thread with the validation metrics of
+ * every fold, in fold order, as soon as the fold and the ones before it end.
+ * @return The validation metrics of every fold.
+ * @throws std::invalid_argument if there are fewer than 2 folds or fewer
+ * images than folds.
+ */
+std::vector<Metrics> CrossValidator::Run(const AbstractMlp &mlp,
+                                         const Dataset &dataset,
+                                         const FoldFunc &func) {
+  const std::size_t k_folds = config_.GetKFolds();
+  if (k_folds < 2 or dataset.size() < k_folds) {
+    throw std::invalid_argument("Invalid number of folds");
+  }
+  Indices shuffled(dataset.size());
+  std::iota(shuffled.begin(), shuffled.end(), 0);
+  std::shuffle(shuffled.begin(), shuffled.end(), std::default_random_engine());
+  std::vector<Indices> folds(k_folds);
+  for (std::size_t i = 0; i < shuffled.size(); ++i) {
+    folds[i % k_folds].push_back(shuffled[i]);
+  }
+
+  const auto [weights, biases] = mlp.GetMlp();
+  replicas_.clear();
+  std::vector<std::future<Metrics>> pending;
+  for (std::size_t fold = 0; fold < k_folds; ++fold) {
+    replicas_.push_back(std::make_unique<MatrixMlp>(topology_));
+    replicas_.back()->SetMlp(weights, biases);
+    replicas_.back()->SetOptimizer(MakeOptimizer(config_));
+
+    Indices train;
+    for (std::size_t i = 0; i < k_folds; ++i) {
+      if (i != fold) {
+        train.insert(train.end(), folds[i].begin(), folds[i].end());
+      }
+    }
+    pending.push_back(pool_.enqueue(
+        [this, fold, &dataset, &folds](const Indices &indices) {
+          return TrainFold(fold, dataset, indices, folds[fold]);
+        },
+        std::move(train)));
+  }
+
+  // The folds reference local index lists, so every fold must end before
+  // an error leaves this function
+  std::vector<Metrics> results;
+  try {
+    for (std::size_t fold = 0; fold < k_folds; ++fold) {
+      results.push_back(pending[fold].get());
+      func(fold, results.back());
+    }
+  } catch (...) {
+    for (auto &future : pending) {
+      if (future.valid()) future.wait();
+    }
+    throw;
+  }
+  return results;
+}
+
+Metrics CrossValidator::TrainFold(std::size_t fold, const Dataset &dataset,
+                                  const Indices &train,
+                                  const Indices &validation) {
+  MatrixMlp &replica = *replicas_[fold];
+  std::default_random_engine gen(fold);
+  Indices order = train;
+  for (std::size_t epoch = 0; epoch < config_.GetEpochs(); ++epoch) {
+    std::shuffle(order.begin(), order.end(), gen);
+    TrainReplica(replica, dataset, order, config_, 1);
+  }
+  return EvaluateReplica(replica, topology_, dataset, validation);
+}
+
+}  // namespace s21
@@ -0,0 +1,52 @@
+#ifndef MLP_MODEL_MATRIX_MLP_CROSS_VALIDATOR_H_
+#define MLP_MODEL_MATRIX_MLP_CROSS_VALIDATOR_H_
+
+#include <functional>
+#include <memory>
+
+#include "config.h"
+#include "io.h"
+#include "matrix_mlp.h"
+#include "metrics.h"
+#include "thread_pool.h"
+
+namespace s21 {
+
+/**
+ * @class CrossValidator
+ * @brief Trains the folds of a k-fold cross-validation concurrently.
+ *
+ * Every fold trains its own MatrixMlp replica, started from the same weights,
+ * on a worker of the thread pool. The replicas read the shared dataset
+ * through index lists, so no image is copied. A fold trains for the
+ * configured epochs with per-sample updates, or with single-threaded
+ * mini-batches when the batch size is larger than one, and is then tested on
+ * its held-out indices.
+ */
+class CrossValidator {
+ public:
+  using FoldFunc = std::function<void(std::size_t, const Metrics &)>;
+
+  CrossValidator(const Topology &, const Config &, std::size_t threads);
+
+  std::vector<Metrics> Run(const AbstractMlp &, const Dataset &,
+                           const FoldFunc &);
+  const MatrixMlp &GetReplica(std::size_t fold) const {
+    return *replicas_[fold];
+  }
+
+ private:
+  using Indices = std::vector<std::size_t>;
+
+  Metrics TrainFold(std::size_t, const Dataset &, const Indices &,
+                    const Indices &);
+
+  Topology topology_;
+  Config config_;
+  std::vector<std::unique_ptr<MatrixMlp>> replicas_;
+  ThreadPool pool_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_CROSS_VALIDATOR_H_
@@ -0,0 +1,155 @@
+#include "data_parallel.h"
+
+namespace s21 {
+
+DataParallel::DataParallel(MatrixMlp &mlp, std::size_t threads)
+    : mlp_{mlp},
+      replicas_(std::max<std::size_t>(threads, 1)),
+      active_{0},
+      memory_budget_{0},
+      sample_weights_{nullptr},
+      pool_{replicas_.size()} {
+  const Tensor &weights = mlp_.GetWeights();
+
+  for (Replica &replica : replicas_) {
+    replica.values.resize(weights.size() + 1);
+    replica.weight_grads = weights;
+    replica.bias_grads = mlp_.GetBiases();
+    for (Matrix &matrix : replica.weight_grads) {
+      for (Vector &row : matrix) std::fill(row.begin(), row.end(), 0.0);
+    }
+    for (Matrix &matrix : replica.bias_grads) {
+      for (Vector &row : matrix) std::fill(row.begin(), row.end(), 0.0);
+    }
+    replica.loss = 0.0;
+  }
+
+  std::size_t total = 0;
+  for (std::size_t layer = 0; layer < weights.size(); ++layer) {
+    for (std::size_t row = 0; row <= weights[layer].size(); ++row) {
+      rows_.push_back({layer, row, row == weights[layer].size()});
+      total += weights[layer][0].size();
+    }
+  }
+
+  // Split the rows into one chunk per worker with a similar number of
+  // parameters in each.
+  chunks_.push_back(0);
+  std::size_t accumulated = 0;
+  for (std::size_t i = 0; i < rows_.size(); ++i) {
+    accumulated += weights[rows_[i].layer][0].size();
+    if (accumulated * replicas_.size() >= total * chunks_.size() and
+        chunks_.size() < replicas_.size()) {
+      chunks_.push_back(i + 1);
+    }
+  }
+  chunks_.push_back(rows_.size());
+}
+
+/**
+ * Trains the MLP on a single mini-batch.
+ *
+ * @param data The dataset to take the samples from.
+ * @param indices Order in which the samples of the dataset are visited.
+ * @param begin First position of the batch in the indices (inclusive).
+ * @param end Last position of the batch in the indices (exclusive).
+ * @param learning_rate Learning rate of the update made with the mean
+ * gradient of the batch.
+ * @return The summed loss of the batch.
+ */
+double DataParallel::TrainBatch(const Dataset &data,
+                                const std::vector<std::size_t> &indices,
+                                std::size_t begin, std::size_t end,
+                                double learning_rate) {
+  const std::size_t size = end - begin;
+  active_ = std::min(replicas_.size(), size);
+  if (sample_weights_) sample_losses_.resize(indices.size());
+  checkpoints_ = mlp_.SelectCheckpoints((size + active_ - 1) / active_,
+                                        memory_budget_ / active_);
+
+  std::vector<std::future<void>> tasks;
+  for (std::size_t w = 0; w < active_; ++w) {
+    std::size_t from = begin + size * w / active_;
+    std::size_t to = begin + size * (w + 1) / active_;
+    tasks.push_back(pool_.enqueue(&DataParallel::RunShard, this,
+                                  std::ref(replicas_[w]), std::cref(data),
+                                  std::cref(indices), from, to));
+  }
+  for (auto &task : tasks) task.get();
+
+  double loss = 0.0;
+  for (std::size_t w = 0; w < active_; ++w) {
+    loss += replicas_[w].loss;
+  }
+
+  tasks.clear();
+  mlp_.GetOptimizer().NextStep();
+  const double scale = 1.0 / static_cast<double>(size);
+  for (std::size_t chunk = 0; chunk + 1 < chunks_.size(); ++chunk) {
+    tasks.push_back(pool_.enqueue(&DataParallel::ReduceChunk, this, chunk,
+                                  scale, learning_rate));
+  }
+  for (auto &task : tasks) task.get();
+
+  return loss;
+}
+
+void DataParallel::RunShard(Replica &replica, const Dataset &data,
+                            const std::vector<std::size_t> &indices,
+                            std::size_t begin, std::size_t end) {
+  Matrix &input = replica.values[0];
+  input.resize(end - begin);
+  replica.labels.resize(end - begin);
+
+  for (std::size_t i = begin; i < end; ++i) {
+    const Image &image = data[indices[i]];
+    input[i - begin] = image.GetPixels();
+    replica.labels[i - begin] = image.GetLabel();
+  }
+
+  mlp_.ForwardPropagation(replica.values, checkpoints_);
+  if (!sample_weights_) {
+    replica.loss =
+        mlp_.ComputeGradients(replica.values, checkpoints_, replica.labels,
+                              replica.weight_grads, replica.bias_grads);
+    return;
+  }
+
+  replica.scales.assign(sample_weights_->begin() + begin,
+                        sample_weights_->begin() + end);
+  replica.loss = mlp_.ComputeGradients(
+      replica.values, checkpoints_, replica.labels, replica.weight_grads,
+      replica.bias_grads, &replica.scales, &replica.losses);
+  std::copy(replica.losses.begin(), replica.losses.end(),
+            sample_losses_.begin() + begin);
+}
+
+void DataParallel::ReduceChunk(std::size_t chunk, double scale, double lr) {
+  for (std::size_t i = chunks_[chunk]; i < chunks_[chunk + 1]; ++i) {
+    const Row &row = rows_[i];
+    Vector &sum = GradientRow(replicas_[0], row);
+
+    for (std::size_t w = 1; w < active_; ++w) {
+      Vector &grad = GradientRow(replicas_[w], row);
+      for (std::size_t j = 0; j < sum.size(); ++j) {
+        sum[j] += grad[j];
+        grad[j] = 0.0;
+      }
+    }
+    for (double &value : sum) value *= scale;
+
+    if (row.bias) {
+      mlp_.UpdateBiases(row.layer, sum, lr);
+    } else {
+      mlp_.UpdateWeights(row.layer, row.row, sum, lr);
+    }
+    std::fill(sum.begin(), sum.end(), 0.0);
+  }
+}
+
+Vector &DataParallel::GradientRow(Replica &replica, const Row &row) {
+  return row.bias ? replica.bias_grads[row.layer][0]
+                  : replica.weight_grads[row.layer][row.row];
+}
+
+}  // namespace s21
@@ -0,0 +1,75 @@
+#ifndef MLP_MODEL_MATRIX_MLP_DATA_PARALLEL_H_
+#define MLP_MODEL_MATRIX_MLP_DATA_PARALLEL_H_
+
+#include "io.h"
+#include "matrix_mlp.h"
+#include "thread_pool.h"
+
+namespace s21 {
+
+/**
+ * @class DataParallel
+ * @brief Synchronous data-parallel mini-batch trainer for MatrixMlp.
+ *
+ * Every mini-batch is split into contiguous shards, one per worker of the
+ * thread pool. Each worker runs the batched forward and backward passes on its
+ * own activations and gradient buffers while sharing the weights of the MLP.
+ * The gradients are then combined by a chunked all-reduce: every worker owns a
+ * slice of the parameter rows, sums that slice over all buffers and passes
+ * the mean gradient to the optimizer of the MLP, so each parameter and its
+ * optimizer state are read and written by exactly one thread.
+ *
+ * With a memory budget, the workers keep only the activations picked by
+ * MatrixMlp::SelectCheckpoints and recompute the rest in the backward pass.
+ *
+ * With sample weights, the gradient of every sample is scaled by its weight,
+ * and the loss of every sample is kept for GetSampleLosses.
+ */
+class DataParallel {
+ public:
+  DataParallel(MatrixMlp &mlp, std::size_t threads);
+
+  double TrainBatch(const Dataset &, const std::vector<std::size_t> &,
+                    std::size_t, std::size_t, double);
+  void SetMemoryBudget(std::size_t bytes) { memory_budget_ = bytes; }
+  // Weights and losses are indexed by position in the indices of TrainBatch
+  void SetSampleWeights(const Vector *weights) { sample_weights_ = weights; }
+  const Vector &GetSampleLosses() const { return sample_losses_; }
+
+ private:
+  struct Replica {
+    Tensor values;
+    Labels labels;
+    Tensor weight_grads;
+    Tensor bias_grads;
+    Vector scales;
+    Vector losses;
+    double loss;
+  };
+
+  struct Row {
+    std::size_t layer;
+    std::size_t row;
+    bool bias;
+  };
+
+  void RunShard(Replica &, const Dataset &, const std::vector<std::size_t> &,
+                std::size_t, std::size_t);
+  void ReduceChunk(std::size_t, double, double);
+  static Vector &GradientRow(Replica &, const Row &);
+
+  MatrixMlp &mlp_;
+  std::vector<Replica> replicas_;
+  std::vector<Row> rows_;
+  std::vector<std::size_t> chunks_;
+  std::size_t active_;
+  std::size_t memory_budget_;
+  Checkpoints checkpoints_;
+  const Vector *sample_weights_;
+  Vector sample_losses_;
+  ThreadPool pool_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_DATA_PARALLEL_H_
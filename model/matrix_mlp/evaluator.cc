@@ -0,0 +1,90 @@
+#include "evaluator.h"
+
+namespace s21 {
+
+/**
+ * Adds the loss and the prediction of every image at positions [begin, end)
+ * of the indices to the metrics.
+ */
+void AddPredictions(const MatrixMlp &mlp, const Dataset &dataset,
+                    const std::vector<std::size_t> &indices, std::size_t begin,
+                    std::size_t end, Metrics &metrics) {
+  ForEachPrediction(mlp, dataset, indices, begin, end,
+                    [&](std::size_t i, const Vector &output,
+                        std::size_t predicted) {
+                      const std::size_t label = dataset[indices[i]].GetLabel();
+                      metrics.AddLoss(output, label);
+                      metrics.AddPrediction(predicted, label);
+                    });
+}
+
+Evaluator::Evaluator(std::size_t threads)
+    : threads_{threads ? threads : 1}, pool_{threads_} {}
+
+/**
+ * @param mlp The model to test. It is only read, so it must not be trained
+ * while the evaluation runs.
+ * @param topology The topology of the model.
+ * @param dataset The images to test on.
+ * @param indices Indices of the tested images.
+ * @param metrics Restarted and given the merged counts of every shard.
+ * @param progress Called on the calling thread with the percentage of the
+ * tested images every time a shard ends.
+ */
+void Evaluator::Evaluate(const MatrixMlp &mlp, const Topology &topology,
+                         const Dataset &dataset,
+                         const std::vector<std::size_t> &indices,
+                         Metrics &metrics, const ProgressFunc &progress) {
+  metrics.StartMeasure(indices.size());
+
+  const std::size_t shards_count =
+      std::max<std::size_t>(std::min(threads_, indices.size()), 1);
+  std::vector<Metrics> shards(shards_count,
+                             Metrics{topology.GetOutputSize()});
+  std::vector<std::future<void>> pending;
+  const std::size_t shard_size = indices.size() / shards_count;
+  const std::size_t remainder = indices.size() % shards_count;
+  std::size_t begin = 0;
+  for (std::size_t i = 0; i < shards_count; ++i) {
+    const std::size_t end = begin + shard_size + (i < remainder);
+    shards[i].SetCrossEntropy(metrics.IsCrossEntropy());
+    pending.push_back(pool_.enqueue(EvaluateShard, std::ref(shards[i]),
+                                    std::cref(mlp), std::cref(dataset),
+                                    std::cref(indices), begin, end));
+    begin = end;
+  }
+
+  // Every shard must end before an error leaves this function
+  std::exception_ptr error;
+  std::size_t done = 0;
+  for (std::size_t i = 0; i < shards_count; ++i) {
+    try {
+      pending[i].get();
+    } catch (...) {
+      if (!error) error = std::current_exception();
+    }
+    done += shard_size + (i < remainder);
+    if (progress and !error and !indices.empty()) {
+      progress(static_cast<int>(done * 100 / indices.size()));
+    }
+  }
+  if (error) std::rethrow_exception(error);
+
+  for (const Metrics &shard : shards) metrics.Merge(shard);
+  metrics.StopMeasure();
+}
+
+/**
+ * Counts a shard into metrics of the worker's own, which replace the shard
+ * result when the shard ends.
+ */
+void Evaluator::EvaluateShard(Metrics &shard, const MatrixMlp &mlp,
+                              const Dataset &dataset,
+                              const std::vector<std::size_t> &indices,
+                              std::size_t begin, std::size_t end) {
+  Metrics metrics{shard};
+  AddPredictions(mlp, dataset, indices, begin, end, metrics);
+  shard = std::move(metrics);
+}
+
+}  // namespace s21
@@ -0,0 +1,82 @@
+#ifndef MLP_MODEL_MATRIX_MLP_EVALUATOR_H_
+#define MLP_MODEL_MATRIX_MLP_EVALUATOR_H_
+
+#include <algorithm>
+#include <functional>
+
+#include "io.h"
+#include "matrix_mlp.h"
+#include "metrics.h"
+#include "thread_pool.h"
+
+namespace s21 {
+
+// Images per batched forward pass of the evaluations
+constexpr std::size_t kEvaluationBatch = 256;
+
+/**
+ * Runs batched forward passes over positions [begin, end) of the indices and
+ * calls func(position, output, predicted) for every image, predicted being
+ * the label (starting from 1) of the largest output.
+ */
+template <typename Func>
+void ForEachPrediction(const MatrixMlp &mlp, const Dataset &dataset,
+                       const std::vector<std::size_t> &indices,
+                       std::size_t begin, std::size_t end, Func func) {
+  Matrix batch;
+  for (std::size_t first = begin; first < end; first += kEvaluationBatch) {
+    const std::size_t last = std::min(first + kEvaluationBatch, end);
+    batch.clear();
+    for (std::size_t i = first; i < last; ++i) {
+      batch.push_back(dataset[indices[i]].GetPixels());
+    }
+    for (std::size_t layer = 0; layer < mlp.GetActivations().size();
+         ++layer) {
+      batch = mlp.ForwardLayer(layer, batch);
+    }
+    for (std::size_t i = first; i < last; ++i) {
+      const Vector &output = batch[i - first];
+      const auto it = std::max_element(output.begin(), output.end());
+      func(i, output,
+           static_cast<std::size_t>(std::distance(output.begin(), it)) + 1);
+    }
+  }
+}
+
+void AddPredictions(const MatrixMlp &, const Dataset &,
+                    const std::vector<std::size_t> &indices, std::size_t begin,
+                    std::size_t end, Metrics &);
+
+/**
+ * @class Evaluator
+ * @brief Tests a MatrixMlp on many threads with one forward pass per image.
+ *
+ * The test indices are split into one contiguous shard per worker. Every
+ * worker runs batched forward passes over its shard and takes the loss, the
+ * predicted label and the confusion counts from the same output, adding
+ * them to a Metrics local to the worker. The shard result is written once,
+ * when the shard ends, so the workers don't share counters while they run,
+ * and the results are merged at the end.
+ */
+class Evaluator {
+ public:
+  using ProgressFunc = std::function<void(int)>;
+
+  explicit Evaluator(std::size_t threads);
+
+  void Evaluate(const MatrixMlp &, const Topology &, const Dataset &,
+                const std::vector<std::size_t> &indices, Metrics &,
+                const ProgressFunc & = {});
+
+ private:
+  static void EvaluateShard(Metrics &, const MatrixMlp &, const Dataset &,
+                            const std::vector<std::size_t> &, std::size_t,
+                            std::size_t);
+
+  std::size_t threads_;
+  ThreadPool pool_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_EVALUATOR_H_
@@ -0,0 +1,55 @@
+#include "hogwild.h"
+
+namespace s21 {
+
+Hogwild::Hogwild(MatrixMlp &mlp, std::size_t threads)
+    : mlp_{mlp},
+      next_{0},
+      throughput_(std::max<std::size_t>(threads, 1), 0.0),
+      pool_{throughput_.size()} {}
+
+/**
+ * Trains the MLP for one pass over the dataset.
+ *
+ * @param data The dataset, visited in its current order.
+ * @param learning_rate Learning rate of the per-sample updates.
+ * @return The summed loss over the dataset.
+ */
+double Hogwild::Train(const Dataset &data, double learning_rate) {
+  next_ = 0;
+
+  std::vector<std::future<double>> workers;
+  for (std::size_t w = 0; w < throughput_.size(); ++w) {
+    workers.push_back(pool_.enqueue(&Hogwild::RunWorker, this, w,
+                                    std::cref(data), learning_rate));
+  }
+
+  double loss = 0.0;
+  for (auto &worker : workers) loss += worker.get();
+
+  return loss;
+}
+
+double Hogwild::RunWorker(std::size_t worker, const Dataset &data,
+                          double learning_rate) {
+  auto start = std::chrono::steady_clock::now();
+  Tensor values(mlp_.GetWeights().size() + 1);
+  values[0].resize(1);
+  std::size_t processed = 0;
+  double loss = 0.0;
+
+  for (std::size_t i = next_++; i < data.size(); i = next_++, ++processed) {
+    values[0][0] = data[i].GetPixels();
+    mlp_.ForwardPropagation(values);
+    loss += mlp_.UpdateSparse(values, data[i].GetLabel(), learning_rate);
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  throughput_[worker] =
+      elapsed.count() > 0.0 ? processed / elapsed.count() : 0.0;
+
+  return loss;
+}
+
+}  // namespace s21
@@ -0,0 +1,41 @@
+#ifndef MLP_MODEL_MATRIX_MLP_HOGWILD_H_
+#define MLP_MODEL_MATRIX_MLP_HOGWILD_H_
+
+#include <atomic>
+#include <chrono>
+
+#include "io.h"
+#include "matrix_mlp.h"
+#include "thread_pool.h"
+
+namespace s21 {
+
+/**
+ * @class Hogwild
+ * @brief Lock-free asynchronous SGD trainer for MatrixMlp.
+ *
+ * Worker threads pull samples from a shared atomic cursor over the dataset and
+ * apply sparse per-sample updates straight to the weights of the MLP without
+ * any locking. Updates of different threads rarely touch the same weights, so
+ * the occasional lost update does not hurt convergence in practice. The
+ * updates are plain SGD steps whatever optimizer the MLP is set up with.
+ */
+class Hogwild {
+ public:
+  Hogwild(MatrixMlp &mlp, std::size_t threads);
+
+  double Train(const Dataset &, double);
+  const std::vector<double> &GetThroughput() const { return throughput_; }
+
+ private:
+  double RunWorker(std::size_t, const Dataset &, double);
+
+  MatrixMlp &mlp_;
+  std::atomic<std::size_t> next_;
+  std::vector<double> throughput_;
+  ThreadPool pool_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_HOGWILD_H_
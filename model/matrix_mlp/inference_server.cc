@@ -0,0 +1,379 @@
+#include "inference_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "image.h"
+
+namespace s21 {
+
+namespace {
+
+constexpr int kBacklog = 64;
+// Time Stop gives clients to read their pending answers
+constexpr std::chrono::seconds kStopGrace{1};
+
+bool ReadAll(int fd, void *data, std::size_t size) {
+  auto *bytes = static_cast<char *>(data);
+  while (size) {
+    const ssize_t count = ::recv(fd, bytes, size, 0);
+    if (count <= 0) return false;
+    bytes += count;
+    size -= static_cast<std::size_t>(count);
+  }
+  return true;
+}
+
+bool WriteAll(int fd, const void *data, std::size_t size) {
+  const auto *bytes = static_cast<const char *>(data);
+  while (size) {
+    const ssize_t count = ::send(fd, bytes, size, MSG_NOSIGNAL);
+    if (count <= 0) return false;
+    bytes += count;
+    size -= static_cast<std::size_t>(count);
+  }
+  return true;
+}
+
+template <typename T>
+void Append(std::string &buffer, const T &value) {
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+}  // namespace
+
+/**
+ * @return The stats as a JSON object.
+ */
+std::string ServerStats::ToJson() const {
+  std::ostringstream json;
+  json.precision(10);
+  json << "{\"requests\": " << requests << ", \"images\": " << images
+       << ", \"batches\": " << batches << ", \"p50_ms\": " << p50_ms
+       << ", \"p99_ms\": " << p99_ms
+       << ", \"images_per_second\": " << images_per_second << "}";
+  return json.str();
+}
+
+InferenceServer::InferenceServer(const MatrixMlp &mlp,
+                                 const Topology &topology,
+                                 const ServerOptions &options)
+    : mlp_{mlp},
+      input_size_{topology.GetInputSize()},
+      options_{options} {
+  options_.max_batch = std::max<std::size_t>(options_.max_batch, 1);
+}
+
+InferenceServer::~InferenceServer() { Stop(); }
+
+/**
+ * Binds the endpoint and starts the accepting and batching threads.
+ *
+ * @throws std::runtime_error if the endpoint can't be bound.
+ * @throws std::logic_error if the server is already running.
+ */
+void InferenceServer::Start() {
+  if (acceptor_.joinable()) {
+    throw std::logic_error("Server already running");
+  }
+  listen_fd_ = Listen();
+  {
+    std::lock_guard<std::mutex> lock{mtx_};
+    running_ = true;
+  }
+  start_ = Clock::now();
+  batcher_ = std::thread{&InferenceServer::Batch, this};
+  acceptor_ = std::thread{&InferenceServer::Accept, this};
+}
+
+/**
+ * Stops accepting connections, closes the open ones once their pending
+ * requests are answered, and stops the batching thread. Connections whose
+ * client doesn't read its answers within kStopGrace are shut down both ways,
+ * so a blocked send fails instead of holding up Stop.
+ */
+void InferenceServer::Stop() {
+  if (!acceptor_.joinable()) return;
+  ::shutdown(listen_fd_, SHUT_RDWR);
+  acceptor_.join();
+  ::close(listen_fd_);
+  listen_fd_ = -1;
+  if (!options_.socket_path.empty()) {
+    ::unlink(options_.socket_path.c_str());
+  }
+
+  {
+    std::unique_lock<std::mutex> lock{connections_mtx_};
+    for (int fd : connections_) ::shutdown(fd, SHUT_RD);
+    auto closed = [this] { return connections_.empty(); };
+    if (!connections_cv_.wait_for(lock, kStopGrace, closed)) {
+      for (int fd : connections_) ::shutdown(fd, SHUT_RDWR);
+      connections_cv_.wait(lock, closed);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{mtx_};
+    running_ = false;
+  }
+  cv_.notify_one();
+  batcher_.join();
+}
+
+/**
+ * Queues the images of a request for the next batch. This is the in-process
+ * entry of the server; connections go through it too.
+ *
+ * @param inputs One image per row, scaled like the training images.
+ * @return The prediction, ready once the batch of the request has run.
+ * @throws std::invalid_argument if an image has the wrong size.
+ * @throws std::logic_error if the server is not running.
+ */
+std::future<Prediction> InferenceServer::Submit(Matrix inputs) {
+  for (const Vector &input : inputs) {
+    if (input.size() != input_size_) {
+      throw std::invalid_argument("Wrong input size");
+    }
+  }
+  Request request{std::move(inputs), {}, Clock::now()};
+  std::future<Prediction> future = request.promise.get_future();
+  const bool empty = request.inputs.empty();
+  {
+    std::lock_guard<std::mutex> lock{mtx_};
+    if (!running_) throw std::logic_error("Server not running");
+    if (!empty) {
+      queued_images_ += request.inputs.size();
+      queue_.push_back(std::move(request));
+    }
+  }
+  if (empty) {
+    request.promise.set_value({});
+  } else {
+    cv_.notify_one();
+  }
+  return future;
+}
+
+/**
+ * @return The counters, with the latency percentiles of the last
+ * kLatencyWindow requests and the images per second since Start.
+ */
+ServerStats InferenceServer::GetStats() const {
+  ServerStats stats;
+  std::vector<double> latencies;
+  {
+    std::lock_guard<std::mutex> lock{stats_mtx_};
+    stats.requests = requests_;
+    stats.images = images_;
+    stats.batches = batches_;
+    latencies = latencies_;
+    const std::chrono::duration<double> elapsed = Clock::now() - start_;
+    if (elapsed.count() > 0.0) {
+      stats.images_per_second = images_ / elapsed.count();
+    }
+  }
+  auto percentile = [&latencies](double rank) {
+    const auto nth = latencies.begin() + static_cast<std::ptrdiff_t>(
+                                             rank * (latencies.size() - 1));
+    std::nth_element(latencies.begin(), nth, latencies.end());
+    return *nth;
+  };
+  if (!latencies.empty()) {
+    stats.p50_ms = percentile(0.50);
+    stats.p99_ms = percentile(0.99);
+  }
+  return stats;
+}
+
+int InferenceServer::Listen() {
+  const bool unix_socket = !options_.socket_path.empty();
+  const std::string endpoint =
+      unix_socket ? options_.socket_path
+                  : "127.0.0.1:" + std::to_string(options_.port);
+  const int fd = ::socket(unix_socket ? AF_UNIX : AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) throw std::runtime_error("Failed to create socket");
+
+  int result;
+  if (unix_socket) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (endpoint.size() >= sizeof(address.sun_path)) {
+      ::close(fd);
+      throw std::runtime_error("Socket path too long: " + endpoint);
+    }
+    std::strcpy(address.sun_path, endpoint.c_str());
+    ::unlink(endpoint.c_str());
+    result = ::bind(fd, reinterpret_cast<sockaddr *>(&address),
+                    sizeof(address));
+  } else {
+    const int reuse = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(options_.port);
+    result = ::bind(fd, reinterpret_cast<sockaddr *>(&address),
+                    sizeof(address));
+    socklen_t length = sizeof(address);
+    if (result == 0) {
+      result = ::getsockname(fd, reinterpret_cast<sockaddr *>(&address),
+                             &length);
+      port_ = ntohs(address.sin_port);
+    }
+  }
+  if (result != 0 or ::listen(fd, kBacklog) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Failed to bind socket: " + endpoint);
+  }
+  return fd;
+}
+
+void InferenceServer::Accept() {
+  while (true) {
+    const int fd = ::accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR or errno == ECONNABORTED) continue;
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock{connections_mtx_};
+      connections_.push_back(fd);
+    }
+    std::thread{&InferenceServer::Serve, this, fd}.detach();
+  }
+}
+
+/**
+ * Answers the requests of a connection until the client closes it, sends a
+ * malformed request or a request fails, which closes the connection.
+ */
+void InferenceServer::Serve(int fd) {
+  std::vector<unsigned char> pixels;
+  std::string response;
+  std::uint32_t count;
+  while (ReadAll(fd, &count, sizeof(count)) and count <= kMaxImages) {
+    response.clear();
+    if (count == 0) {
+      const std::string json = GetStats().ToJson();
+      Append(response, count);
+      Append(response, static_cast<std::uint32_t>(json.size()));
+      response += json;
+    } else {
+      pixels.resize(count * input_size_);
+      if (!ReadAll(fd, pixels.data(), pixels.size())) break;
+      Matrix inputs(count, Vector(input_size_));
+      for (std::size_t i = 0; i < pixels.size(); ++i) {
+        inputs[i / input_size_][i % input_size_] =
+            pixels[i] / Image::kMaxPixel;
+      }
+      Prediction prediction;
+      try {
+        prediction = Submit(std::move(inputs)).get();
+      } catch (const std::exception &) {
+        break;
+      }
+      Append(response, count);
+      for (std::size_t i = 0; i < count; ++i) {
+        Append(response, static_cast<std::uint32_t>(prediction.labels[i]));
+        response.append(
+            reinterpret_cast<const char *>(prediction.outputs[i].data()),
+            prediction.outputs[i].size() * sizeof(double));
+      }
+    }
+    if (!WriteAll(fd, response.data(), response.size())) break;
+  }
+
+  std::lock_guard<std::mutex> lock{connections_mtx_};
+  ::close(fd);
+  connections_.erase(std::find(connections_.begin(), connections_.end(), fd));
+  connections_cv_.notify_all();
+}
+
+/**
+ * Runs the batches until Stop: waits for a request, then until the batch is
+ * full or the oldest request reaches its deadline, and takes whole requests
+ * in arrival order.
+ */
+void InferenceServer::Batch() {
+  std::vector<Request> batch;
+  std::unique_lock<std::mutex> lock{mtx_};
+  while (true) {
+    cv_.wait(lock, [this] { return !running_ or !queue_.empty(); });
+    if (queue_.empty()) return;
+    const Clock::time_point deadline =
+        queue_.front().arrival + options_.max_delay;
+    cv_.wait_until(lock, deadline, [this] {
+      return !running_ or queued_images_ >= options_.max_batch;
+    });
+
+    std::size_t images = 0;
+    while (!queue_.empty() and
+           (batch.empty() or
+            images + queue_.front().inputs.size() <= options_.max_batch)) {
+      images += queue_.front().inputs.size();
+      batch.push_back(std::move(queue_.front()));
+      queue_.pop_front();
+    }
+    queued_images_ -= images;
+    lock.unlock();
+    RunBatch(batch);
+    batch.clear();
+    lock.lock();
+  }
+}
+
+void InferenceServer::RunBatch(std::vector<Request> &batch) {
+  Matrix &inputs = values_.empty() ? values_.emplace_back() : values_[0];
+  inputs.clear();
+  for (Request &request : batch) {
+    for (Vector &input : request.inputs) inputs.push_back(std::move(input));
+  }
+  try {
+    mlp_.ForwardPropagation(values_);
+  } catch (...) {
+    for (Request &request : batch) {
+      request.promise.set_exception(std::current_exception());
+    }
+    return;
+  }
+
+  const Matrix &outputs = values_.back();
+  std::size_t row = 0;
+  for (Request &request : batch) {
+    Prediction prediction;
+    for (std::size_t i = 0; i < request.inputs.size(); ++i, ++row) {
+      const Vector &output = outputs[row];
+      prediction.labels.push_back(
+          std::max_element(output.begin(), output.end()) - output.begin() + 1);
+      prediction.outputs.push_back(output);
+    }
+    request.promise.set_value(std::move(prediction));
+  }
+
+  const Clock::time_point now = Clock::now();
+  std::lock_guard<std::mutex> lock{stats_mtx_};
+  for (const Request &request : batch) {
+    const std::chrono::duration<double, std::milli> latency =
+        now - request.arrival;
+    if (latencies_.size() < kLatencyWindow) {
+      latencies_.push_back(latency.count());
+    } else {
+      latencies_[next_latency_] = latency.count();
+    }
+    next_latency_ = (next_latency_ + 1) % kLatencyWindow;
+    ++requests_;
+  }
+  images_ += row;
+  ++batches_;
+}
+
+}  // namespace s21
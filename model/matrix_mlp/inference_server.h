@@ -0,0 +1,146 @@
+#ifndef MLP_MODEL_MATRIX_MLP_INFERENCE_SERVER_H_
+#define MLP_MODEL_MATRIX_MLP_INFERENCE_SERVER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "config.h"
+#include "matrix_mlp.h"
+
+namespace s21 {
+
+/**
+ * @struct ServerOptions
+ * @brief Endpoint and batching settings of an InferenceServer.
+ *
+ * The server listens on a Unix domain socket if socket_path is set, and on
+ * localhost TCP otherwise, port 0 picking a free port. A batch runs once it
+ * holds max_batch images or its first request has waited max_delay.
+ */
+struct ServerOptions {
+  std::string socket_path;
+  std::uint16_t port = 0;
+  std::size_t max_batch = 256;
+  std::chrono::microseconds max_delay{2000};
+};
+
+/**
+ * @struct ServerStats
+ * @brief Counters of an InferenceServer.
+ *
+ * The latency of a request runs from its arrival to its response, and its
+ * percentiles cover the last kLatencyWindow requests.
+ */
+struct ServerStats {
+  std::size_t requests = 0;
+  std::size_t images = 0;
+  std::size_t batches = 0;
+  double p50_ms = 0.0;
+  double p99_ms = 0.0;
+  double images_per_second = 0.0;
+
+  std::string ToJson() const;
+};
+
+/**
+ * @struct Prediction
+ * @brief Labels (starting from 1) and outputs of the images of a request.
+ *
+ * The outputs are those of the output layer of the network. They are class
+ * probabilities only if the output layer is softmax.
+ */
+struct Prediction {
+  std::vector<std::size_t> labels;
+  Matrix outputs;
+};
+
+/**
+ * @class InferenceServer
+ * @brief Serves predictions of a MatrixMlp over a local socket, coalescing
+ * concurrent requests into dynamic batches.
+ *
+ * Every connection is read on a thread of its own and submits its requests
+ * to a single batching thread, which runs one batched forward pass over all
+ * the requests that arrived before the deadline of the oldest one. The
+ * network is only read, so a mapped one can be shared by many servers.
+ *
+ * The protocol uses native byte order. A request is a uint32 image count
+ * followed by the raw bytes of the images, one byte per input, as in the
+ * EMNIST CSV files. Its response is the count again, then for every image a
+ * uint32 label and the double outputs of the network. A count of 0 asks
+ * for the stats: the response is a 0, a uint32 length and the stats as JSON.
+ */
+class InferenceServer {
+ public:
+  static constexpr std::size_t kLatencyWindow = 4096;
+  static constexpr std::uint32_t kMaxImages = 65536;
+
+  InferenceServer(const MatrixMlp &, const Topology &,
+                  const ServerOptions & = {});
+  InferenceServer(const InferenceServer &) = delete;
+  InferenceServer &operator=(const InferenceServer &) = delete;
+  ~InferenceServer();
+
+  void Start();
+  void Stop();
+  std::future<Prediction> Submit(Matrix inputs);
+  ServerStats GetStats() const;
+  std::uint16_t GetPort() const { return port_; }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Request {
+    Matrix inputs;
+    std::promise<Prediction> promise;
+    Clock::time_point arrival;
+  };
+
+  int Listen();
+  void Accept();
+  void Serve(int fd);
+  void Batch();
+  void RunBatch(std::vector<Request> &);
+
+  const MatrixMlp &mlp_;
+  std::size_t input_size_;
+  ServerOptions options_;
+  std::uint16_t port_ = 0;
+  int listen_fd_ = -1;
+  std::thread acceptor_;
+  std::thread batcher_;
+
+  // Pending requests, guarded by mtx_
+  std::deque<Request> queue_;
+  std::size_t queued_images_ = 0;
+  bool running_ = false;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+
+  // Open connections, guarded by connections_mtx_
+  std::vector<int> connections_;
+  std::mutex connections_mtx_;
+  std::condition_variable connections_cv_;
+
+  // Counters, guarded by stats_mtx_
+  std::size_t requests_ = 0;
+  std::size_t images_ = 0;
+  std::size_t batches_ = 0;
+  std::vector<double> latencies_;
+  std::size_t next_latency_ = 0;
+  Clock::time_point start_;
+  mutable std::mutex stats_mtx_;
+
+  // Touched by the batching thread only
+  Tensor values_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_INFERENCE_SERVER_H_
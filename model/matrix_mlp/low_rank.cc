@@ -0,0 +1,201 @@
+#include "low_rank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+#include "evaluator.h"
+
+namespace s21 {
+
+namespace {
+
+double Accuracy(const MatrixMlp &mlp, const Dataset &dataset,
+                const std::vector<std::size_t> &indices) {
+  std::size_t correct = 0;
+  ForEachPrediction(mlp, dataset, indices, 0, indices.size(),
+                    [&](std::size_t i, const Vector &, std::size_t predicted) {
+                      correct += predicted == dataset[indices[i]].GetLabel();
+                    });
+  return static_cast<double>(correct) / dataset.size();
+}
+
+}  // namespace
+
+/**
+ * Decomposes a weight matrix.
+ *
+ * @param weights The weight matrix, one row per input.
+ * @throws std::invalid_argument if the matrix is empty.
+ */
+LowRank::LowRank(const Matrix &weights) : weights_(weights) {
+  if (weights.empty() or weights[0].empty()) {
+    throw std::invalid_argument("Can't decompose an empty matrix");
+  }
+  transposed_ = weights.size() < weights[0].size();
+  const Matrix transposed = Transpose(weights);
+  Matrix gram = transposed_ ? weights * transposed : transposed * weights;
+  Matrix vectors;
+  Eigen(gram, vectors);
+
+  // Sort the eigenpairs by decreasing eigenvalue, storing the eigenvectors
+  // as rows
+  std::vector<std::size_t> order(gram.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&gram](std::size_t a, std::size_t b) {
+    return gram[a][a] > gram[b][b];
+  });
+  const Matrix columns = Transpose(vectors);
+  for (std::size_t idx : order) {
+    singular_values_.push_back(std::sqrt(std::max(gram[idx][idx], 0.0)));
+    vectors_.push_back(columns[idx]);
+  }
+}
+
+/**
+ * @return The largest rank whose factorization takes fewer multiplications
+ * than the dense matrix.
+ */
+std::size_t LowRank::GetMaxRank() const {
+  const std::size_t rows = weights_.size(), cols = weights_[0].size();
+  return (rows * cols - 1) / (rows + cols);
+}
+
+/**
+ * Truncates the decomposition to the given number of singular values.
+ *
+ * @param rank Number of kept singular values, at most min(rows, cols).
+ * @return Factors whose product is the closest matrix of that rank.
+ */
+Factorization LowRank::Truncate(std::size_t rank) const {
+  rank = std::min(rank, vectors_.size());
+  const Matrix basis(vectors_.begin(), vectors_.begin() + rank);
+  if (transposed_) {
+    return {Transpose(basis), basis * weights_};
+  }
+  return {weights_ * Transpose(basis), basis};
+}
+
+/**
+ * Diagonalizes a symmetric matrix with cyclic Jacobi rotations.
+ *
+ * @param matrix The matrix; its diagonal holds the eigenvalues on return.
+ * @param vectors Set to the eigenvectors, one per column.
+ */
+void LowRank::Eigen(Matrix &matrix, Matrix &vectors) {
+  const std::size_t size = matrix.size();
+  vectors.assign(size, Vector(size, 0.0));
+  for (std::size_t i = 0; i < size; ++i) vectors[i][i] = 1.0;
+
+  for (std::size_t sweep = 0; sweep < kMaxSweeps; ++sweep) {
+    double off = 0.0, total = 0.0;
+    for (std::size_t p = 0; p < size; ++p) {
+      for (std::size_t q = 0; q < size; ++q) {
+        const double square = matrix[p][q] * matrix[p][q];
+        total += square;
+        if (p != q) off += square;
+      }
+    }
+    if (off <= kTolerance * total) break;
+
+    for (std::size_t p = 0; p + 1 < size; ++p) {
+      for (std::size_t q = p + 1; q < size; ++q) {
+        const double apq = matrix[p][q];
+        if (apq == 0.0) continue;
+        const double theta = (matrix[q][q] - matrix[p][p]) / (2.0 * apq);
+        const double t = (theta >= 0.0 ? 1.0 : -1.0) /
+                         (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+        const double c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+        for (std::size_t k = 0; k < size; ++k) {
+          const double akp = matrix[k][p], akq = matrix[k][q];
+          matrix[k][p] = c * akp - s * akq;
+          matrix[k][q] = s * akp + c * akq;
+          const double vkp = vectors[k][p], vkq = vectors[k][q];
+          vectors[k][p] = c * vkp - s * vkq;
+          vectors[k][q] = s * vkp + c * vkq;
+        }
+        for (std::size_t k = 0; k < size; ++k) {
+          const double apk = matrix[p][k], aqk = matrix[q][k];
+          matrix[p][k] = c * apk - s * aqk;
+          matrix[q][k] = s * apk + c * aqk;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Factors the layers of a network into low-rank products, choosing for every
+ * layer the smallest rank that keeps the accuracy within the budget.
+ *
+ * Layers are compressed greedily, the largest first, each one evaluated with
+ * the ranks already chosen for the previous ones, so the final network meets
+ * the budget. A layer is left dense when no rank that saves work fits.
+ *
+ * @param mlp The network, factored in place.
+ * @param dataset The samples the accuracy is measured on.
+ * @param budget The allowed accuracy drop, as a fraction.
+ * @return The rank of every layer, 0 for dense layers.
+ * @throws std::invalid_argument if the dataset is empty or the budget is
+ * negative.
+ */
+std::vector<std::size_t> CompressLowRank(MatrixMlp &mlp,
+                                         const Dataset &dataset,
+                                         double budget) {
+  if (dataset.empty()) {
+    throw std::invalid_argument("Compression needs a non-empty dataset");
+  }
+  if (budget < 0.0) {
+    throw std::invalid_argument("Accuracy budget can't be negative");
+  }
+
+  const auto [weights, biases] = mlp.GetMlp();
+  const std::size_t layers = weights.size();
+  std::vector<Factorization> factorizations(layers);
+  auto apply = [&] {
+    mlp.SetMlp(weights, biases);
+    for (std::size_t i = 0; i < layers; ++i) {
+      if (factorizations[i].GetRank()) {
+        mlp.SetFactorization(i, factorizations[i]);
+      }
+    }
+  };
+  apply();
+  std::vector<std::size_t> indices(dataset.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  const double target = Accuracy(mlp, dataset, indices) - budget;
+
+  std::vector<std::size_t> order(layers);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&weights](std::size_t a, std::size_t b) {
+                     return weights[a].size() * weights[a][0].size() >
+                            weights[b].size() * weights[b][0].size();
+                   });
+
+  for (std::size_t layer : order) {
+    LowRank decomposition(weights[layer]);
+    std::size_t low = 1, high = decomposition.GetMaxRank(), best = 0;
+    while (low <= high) {
+      const std::size_t rank = low + (high - low) / 2;
+      mlp.SetFactorization(layer, decomposition.Truncate(rank));
+      if (Accuracy(mlp, dataset, indices) >= target) {
+        best = rank;
+        high = rank - 1;
+      } else {
+        low = rank + 1;
+      }
+    }
+    if (best) factorizations[layer] = decomposition.Truncate(best);
+    apply();
+  }
+
+  std::vector<std::size_t> ranks;
+  for (const Factorization &factorization : factorizations) {
+    ranks.push_back(factorization.GetRank());
+  }
+  return ranks;
+}
+
+}  // namespace s21
@@ -0,0 +1,43 @@
+#ifndef MLP_MODEL_MATRIX_MLP_LOW_RANK_H_
+#define MLP_MODEL_MATRIX_MLP_LOW_RANK_H_
+
+#include "io.h"
+#include "matrix_mlp.h"
+
+namespace s21 {
+
+/**
+ * @class LowRank
+ * @brief Truncated singular value decomposition of a weight matrix.
+ *
+ * The decomposition is computed once from the eigenvectors of the smaller
+ * Gram matrix, so truncating it to any rank afterwards is cheap. A factored
+ * layer costs rank * (rows + cols) multiplications per sample instead of
+ * rows * cols, so only ranks below GetMaxRank save work.
+ */
+class LowRank {
+ public:
+  explicit LowRank(const Matrix &);
+
+  const Vector &GetSingularValues() const { return singular_values_; }
+  std::size_t GetMaxRank() const;
+  Factorization Truncate(std::size_t rank) const;
+
+ private:
+  static constexpr std::size_t kMaxSweeps = 50;
+  static constexpr double kTolerance = 1e-12;
+
+  static void Eigen(Matrix &, Matrix &);
+
+  Matrix weights_;
+  Matrix vectors_;
+  Vector singular_values_;
+  bool transposed_ = false;
+};
+
+std::vector<std::size_t> CompressLowRank(MatrixMlp &, const Dataset &,
+                                         double budget);
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_LOW_RANK_H_
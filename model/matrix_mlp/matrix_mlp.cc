@@ -1,56 +1,733 @@
 #include "matrix_mlp.h"
 
+#include <type_traits>
+
+#include "model_file.h"
+
 namespace s21 {
 
+namespace {
+
+constexpr double kMinProbability = 1e-12;
+
+// Computes the error of a single output value and returns its loss: the
+// squared error, or the cross-entropy for a softmax output, whose fused
+// error is just softmax - onehot.
+template <typename F>
+double OutputError(double output, bool target, double &error) {
+  const double diff = output - (target ? 1.0 : 0.0);
+  error = diff * F::Derivative(output);
+  if constexpr (std::is_same_v<F, Softmax>) {
+    return target ? -std::log(std::max(output, kMinProbability)) : 0.0;
+  } else {
+    return diff * diff;
+  }
+}
+
+// Rows of a weight matrix, owned or in a mapped row-major block
+auto Rows(const Matrix &matrix) {
+  return [&matrix](std::size_t k) { return matrix[k].data(); };
+}
+
+auto Rows(const double *block, std::size_t cols) {
+  return [block, cols](std::size_t k) { return block + k * cols; };
+}
+
+// Adds input * weights to sums, accumulating every sum over the rows in the
+// same order as Multiplication
+template <typename RowFunc>
+void AccumulateRows(const Vector &input, RowFunc row, Vector &sums) {
+  for (std::size_t k = 0; k < input.size(); ++k) {
+    const double value = input[k];
+    const double *weights = row(k);
+    for (std::size_t j = 0; j < sums.size(); ++j) sums[j] += value * weights[j];
+  }
+}
+
+Matrix MultiplyBlock(const Matrix &input, const double *block,
+                     std::size_t cols) {
+  Matrix output(input.size(), Vector(cols));
+  for (std::size_t i = 0; i < input.size(); ++i) {
+    AccumulateRows(input[i], Rows(block, cols), output[i]);
+  }
+  return output;
+}
+
+}  // namespace
+
 MatrixMlp::MatrixMlp(const Topology &topology)
+    : MatrixMlp(topology, std::random_device{}()) {}
+
+/**
+ * Builds a network with random weights drawn from a generator of its own, so
+ * networks built on many threads at once don't share a generator and the
+ * same seed gives the same weights.
+ */
+MatrixMlp::MatrixMlp(const Topology &topology, std::uint64_t seed)
     : weights_(topology.GetLayersCount() - 1),
       biases_(topology.GetLayersCount() - 1),
-      values_(topology.GetLayersCount()) {
+      values_(topology.GetLayersCount()),
+      activations_(topology.GetActivations()),
+      factorizations_(topology.GetLayersCount() - 1) {
+  std::mt19937_64 gen(seed);
   for (std::size_t i = 0; i < topology.GetLayersCount() - 1; ++i) {
     weights_[i] =
         Matrix(topology.GetLayerSize(i), Vector(topology.GetLayerSize(i + 1)));
-    RandomizeMatrix(weights_[i]);
+    RandomizeMatrix(weights_[i], gen);
     biases_[i] = Matrix(1, Vector(topology.GetLayerSize(i + 1)));
-    RandomizeMatrix(biases_[i]);
+    RandomizeMatrix(biases_[i], gen);
   }
+  SetOptimizer(std::make_shared<Sgd>());
 }
 
+/**
+ * Builds a read-only network on the weights of a mapped model file, without
+ * copying them.
+ */
+MatrixMlp::MatrixMlp(std::shared_ptr<const ModelFile> file)
+    : values_(file->GetLayersCount() + 1),
+      activations_(file->GetTopology().GetActivations()),
+      factorizations_(file->GetLayersCount()),
+      file_{std::move(file)} {
+  SetOptimizer(std::make_shared<Sgd>());
+}
+
+/**
+ * Copies a sample into the input layer. After the first sample, the
+ * per-sample passes reuse their buffers and allocate nothing.
+ */
 void MatrixMlp::SetInputLayer(const Vector &input) {
-  values_[0] = Matrix(1, input);
+  values_[0].resize(1);
+  values_[0][0].assign(input.begin(), input.end());
 }
 
 void MatrixMlp::ForwardPropagation() {
-  for (std::size_t i = 0; i < weights_.size(); ++i) {
-    values_[i + 1] = Activate(values_[i] * weights_[i] + biases_[i], sigmoid);
+  for (std::size_t i = 0; i < activations_.size(); ++i) {
+    values_[i + 1].resize(1);
+    ForwardSample(i, values_[i][0], values_[i + 1][0]);
+    DispatchActivation(activations_[i], [&](auto func) {
+      ActivateInPlace<decltype(func)>(values_[i + 1]);
+    });
   }
 }
 
 void MatrixMlp::BackPropagation(const Vector &expected, double lr) {
-  Matrix errors =
-      MultiplyHadamard(values_.back() - Matrix(1, expected),
-                       ActivateDerivative(values_.back(), sigmoid_derivative));
+  CheckWritable();
+  const Vector &output = values_.back()[0];
+  if (expected.size() != output.size()) {
+    throw std::logic_error("Matrices have inconsistent dimensions");
+  }
+  errors_.resize(output.size());
+  DispatchActivation(activations_.back(), [&](auto func) {
+    for (std::size_t j = 0; j < output.size(); ++j) {
+      errors_[j] = (output[j] - expected[j]) * func.Derivative(output[j]);
+    }
+  });
+
+  optimizer_->NextStep();
+  for (std::size_t i = weights_.size(); i-- > 0;) {
+    const Vector &input = values_[i][0];
+    grads_.resize(errors_.size());
+    for (std::size_t row = 0; row < input.size(); ++row) {
+      for (std::size_t j = 0; j < errors_.size(); ++j) {
+        grads_[j] = input[row] * errors_[j];
+      }
+      UpdateWeights(i, row, grads_, lr);
+    }
+    UpdateBiases(i, errors_, lr);
+    if (i == 0) break;
+    PropagateErrors(i);
+  }
+}
+
+/**
+ * Runs a forward pass for a whole batch without touching the MLP's own
+ * activations, so several threads can share the same weights.
+ *
+ * @param values Activations of every layer; values[0] holds one input per row
+ * and is expected to be filled by the caller.
+ */
+void MatrixMlp::ForwardPropagation(Tensor &values) const {
+  values.resize(activations_.size() + 1);
+  for (std::size_t i = 0; i < activations_.size(); ++i) {
+    values[i + 1] = ForwardLayer(i, values[i]);
+  }
+}
+
+/**
+ * Accumulates the gradients of the loss for a batch processed by
+ * ForwardPropagation(Tensor &). Weights are left untouched.
+ *
+ * @param values Activations of every layer for the batch.
+ * @param labels Expected label (starting from 1) for every row of the batch.
+ * @param weight_grads Weight gradients, the result is added to them.
+ * @param bias_grads Bias gradients, the result is added to them.
+ * @return The summed loss of the batch.
+ */
+double MatrixMlp::ComputeGradients(const Tensor &values, const Labels &labels,
+                                   Tensor &weight_grads,
+                                   Tensor &bias_grads) const {
+  CheckWritable();
+  Matrix errors;
+  double loss = OutputErrors(values.back(), labels, errors);
 
   for (std::size_t i = weights_.size(); i-- > 0;) {
-    weights_[i] -= Transpose(values_[i]) * errors * lr;
-    biases_[i] -= errors * lr;
-    errors =
-        MultiplyHadamard(errors * Transpose(weights_[i]),
-                         ActivateDerivative(values_[i], sigmoid_derivative));
+    errors = BackwardLayer(i, values[i], errors, weight_grads[i],
+                           bias_grads[i]);
+  }
+
+  return loss;
+}
+
+/**
+ * Runs a forward pass for a whole batch keeping only the activations of the
+ * checkpointed layers and of the output layer. The other ones are recomputed
+ * by ComputeGradients(Tensor &, const Checkpoints &, ...) when needed.
+ *
+ * @param values Activations of every layer; values[0] holds one input per row
+ * and is expected to be filled by the caller.
+ * @param checkpoints Whether to keep the activations of each layer.
+ */
+void MatrixMlp::ForwardPropagation(Tensor &values,
+                                   const Checkpoints &checkpoints) const {
+  values.resize(weights_.size() + 1);
+  Matrix current;
+  const Matrix *input = &values[0];
+
+  for (std::size_t i = 0; i < weights_.size(); ++i) {
+    Matrix output = ForwardLayer(i, *input);
+    if (checkpoints[i + 1] or i + 1 == weights_.size()) {
+      values[i + 1] = std::move(output);
+      input = &values[i + 1];
+    } else {
+      values[i + 1].clear();
+      current = std::move(output);
+      input = &current;
+    }
   }
 }
 
-Vector MatrixMlp::GetOutput() const {
-  const Matrix &output_matrix = values_.back();
-  return Vector{output_matrix.front().cbegin(), output_matrix.front().cend()};
+/**
+ * Accumulates the gradients of the loss for a batch processed by
+ * ForwardPropagation(Tensor &, const Checkpoints &). Missing activations are
+ * recomputed one segment at a time from the nearest checkpoint below and
+ * released as soon as the backward pass leaves them, so at most the
+ * checkpoints and a single segment are kept at once.
+ *
+ * @param values Activations of the checkpointed layers for the batch.
+ * @param checkpoints Layers kept by the forward pass.
+ * @param labels Expected label (starting from 1) for every row of the batch.
+ * @param weight_grads Weight gradients, the result is added to them.
+ * @param bias_grads Bias gradients, the result is added to them.
+ * @param scales If not null, the weight of every sample in the gradients.
+ * @param losses If not null, receives the unweighted loss of every sample.
+ * @return The summed unweighted loss of the batch.
+ */
+double MatrixMlp::ComputeGradients(Tensor &values,
+                                   const Checkpoints &checkpoints,
+                                   const Labels &labels, Tensor &weight_grads,
+                                   Tensor &bias_grads, const Vector *scales,
+                                   Vector *losses) const {
+  CheckWritable();
+  Matrix errors;
+  double loss = OutputErrors(values.back(), labels, errors, losses);
+  if (scales) {
+    for (std::size_t i = 0; i < errors.size(); ++i) {
+      for (double &error : errors[i]) error *= (*scales)[i];
+    }
+  }
+
+  for (std::size_t i = weights_.size(); i-- > 0;) {
+    if (values[i].empty()) Recompute(values, i);
+    errors = BackwardLayer(i, values[i], errors, weight_grads[i],
+                           bias_grads[i]);
+    if (!checkpoints[i]) values[i].clear();
+  }
+
+  return loss;
+}
+
+/**
+ * Picks the layers whose activations are kept during a batched forward pass.
+ * Checkpoints are placed every few layers; the densest placement whose peak
+ * activation memory fits the budget wins, as it recomputes the least. If none
+ * fits, the placement with the lowest peak is used.
+ *
+ * @param batch Number of samples in the batch.
+ * @param budget Memory budget for the activations in bytes, 0 for no limit.
+ * @return Whether to keep each layer, the input and output are always kept.
+ */
+Checkpoints MatrixMlp::SelectCheckpoints(std::size_t batch,
+                                         std::size_t budget) const {
+  const std::size_t layers = weights_.size() + 1;
+  Checkpoints best(layers, true);
+  if (budget == 0) return best;
+
+  std::size_t best_memory = ActivationMemory(batch, best);
+  for (std::size_t stride = 1; stride < layers; ++stride) {
+    Checkpoints checkpoints(layers);
+    for (std::size_t i = 0; i < layers; ++i) {
+      checkpoints[i] = (i % stride == 0) or (i + 1 == layers);
+    }
+    std::size_t memory = ActivationMemory(batch, checkpoints);
+    if (memory <= budget) return checkpoints;
+    if (memory < best_memory) {
+      best = checkpoints;
+      best_memory = memory;
+    }
+  }
+
+  return best;
+}
+
+/**
+ * Estimates the peak memory taken by the activations of a batch: the
+ * checkpointed layers plus the largest segment recomputed between two of
+ * them.
+ *
+ * @param batch Number of samples in the batch.
+ * @param checkpoints Whether each layer is kept.
+ * @return The peak memory in bytes.
+ */
+std::size_t MatrixMlp::ActivationMemory(std::size_t batch,
+                                        const Checkpoints &checkpoints) const {
+  std::size_t stored = 0, segment = 0, max_segment = 0;
+  for (std::size_t i = 0; i < checkpoints.size(); ++i) {
+    if (checkpoints[i]) {
+      stored += LayerSize(i);
+      segment = 0;
+    } else {
+      segment += LayerSize(i);
+      max_segment = std::max(max_segment, segment);
+    }
+  }
+
+  return (stored + max_segment) * batch * sizeof(double);
+}
+
+/**
+ * Computes the activations of a single layer for a batch.
+ *
+ * @param layer Index of the weight matrix.
+ * @param input Activations of the previous layer, one sample per row.
+ * @return The activations of the next layer.
+ */
+Matrix MatrixMlp::ForwardLayer(std::size_t layer, const Matrix &input) const {
+  Matrix output = MultiplyWeights(layer, input);
+  const double *biases =
+      file_ ? file_->GetBiases(layer) : biases_[layer][0].data();
+  for (Vector &row : output) {
+    for (std::size_t j = 0; j < row.size(); ++j) row[j] += biases[j];
+  }
+  DispatchActivation(activations_[layer], [&](auto func) {
+    ActivateInPlace<decltype(func)>(output);
+  });
+  return output;
+}
+
+/**
+ * Computes the errors of the output layer for a batch.
+ *
+ * @param output Activations of the output layer, one sample per row.
+ * @param labels Expected label (starting from 1) for every row.
+ * @param errors Receives the errors of the output layer.
+ * @param losses If not null, receives the loss of every sample.
+ * @return The summed loss of the batch: the squared error, or the
+ * cross-entropy if the output layer is softmax.
+ */
+double MatrixMlp::OutputErrors(const Matrix &output, const Labels &labels,
+                               Matrix &errors, Vector *losses) const {
+  errors.assign(output.size(), Vector(output[0].size()));
+  if (losses) losses->resize(output.size());
+
+  return DispatchActivation(activations_.back(), [&](auto func) {
+    double loss = 0.0;
+    for (std::size_t i = 0; i < output.size(); ++i) {
+      double sample_loss = 0.0;
+      for (std::size_t j = 0; j < output[i].size(); ++j) {
+        sample_loss += OutputError<decltype(func)>(
+            output[i][j], j + 1 == labels[i], errors[i][j]);
+      }
+      if (losses) (*losses)[i] = sample_loss;
+      loss += sample_loss;
+    }
+    return loss;
+  });
+}
+
+/**
+ * Accumulates the gradients of a single layer and propagates its errors one
+ * layer back.
+ *
+ * @param layer Index of the weight matrix.
+ * @param input Activations the layer was fed with, one sample per row.
+ * @param errors Errors of the layer's output.
+ * @param weight_grads Weight gradients of the layer, the result is added.
+ * @param bias_grads Bias gradients of the layer, the result is added.
+ * @return The errors of the layer's input, or an empty matrix for the first
+ * layer.
+ */
+Matrix MatrixMlp::BackwardLayer(std::size_t layer, const Matrix &input,
+                                const Matrix &errors, Matrix &weight_grads,
+                                Matrix &bias_grads) const {
+  weight_grads += Transpose(input) * errors;
+  bias_grads += SumRows(errors);
+  if (layer == 0) return Matrix{};
+
+  Matrix input_errors = errors * Transpose(weights_[layer]);
+  DispatchActivation(activations_[layer - 1], [&](auto func) {
+    MultiplyDerivative<decltype(func)>(input_errors, input);
+  });
+  return input_errors;
 }
 
+/**
+ * Performs a plain SGD step for a single sample processed by
+ * ForwardPropagation(Tensor &). Weight rows whose input is zero get no update
+ * and are skipped, which makes the step sparse for the mostly blank EMNIST
+ * images. No synchronization is done: concurrent callers race on the weights
+ * on purpose, as in Hogwild training.
+ *
+ * @param values Activations of every layer for a batch of one sample.
+ * @param label Expected label of the sample (starting from 1).
+ * @param lr Learning rate.
+ * @return The loss of the sample.
+ */
+double MatrixMlp::UpdateSparse(const Tensor &values, std::size_t label,
+                               double lr) {
+  CheckWritable();
+  const Vector &output = values.back()[0];
+  Vector errors(output.size()), next_errors;
+
+  double loss = DispatchActivation(activations_.back(), [&](auto func) {
+    double sum = 0.0;
+    for (std::size_t j = 0; j < output.size(); ++j) {
+      sum += OutputError<decltype(func)>(output[j], j + 1 == label, errors[j]);
+    }
+    return sum;
+  });
+
+  for (std::size_t i = weights_.size(); i-- > 0;) {
+    const Vector &input = values[i][0];
+    Matrix &weights = weights_[i];
+
+    if (i > 0) {
+      next_errors.assign(input.size(), 0.0);
+      DispatchActivation(activations_[i - 1], [&](auto func) {
+        for (std::size_t k = 0; k < input.size(); ++k) {
+          double sum = 0.0;
+          for (std::size_t j = 0; j < errors.size(); ++j) {
+            sum += weights[k][j] * errors[j];
+          }
+          next_errors[k] = sum * func.Derivative(input[k]);
+        }
+      });
+    }
+
+    for (std::size_t k = 0; k < input.size(); ++k) {
+      if (input[k] == 0.0) continue;
+      const double step = lr * input[k];
+      for (std::size_t j = 0; j < errors.size(); ++j) {
+        weights[k][j] -= step * errors[j];
+      }
+      if (!masks_.empty()) {
+        const Vector &mask = masks_[i][k];
+        for (std::size_t j = 0; j < errors.size(); ++j) {
+          weights[k][j] *= mask[j];
+        }
+      }
+    }
+    for (std::size_t j = 0; j < errors.size(); ++j) {
+      biases_[i][0][j] -= lr * errors[j];
+    }
+
+    errors.swap(next_errors);
+  }
+
+  return loss;
+}
+
+const Vector &MatrixMlp::GetOutput() const { return values_.back().front(); }
+
+/**
+ * @return Copies of the weights and biases, read from the file if the
+ * network is mapped. Factored layers are multiplied out.
+ */
 std::pair<const Tensor, const Tensor> MatrixMlp::GetMlp() const {
-  return {weights_, biases_};
+  if (file_) return {file_->CopyWeights(), file_->CopyBiases()};
+  Tensor weights = weights_;
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    const Factorization &factorization = factorizations_[i];
+    if (factorization.GetRank()) {
+      weights[i] = factorization.left * factorization.right;
+    }
+  }
+  return {weights, biases_};
 }
 
+/**
+ * Replaces the weights and biases with copies owned by the network, which
+ * makes a mapped network trainable.
+ */
 void MatrixMlp::SetMlp(const Tensor &weights, const Tensor &biases) {
+  file_.reset();
   weights_ = weights;
   biases_ = biases;
+  values_.resize(weights_.size() + 1);
+  masks_.clear();
+  factorizations_.assign(weights_.size(), Factorization{});
+  if (activations_.size() != weights_.size()) {
+    activations_.assign(weights_.size(), Activation::kSigmoid);
+  }
+  ResetOptimizer();
+}
+
+void MatrixMlp::SetOptimizer(std::shared_ptr<Optimizer> optimizer) {
+  optimizer_ = optimizer;
+  ResetOptimizer();
+}
+
+/**
+ * Applies the optimizer to one row of a weight matrix.
+ *
+ * @param layer Index of the weight matrix.
+ * @param row Index of the row in the weight matrix.
+ * @param grads Gradient of the row.
+ * @param lr Learning rate.
+ */
+void MatrixMlp::UpdateWeights(std::size_t layer, std::size_t row,
+                              const Vector &grads, double lr) {
+  Vector &weights = weights_[layer][row];
+  optimizer_->Update(weights.data(), grads.data(),
+                     Slot(weight_slots_, 0, layer, row),
+                     Slot(weight_slots_, 1, layer, row), grads.size(), lr);
+  if (!masks_.empty()) {
+    const Vector &mask = masks_[layer][row];
+    for (std::size_t j = 0; j < weights.size(); ++j) weights[j] *= mask[j];
+  }
+}
+
+/**
+ * Applies the optimizer to the biases of a layer.
+ *
+ * @param layer Index of the layer.
+ * @param grads Gradient of the biases.
+ * @param lr Learning rate.
+ */
+void MatrixMlp::UpdateBiases(std::size_t layer, const Vector &grads,
+                             double lr) {
+  optimizer_->Update(biases_[layer][0].data(), grads.data(),
+                     Slot(bias_slots_, 0, layer, 0),
+                     Slot(bias_slots_, 1, layer, 0), grads.size(), lr);
+}
+
+/**
+ * Restores the state of the optimizer saved from a model of the same shape.
+ *
+ * @throws std::invalid_argument if the slots don't match the optimizer or
+ * the shape of the model.
+ */
+void MatrixMlp::SetOptimizerState(const std::vector<Tensor> &weight_slots,
+                                  const std::vector<Tensor> &bias_slots,
+                                  std::size_t step) {
+  CheckWritable();
+  auto same_shape = [](const Tensor &a, const Tensor &b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+      if (a[i].size() != b[i].size() or
+          (!a[i].empty() and a[i][0].size() != b[i][0].size())) {
+        return false;
+      }
+    }
+    return true;
+  };
+  const std::size_t slots = optimizer_->GetSlotsCount();
+  bool valid = weight_slots.size() == slots and bias_slots.size() == slots;
+  for (std::size_t i = 0; valid and i < slots; ++i) {
+    valid = same_shape(weight_slots[i], weights_) and
+            same_shape(bias_slots[i], biases_);
+  }
+  if (!valid) {
+    throw std::invalid_argument("Optimizer state doesn't match the model");
+  }
+  weight_slots_ = weight_slots;
+  bias_slots_ = bias_slots;
+  optimizer_->SetStep(step);
+}
+
+/**
+ * @throws std::logic_error if the network runs on mapped weights.
+ */
+void MatrixMlp::CheckWritable() const {
+  if (file_) {
+    throw std::logic_error("Mapped weights are read-only");
+  }
+}
+
+void MatrixMlp::ResetOptimizer() {
+  weight_slots_.assign(optimizer_->GetSlotsCount(), weights_);
+  bias_slots_.assign(optimizer_->GetSlotsCount(), biases_);
+  for (auto *slots : {&weight_slots_, &bias_slots_}) {
+    for (Tensor &tensor : *slots) {
+      for (Matrix &matrix : tensor) {
+        for (Vector &row : matrix) std::fill(row.begin(), row.end(), 0.0);
+      }
+    }
+  }
+}
+
+/**
+ * Rebuilds the dense weights of the factored layers from their factors and
+ * drops the factors, so the forward pass runs on the weights that training
+ * updates. The update paths never touch the factorizations, since they run
+ * on many threads at once; training calls this once, on the calling thread,
+ * before any trainer starts.
+ */
+void MatrixMlp::Densify() {
+  for (std::size_t layer = 0; layer < factorizations_.size(); ++layer) {
+    DensifyLayer(layer);
+  }
+}
+
+/**
+ * @return The factors of every layer, empty for dense layers. A mapped
+ * network copies them from its file, like GetMlp does with its weights.
+ */
+std::vector<Factorization> MatrixMlp::GetFactorizations() const {
+  if (file_) return file_->CopyFactorizations();
+  return factorizations_;
+}
+
+/**
+ * Replaces the weights of a layer with a low-rank factorization. Only the
+ * factors are kept: the dense weights and their optimizer state are released
+ * until Densify rebuilds them.
+ *
+ * @param layer Index of the weight matrix.
+ * @param factorization The factors. An empty factorization makes the layer
+ * dense again.
+ */
+void MatrixMlp::SetFactorization(std::size_t layer,
+                                 const Factorization &factorization) {
+  CheckWritable();
+  if (!factorization.GetRank()) {
+    DensifyLayer(layer);
+    return;
+  }
+  factorizations_[layer] = factorization;
+  Matrix{}.swap(weights_[layer]);
+  for (Tensor &slots : weight_slots_) Matrix{}.swap(slots[layer]);
+}
+
+void MatrixMlp::DensifyLayer(std::size_t layer) {
+  Factorization &factorization = factorizations_[layer];
+  if (!factorization.GetRank()) return;
+  weights_[layer] = factorization.left * factorization.right;
+  factorization = {};
+  const Matrix zeros(weights_[layer].size(),
+                     Vector(weights_[layer][0].size()));
+  for (Tensor &slots : weight_slots_) slots[layer] = zeros;
+}
+
+Matrix MatrixMlp::MultiplyWeights(std::size_t layer,
+                                  const Matrix &input) const {
+  if (file_) {
+    const std::size_t rank = file_->GetRank(layer);
+    const std::size_t cols = file_->GetCols(layer);
+    if (rank) {
+      return MultiplyBlock(MultiplyBlock(input, file_->GetLeft(layer), rank),
+                           file_->GetRight(layer), cols);
+    }
+    return MultiplyBlock(input, file_->GetWeights(layer), cols);
+  }
+  const Factorization &factorization = factorizations_[layer];
+  if (factorization.GetRank()) {
+    return (input * factorization.left) * factorization.right;
+  }
+  return input * weights_[layer];
+}
+
+/**
+ * Computes the weighted sums of a layer for a single sample into a reused
+ * buffer, before activation. The sums are accumulated in the same order as
+ * MultiplyWeights, so both passes give the same values.
+ *
+ * @param layer Index of the weight matrix.
+ * @param input Activations of the previous layer.
+ * @param output Receives the sums, resized to the layer.
+ */
+void MatrixMlp::ForwardSample(std::size_t layer, const Vector &input,
+                              Vector &output) {
+  const Vector *source = &input;
+  const double *biases;
+  if (file_) {
+    const std::size_t rank = file_->GetRank(layer);
+    const std::size_t cols = file_->GetCols(layer);
+    const double *weights = file_->GetWeights(layer);
+    if (rank) {
+      rank_values_.assign(rank, 0.0);
+      AccumulateRows(input, Rows(file_->GetLeft(layer), rank), rank_values_);
+      source = &rank_values_;
+      weights = file_->GetRight(layer);
+    }
+    output.assign(cols, 0.0);
+    AccumulateRows(*source, Rows(weights, cols), output);
+    biases = file_->GetBiases(layer);
+  } else {
+    const Factorization &factorization = factorizations_[layer];
+    const Matrix *weights = &weights_[layer];
+    if (factorization.GetRank()) {
+      rank_values_.assign(factorization.GetRank(), 0.0);
+      AccumulateRows(input, Rows(factorization.left), rank_values_);
+      source = &rank_values_;
+      weights = &factorization.right;
+    }
+    output.assign((*weights)[0].size(), 0.0);
+    AccumulateRows(*source, Rows(*weights), output);
+    biases = biases_[layer][0].data();
+  }
+  for (std::size_t j = 0; j < output.size(); ++j) output[j] += biases[j];
+}
+
+/**
+ * Moves the errors of a layer's output to its input, through the weights as
+ * they are after the update of the current step.
+ *
+ * @param layer Index of the weight matrix, greater than 0.
+ */
+void MatrixMlp::PropagateErrors(std::size_t layer) {
+  const Matrix &weights = weights_[layer];
+  const Vector &input = values_[layer][0];
+  next_errors_.resize(weights.size());
+  DispatchActivation(activations_[layer - 1], [&](auto func) {
+    for (std::size_t k = 0; k < weights.size(); ++k) {
+      double sum = 0.0;
+      for (std::size_t j = 0; j < errors_.size(); ++j) {
+        sum += errors_[j] * weights[k][j];
+      }
+      next_errors_[k] = sum * func.Derivative(input[k]);
+    }
+  });
+  errors_.swap(next_errors_);
+}
+
+void MatrixMlp::Recompute(Tensor &values, std::size_t layer) const {
+  std::size_t from = layer;
+  while (values[from].empty()) --from;
+  for (; from < layer; ++from) {
+    values[from + 1] = ForwardLayer(from, values[from]);
+  }
+}
+
+std::size_t MatrixMlp::LayerSize(std::size_t layer) const {
+  if (layer) return biases_[layer - 1][0].size();
+  return factorizations_[0].GetRank() ? factorizations_[0].left.size()
+                                      : weights_[0].size();
+}
+
+double *MatrixMlp::Slot(std::vector<Tensor> &slots, std::size_t slot,
+                        std::size_t layer, std::size_t row) {
+  return slot < slots.size() ? slots[slot][layer][row].data() : nullptr;
 }
 
 }  // namespace s21
@@ -1,12 +1,33 @@
 #ifndef MLP_MODEL_MATRIX_MLP_MATRIX_MLP_H_
 #define MLP_MODEL_MATRIX_MLP_MATRIX_MLP_H_
 
+#include <cstdint>
+
 #include "abstract_mlp.h"
 #include "config.h"
 #include "matrix_operations.h"
+#include "optimizer.h"
 
 namespace s21 {
 
+using Labels = std::vector<std::size_t>;
+using Checkpoints = std::vector<bool>;
+
+class ModelFile;
+
+/**
+ * @struct Factorization
+ * @brief Low-rank factorization of a weight matrix: weights = left * right.
+ *
+ * An empty factorization means the layer is dense.
+ */
+struct Factorization {
+  Matrix left;
+  Matrix right;
+
+  std::size_t GetRank() const { return right.size(); }
+};
+
 /**
  * @class MatrixMlp
  * @brief Implementation of Multi-Layer Perceptron (MLP) in matrix form.
@@ -16,22 +37,98 @@ namespace s21 {
  * inherits from the AbstractMlp interface and provides methods for setting
  * input layers, performing forward and backward propagations, and accessing MLP
  * parameters.
+ *
+ * A MatrixMlp built from a ModelFile runs inference straight on the mapped,
+ * read-only weight blocks and holds no copy of them, so every process
+ * mapping the same file shares one copy of the weights. Such a network can't
+ * be trained until SetMlp gives it weights of its own.
  */
 class MatrixMlp : public AbstractMlp {
  public:
   explicit MatrixMlp(const Topology &);
+  MatrixMlp(const Topology &, std::uint64_t seed);
+  explicit MatrixMlp(std::shared_ptr<const ModelFile>);
 
   void SetInputLayer(const Vector &) override;
   void ForwardPropagation() override;
   void BackPropagation(const Vector &, double) override;
-  Vector GetOutput() const override;
+  const Vector &GetOutput() const override;
   std::pair<const Tensor, const Tensor> GetMlp() const override;
   void SetMlp(const Tensor &, const Tensor &) override;
+  void SetOptimizer(std::shared_ptr<Optimizer>) override;
+
+  void ForwardPropagation(Tensor &) const;
+  double ComputeGradients(const Tensor &, const Labels &, Tensor &,
+                          Tensor &) const;
+  double UpdateSparse(const Tensor &, std::size_t, double);
+
+  void ForwardPropagation(Tensor &, const Checkpoints &) const;
+  double ComputeGradients(Tensor &, const Checkpoints &, const Labels &,
+                          Tensor &, Tensor &, const Vector *scales = nullptr,
+                          Vector *losses = nullptr) const;
+  Checkpoints SelectCheckpoints(std::size_t, std::size_t) const;
+  std::size_t ActivationMemory(std::size_t, const Checkpoints &) const;
+
+  Matrix ForwardLayer(std::size_t, const Matrix &) const;
+  double OutputErrors(const Matrix &, const Labels &, Matrix &,
+                      Vector *losses = nullptr) const;
+  Matrix BackwardLayer(std::size_t, const Matrix &, const Matrix &, Matrix &,
+                       Matrix &) const;
+
+  void UpdateWeights(std::size_t, std::size_t, const Vector &, double);
+  void UpdateBiases(std::size_t, const Vector &, double);
+
+  const std::vector<Activation> &GetActivations() const {
+    return activations_;
+  }
+  // Layers with a factorization keep only their factors and run their
+  // forward pass as two thin GEMMs. Training needs dense layers, see Densify.
+  std::vector<Factorization> GetFactorizations() const;
+  void SetFactorization(std::size_t, const Factorization &);
+  void Densify();
+
+  // Masks of pruned weights: weights whose mask is 0 stay zero in training.
+  // They are dropped by SetMlp.
+  const Tensor &GetMasks() const { return masks_; }
+  void SetMasks(const Tensor &masks) { masks_ = masks; }
+  Tensor &GetWeights() { return weights_; }
+  Tensor &GetBiases() { return biases_; }
+  Optimizer &GetOptimizer() { return *optimizer_; }
+  // Per-parameter optimizer state, shaped like the weights and biases
+  const std::vector<Tensor> &GetWeightSlots() const { return weight_slots_; }
+  const std::vector<Tensor> &GetBiasSlots() const { return bias_slots_; }
+  void SetOptimizerState(const std::vector<Tensor> &,
+                         const std::vector<Tensor> &, std::size_t step);
+  bool IsMapped() const { return file_ != nullptr; }
 
  private:
+  void CheckWritable() const;
+  void ResetOptimizer();
+  void DensifyLayer(std::size_t);
+  void Recompute(Tensor &, std::size_t) const;
+  Matrix MultiplyWeights(std::size_t, const Matrix &) const;
+  void ForwardSample(std::size_t, const Vector &, Vector &);
+  void PropagateErrors(std::size_t);
+  std::size_t LayerSize(std::size_t) const;
+  static double *Slot(std::vector<Tensor> &, std::size_t, std::size_t,
+                      std::size_t);
+
   Tensor weights_;
   Tensor biases_;
   Tensor values_;
+  std::vector<Activation> activations_;
+  Tensor masks_;
+  std::vector<Factorization> factorizations_;
+  std::shared_ptr<Optimizer> optimizer_;
+  std::vector<Tensor> weight_slots_;
+  std::vector<Tensor> bias_slots_;
+  // Buffers of the per-sample passes, sized by the first sample
+  Vector rank_values_;
+  Vector errors_;
+  Vector next_errors_;
+  Vector grads_;
+  // Mapped weights of a read-only network, null if it owns its weights
+  std::shared_ptr<const ModelFile> file_;
 };
 }  // namespace s21
 
@@ -0,0 +1,255 @@
+#include "mixed_precision.h"
+
+#include <limits>
+#include <type_traits>
+
+namespace s21 {
+
+namespace {
+
+using FloatVector = MixedPrecision::FloatVector;
+using FloatMatrix = MixedPrecision::FloatMatrix;
+
+// result = m1 * m2. Zero elements of m1, common in the inputs, are skipped.
+void Multiply(const FloatMatrix &m1, const FloatMatrix &m2,
+              FloatMatrix &result) {
+  result.assign(m1.size(), FloatVector(m2[0].size(), 0.0f));
+  for (std::size_t i = 0; i < m1.size(); ++i) {
+    FloatVector &row_result = result[i];
+    for (std::size_t k = 0; k < m2.size(); ++k) {
+      const float value = m1[i][k];
+      if (value == 0.0f) continue;
+      const FloatVector &row_m2 = m2[k];
+      for (std::size_t j = 0; j < row_m2.size(); ++j) {
+        row_result[j] += value * row_m2[j];
+      }
+    }
+  }
+}
+
+// result += transpose(m1) * m2
+void AddTransposedProduct(const FloatMatrix &m1, const FloatMatrix &m2,
+                          FloatMatrix &result) {
+  for (std::size_t i = 0; i < m1.size(); ++i) {
+    const FloatVector &row_m2 = m2[i];
+    for (std::size_t k = 0; k < m1[i].size(); ++k) {
+      const float value = m1[i][k];
+      if (value == 0.0f) continue;
+      FloatVector &row_result = result[k];
+      for (std::size_t j = 0; j < row_m2.size(); ++j) {
+        row_result[j] += value * row_m2[j];
+      }
+    }
+  }
+}
+
+// result = m1 * transpose(m2)
+void MultiplyTransposed(const FloatMatrix &m1, const FloatMatrix &m2,
+                        FloatMatrix &result) {
+  result.assign(m1.size(), FloatVector(m2.size()));
+  for (std::size_t i = 0; i < m1.size(); ++i) {
+    for (std::size_t k = 0; k < m2.size(); ++k) {
+      float sum = 0.0f;
+      for (std::size_t j = 0; j < m2[k].size(); ++j) {
+        sum += m1[i][j] * m2[k][j];
+      }
+      result[i][k] = sum;
+    }
+  }
+}
+
+template <typename From, typename To>
+void Cast(const std::vector<std::vector<From>> &from,
+          std::vector<std::vector<To>> &to) {
+  to.resize(from.size());
+  for (std::size_t i = 0; i < from.size(); ++i) {
+    to[i].assign(from[i].begin(), from[i].end());
+  }
+}
+
+}  // namespace
+
+MixedPrecision::MixedPrecision(MatrixMlp &mlp, double loss_scale)
+    : mlp_{mlp},
+      values_(mlp.GetWeights().size() + 1),
+      master_weight_grads_{mlp.GetWeights()},
+      master_bias_grads_{mlp.GetBiases()},
+      loss_scale_{loss_scale},
+      good_steps_{0},
+      skipped_{0} {
+  CastWeights();
+  weight_grads_ = weights_;
+  bias_grads_ = biases_;
+  for (auto *grads : {&weight_grads_, &bias_grads_}) {
+    for (FloatMatrix &matrix : *grads) {
+      for (FloatVector &row : matrix) std::fill(row.begin(), row.end(), 0.0f);
+    }
+  }
+}
+
+/**
+ * Continues the loss scaling of a resumed run.
+ *
+ * @param loss_scale The loss scale of the next batch.
+ * @param good_steps The successful batches since the scale last grew.
+ */
+void MixedPrecision::Restore(double loss_scale, std::size_t good_steps) {
+  loss_scale_ = loss_scale;
+  good_steps_ = good_steps;
+}
+
+/**
+ * Trains the MLP on a single mini-batch with float forward and backward
+ * passes and a double precision update of the master weights.
+ *
+ * @param data The dataset to take the samples from.
+ * @param indices Order in which the samples of the dataset are visited.
+ * @param begin First position of the batch in the indices (inclusive).
+ * @param end Last position of the batch in the indices (exclusive).
+ * @param learning_rate Learning rate of the update made with the mean
+ * gradient of the batch.
+ * @return The summed loss of the batch.
+ */
+double MixedPrecision::TrainBatch(const Dataset &data,
+                                  const std::vector<std::size_t> &indices,
+                                  std::size_t begin, std::size_t end,
+                                  double learning_rate) {
+  const std::size_t size = end - begin;
+  const std::vector<Activation> &activations = mlp_.GetActivations();
+
+  values_[0].resize(size);
+  labels_.resize(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    const Image &image = data[indices[begin + i]];
+    const Vector &pixels = image.GetPixels();
+    values_[0][i].assign(pixels.begin(), pixels.end());
+    labels_[i] = image.GetLabel();
+  }
+
+  for (std::size_t layer = 0; layer < weights_.size(); ++layer) {
+    FloatMatrix &output = values_[layer + 1];
+    const FloatVector &biases = biases_[layer][0];
+    Multiply(values_[layer], weights_[layer], output);
+    DispatchActivation(activations[layer], [&](auto func) {
+      using Func = decltype(func);
+      for (FloatVector &row : output) {
+        for (std::size_t j = 0; j < row.size(); ++j) {
+          row[j] = static_cast<float>(Func::Apply(row[j] + biases[j]));
+        }
+        if constexpr (std::is_same_v<Func, Softmax>) Softmax::Normalize(row);
+      }
+    });
+  }
+
+  FloatMatrix errors, input_errors;
+  const double loss = OutputErrors(labels_, errors);
+
+  for (std::size_t layer = weights_.size(); layer-- > 0;) {
+    AddTransposedProduct(values_[layer], errors, weight_grads_[layer]);
+    FloatVector &bias_grads = bias_grads_[layer][0];
+    for (const FloatVector &row : errors) {
+      for (std::size_t j = 0; j < row.size(); ++j) bias_grads[j] += row[j];
+    }
+    if (layer == 0) break;
+
+    MultiplyTransposed(errors, weights_[layer], input_errors);
+    const FloatMatrix &input = values_[layer];
+    DispatchActivation(activations[layer - 1], [&](auto func) {
+      for (std::size_t i = 0; i < input_errors.size(); ++i) {
+        for (std::size_t j = 0; j < input_errors[i].size(); ++j) {
+          input_errors[i][j] *= func.Derivative(input[i][j]);
+        }
+      }
+    });
+    errors.swap(input_errors);
+  }
+
+  // A scale beyond the float range overflows the float errors of any batch
+  // with a large enough error, so the step is skipped like an overflow
+  const double scale = 1.0 / (loss_scale_ * static_cast<double>(size));
+  bool finite = loss_scale_ <= std::numeric_limits<float>::max();
+  for (std::size_t layer = 0; layer < weights_.size(); ++layer) {
+    finite &= Unscale(weight_grads_[layer], master_weight_grads_[layer],
+                      scale);
+    finite &= Unscale(bias_grads_[layer], master_bias_grads_[layer], scale);
+  }
+
+  if (!finite) {
+    loss_scale_ = std::max(loss_scale_ / 2.0, 1.0);
+    good_steps_ = 0;
+    ++skipped_;
+    return loss;
+  }
+
+  mlp_.GetOptimizer().NextStep();
+  for (std::size_t layer = 0; layer < weights_.size(); ++layer) {
+    const Matrix &weight_grads = master_weight_grads_[layer];
+    for (std::size_t row = 0; row < weight_grads.size(); ++row) {
+      mlp_.UpdateWeights(layer, row, weight_grads[row], learning_rate);
+    }
+    mlp_.UpdateBiases(layer, master_bias_grads_[layer][0], learning_rate);
+  }
+  CastWeights();
+
+  if (++good_steps_ == kGrowthInterval) {
+    loss_scale_ = std::min(loss_scale_ * 2.0, kMaxLossScale);
+    good_steps_ = 0;
+  }
+
+  return loss;
+}
+
+void MixedPrecision::CastWeights() {
+  weights_.resize(mlp_.GetWeights().size());
+  biases_.resize(mlp_.GetBiases().size());
+  for (std::size_t layer = 0; layer < weights_.size(); ++layer) {
+    Cast(mlp_.GetWeights()[layer], weights_[layer]);
+    Cast(mlp_.GetBiases()[layer], biases_[layer]);
+  }
+}
+
+/**
+ * Computes the loss-scaled errors of the output layer. The errors and the
+ * loss are computed in double by the MLP from the float activations.
+ *
+ * @param labels Expected label (starting from 1) for every sample.
+ * @param errors Receives the scaled errors of the output layer.
+ * @return The summed loss of the batch.
+ */
+double MixedPrecision::OutputErrors(const Labels &labels,
+                                    FloatMatrix &errors) const {
+  Matrix output, master_errors;
+  Cast(values_.back(), output);
+  const double loss = mlp_.OutputErrors(output, labels, master_errors);
+
+  errors.resize(master_errors.size());
+  for (std::size_t i = 0; i < master_errors.size(); ++i) {
+    errors[i].resize(master_errors[i].size());
+    for (std::size_t j = 0; j < master_errors[i].size(); ++j) {
+      errors[i][j] = static_cast<float>(master_errors[i][j] * loss_scale_);
+    }
+  }
+
+  return loss;
+}
+
+/**
+ * Moves float gradients into the double buffer, multiplying them by scale,
+ * and clears the float buffer for the next batch.
+ *
+ * @return false if any gradient overflowed.
+ */
+bool MixedPrecision::Unscale(FloatMatrix &grads, Matrix &master,
+                             double scale) {
+  bool finite = true;
+  for (std::size_t i = 0; i < grads.size(); ++i) {
+    for (std::size_t j = 0; j < grads[i].size(); ++j) {
+      finite &= std::isfinite(grads[i][j]);
+      master[i][j] = grads[i][j] * scale;
+      grads[i][j] = 0.0f;
+    }
+  }
+  return finite;
+}
+
+}  // namespace s21
@@ -0,0 +1,62 @@
+#ifndef MLP_MODEL_MATRIX_MLP_MIXED_PRECISION_H_
+#define MLP_MODEL_MATRIX_MLP_MIXED_PRECISION_H_
+
+#include "io.h"
+#include "matrix_mlp.h"
+
+namespace s21 {
+
+/**
+ * @class MixedPrecision
+ * @brief Mini-batch trainer for MatrixMlp running its GEMMs in single
+ * precision.
+ *
+ * The forward and backward passes of every mini-batch use float copies of the
+ * weights, while the double weights of the MLP stay the master copy that the
+ * optimizer updates. The output errors are multiplied by a loss scale so
+ * small gradients don't underflow in float. The scale is dynamic: a batch
+ * whose gradients overflow, or that starts with a scale beyond the float
+ * range, is skipped and halves the scale, and every kGrowthInterval
+ * successful batches double it.
+ */
+class MixedPrecision {
+ public:
+  using FloatVector = std::vector<float>;
+  using FloatMatrix = std::vector<FloatVector>;
+  using FloatTensor = std::vector<FloatMatrix>;
+
+  static constexpr std::size_t kGrowthInterval = 1000;
+  static constexpr double kMaxLossScale = 16777216.0;
+
+  explicit MixedPrecision(MatrixMlp &mlp, double loss_scale = 32768.0);
+
+  double TrainBatch(const Dataset &, const std::vector<std::size_t> &,
+                    std::size_t, std::size_t, double);
+
+  double GetLossScale() const { return loss_scale_; }
+  std::size_t GetGoodSteps() const { return good_steps_; }
+  std::size_t GetSkippedCount() const { return skipped_; }
+  void Restore(double loss_scale, std::size_t good_steps);
+
+ private:
+  void CastWeights();
+  double OutputErrors(const Labels &, FloatMatrix &) const;
+  static bool Unscale(FloatMatrix &, Matrix &, double);
+
+  MatrixMlp &mlp_;
+  FloatTensor weights_;
+  FloatTensor biases_;
+  FloatTensor values_;
+  FloatTensor weight_grads_;
+  FloatTensor bias_grads_;
+  Tensor master_weight_grads_;
+  Tensor master_bias_grads_;
+  Labels labels_;
+  double loss_scale_;
+  std::size_t good_steps_;
+  std::size_t skipped_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_MIXED_PRECISION_H_
@@ -0,0 +1,293 @@
+#include "model_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "checkpoint.h"
+
+namespace s21 {
+
+namespace {
+
+constexpr std::uint64_t kFnvOffset = 14695981039346656037ull;
+constexpr std::uint64_t kFnvPrime = 1099511628211ull;
+
+std::size_t Padded(std::size_t values) {
+  const std::size_t bytes = values * sizeof(double);
+  return (bytes + ModelFile::kAlignment - 1) / ModelFile::kAlignment *
+         ModelFile::kAlignment;
+}
+
+Matrix CopyBlock(const double *block, std::size_t rows, std::size_t cols) {
+  Matrix matrix(rows);
+  for (std::size_t i = 0; i < rows; ++i) {
+    matrix[i].assign(block + i * cols, block + (i + 1) * cols);
+  }
+  return matrix;
+}
+
+}  // namespace
+
+/**
+ * Maps a model file and validates its header, layer entries and checksum.
+ *
+ * @throws std::runtime_error if the file can't be mapped or is not a valid
+ * v2 model file.
+ */
+ModelFile::ModelFile(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("Failed to open file: " + path);
+  struct stat info;
+  if (::fstat(fd, &info) != 0 or
+      static_cast<std::size_t>(info.st_size) < sizeof(Header)) {
+    ::close(fd);
+    throw std::runtime_error("Not a model file: " + path);
+  }
+  size_ = static_cast<std::size_t>(info.st_size);
+  void *data = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Failed to map file: " + path);
+  }
+  data_ = static_cast<const unsigned char *>(data);
+
+  try {
+    Validate(path);
+  } catch (...) {
+    ::munmap(const_cast<unsigned char *>(data_), size_);
+    throw;
+  }
+  layers_ = reinterpret_cast<const Header *>(data_)->layers;
+  entries_ = reinterpret_cast<const Entry *>(data_ + sizeof(Header));
+}
+
+ModelFile::~ModelFile() {
+  ::munmap(const_cast<unsigned char *>(data_), size_);
+}
+
+/**
+ * @return True if the file starts with the magic of the v2 format.
+ */
+bool ModelFile::IsModelFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  char magic[sizeof(kMagic)];
+  return file.read(magic, sizeof(magic)) and
+         std::equal(magic, magic + sizeof(magic), kMagic);
+}
+
+/**
+ * Writes a network in the v2 format.
+ *
+ * @param path Path of the file.
+ * @param weights Weights of every layer, inputs x outputs. Factored layers
+ * are written as their factors only, so their weights may be empty.
+ * @param biases Biases of every layer, one row each.
+ * @param activations Activation of every layer, sigmoid for missing ones.
+ * @param factorizations Factors of every layer, empty for dense layers.
+ * @throws std::runtime_error if the file can't be written.
+ */
+void ModelFile::Write(const std::string &path, const Tensor &weights,
+                      const Tensor &biases,
+                      const std::vector<Activation> &activations,
+                      const std::vector<Factorization> &factorizations) {
+  const std::size_t layers = weights.size();
+  std::vector<Entry> entries(layers);
+  std::size_t offset = sizeof(Header) + layers * sizeof(Entry);
+  for (std::size_t i = 0; i < layers; ++i) {
+    Entry &entry = entries[i];
+    entry = Entry{};
+    entry.rank = i < factorizations.size() ? factorizations[i].GetRank() : 0;
+    entry.rows = entry.rank ? factorizations[i].left.size() : weights[i].size();
+    entry.cols = biases[i][0].size();
+    entry.activation = static_cast<std::uint32_t>(
+        i < activations.size() ? activations[i] : Activation::kSigmoid);
+    entry.biases = offset;
+    offset += Padded(entry.cols);
+    if (entry.rank) {
+      entry.left = offset;
+      offset += Padded(entry.rows * entry.rank);
+      entry.right = offset;
+      offset += Padded(entry.rank * entry.cols);
+    } else {
+      entry.weights = offset;
+      offset += Padded(entry.rows * entry.cols);
+    }
+  }
+
+  std::string data(offset, '\0');
+  auto put = [&data](std::uint64_t at, const Matrix &matrix) {
+    for (const Vector &row : matrix) {
+      std::memcpy(&data[at], row.data(), row.size() * sizeof(double));
+      at += row.size() * sizeof(double);
+    }
+  };
+  std::memcpy(&data[sizeof(Header)], entries.data(), layers * sizeof(Entry));
+  for (std::size_t i = 0; i < layers; ++i) {
+    put(entries[i].biases, biases[i]);
+    if (entries[i].rank) {
+      put(entries[i].left, factorizations[i].left);
+      put(entries[i].right, factorizations[i].right);
+    } else {
+      put(entries[i].weights, weights[i]);
+    }
+  }
+
+  Header header{};
+  std::copy(kMagic, kMagic + sizeof(kMagic), header.magic);
+  header.version = kVersion;
+  header.dtype = kFloat64;
+  header.layers = layers;
+  header.size = data.size();
+  header.checksum = Checksum(
+      reinterpret_cast<const unsigned char *>(data.data()) + sizeof(Header),
+      data.size() - sizeof(Header));
+  std::memcpy(&data[0], &header, sizeof(header));
+
+  // Replaced by a rename, so workers mapping the old file keep reading it
+  WriteFileAtomically(path, data);
+}
+
+Topology ModelFile::GetTopology() const {
+  std::vector<std::size_t> sizes{GetRows(0)};
+  std::vector<Activation> activations;
+  for (std::size_t i = 0; i < layers_; ++i) {
+    sizes.push_back(GetCols(i));
+    activations.push_back(GetActivation(i));
+  }
+  Topology topology{sizes};
+  topology.SetActivations(activations);
+  return topology;
+}
+
+std::size_t ModelFile::GetRows(std::size_t layer) const {
+  return entries_[layer].rows;
+}
+
+std::size_t ModelFile::GetCols(std::size_t layer) const {
+  return entries_[layer].cols;
+}
+
+std::size_t ModelFile::GetRank(std::size_t layer) const {
+  return entries_[layer].rank;
+}
+
+Activation ModelFile::GetActivation(std::size_t layer) const {
+  return static_cast<Activation>(entries_[layer].activation);
+}
+
+const double *ModelFile::GetWeights(std::size_t layer) const {
+  return entries_[layer].rank ? nullptr : Block(entries_[layer].weights);
+}
+
+const double *ModelFile::GetBiases(std::size_t layer) const {
+  return Block(entries_[layer].biases);
+}
+
+const double *ModelFile::GetLeft(std::size_t layer) const {
+  return entries_[layer].rank ? Block(entries_[layer].left) : nullptr;
+}
+
+const double *ModelFile::GetRight(std::size_t layer) const {
+  return entries_[layer].rank ? Block(entries_[layer].right) : nullptr;
+}
+
+/**
+ * @return Copies of the weights of every layer, the product of the factors
+ * for a factored one.
+ */
+Tensor ModelFile::CopyWeights() const {
+  Tensor weights(layers_);
+  for (std::size_t i = 0; i < layers_; ++i) {
+    if (GetRank(i)) {
+      weights[i] = CopyBlock(GetLeft(i), GetRows(i), GetRank(i)) *
+                   CopyBlock(GetRight(i), GetRank(i), GetCols(i));
+    } else {
+      weights[i] = CopyBlock(GetWeights(i), GetRows(i), GetCols(i));
+    }
+  }
+  return weights;
+}
+
+Tensor ModelFile::CopyBiases() const {
+  Tensor biases(layers_);
+  for (std::size_t i = 0; i < layers_; ++i) {
+    biases[i] = CopyBlock(GetBiases(i), 1, GetCols(i));
+  }
+  return biases;
+}
+
+std::vector<Factorization> ModelFile::CopyFactorizations() const {
+  std::vector<Factorization> factorizations(layers_);
+  for (std::size_t i = 0; i < layers_; ++i) {
+    if (!GetRank(i)) continue;
+    factorizations[i].left = CopyBlock(GetLeft(i), GetRows(i), GetRank(i));
+    factorizations[i].right = CopyBlock(GetRight(i), GetRank(i), GetCols(i));
+  }
+  return factorizations;
+}
+
+/**
+ * FNV-1a over 64-bit words, so the check runs at memory speed.
+ */
+std::uint64_t ModelFile::Checksum(const unsigned char *data,
+                                  std::size_t size) {
+  std::uint64_t hash = kFnvOffset;
+  for (std::size_t i = 0; i + sizeof(std::uint64_t) <= size;
+       i += sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * kFnvPrime;
+  }
+  return hash;
+}
+
+void ModelFile::Validate(const std::string &path) const {
+  const Header &header = *reinterpret_cast<const Header *>(data_);
+  if (!std::equal(kMagic, kMagic + sizeof(kMagic), header.magic)) {
+    throw std::runtime_error("Not a model file: " + path);
+  }
+  if (header.version != kVersion or header.dtype != kFloat64) {
+    throw std::runtime_error("Unsupported model file version: " + path);
+  }
+  if (header.size != size_ or size_ % kAlignment or header.layers == 0 or
+      header.layers > (size_ - sizeof(Header)) / sizeof(Entry)) {
+    throw std::runtime_error("Truncated model file: " + path);
+  }
+  if (Checksum(data_ + sizeof(Header), size_ - sizeof(Header)) !=
+      header.checksum) {
+    throw std::runtime_error("Model file checksum mismatch: " + path);
+  }
+
+  const auto *entries = reinterpret_cast<const Entry *>(data_ + sizeof(Header));
+  const std::size_t table_end = sizeof(Header) + header.layers * sizeof(Entry);
+  auto fits = [this, table_end](std::uint64_t offset, std::uint64_t rows,
+                                std::uint64_t cols) {
+    return offset % kAlignment == 0 and offset >= table_end and
+           offset <= size_ and
+           rows <= (size_ - offset) / sizeof(double) / cols;
+  };
+  for (std::size_t i = 0; i < header.layers; ++i) {
+    const Entry &entry = entries[i];
+    const bool valid =
+        entry.rows and entry.cols and
+        entry.activation <= static_cast<std::uint32_t>(Activation::kSoftmax) and
+        (i == 0 or entry.rows == entries[i - 1].cols) and
+        fits(entry.biases, 1, entry.cols) and
+        (entry.rank ? fits(entry.left, entry.rows, entry.rank) and
+                          fits(entry.right, entry.rank, entry.cols)
+                    : fits(entry.weights, entry.rows, entry.cols));
+    if (!valid) throw std::runtime_error("Corrupted model file: " + path);
+  }
+}
+
+const double *ModelFile::Block(std::uint64_t offset) const {
+  return reinterpret_cast<const double *>(data_ + offset);
+}
+
+}  // namespace s21
@@ -0,0 +1,103 @@
+#ifndef MLP_MODEL_MATRIX_MLP_MODEL_FILE_H_
+#define MLP_MODEL_MATRIX_MLP_MODEL_FILE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "config.h"
+#include "matrix_mlp.h"
+
+namespace s21 {
+
+/**
+ * @class ModelFile
+ * @brief Read-only memory map of a network saved in the v2 model format.
+ *
+ * The file is laid out in native byte order as:
+ * - a 64-byte header: magic, version, dtype, number of weight layers, file
+ *   size and a checksum of every byte after the header;
+ * - a 64-byte entry per weight layer: rows, columns, rank, activation and
+ *   the offsets of the layer's blocks;
+ * - the blocks, row-major and each starting on a 64-byte boundary: the
+ *   biases (columns), then the weights (rows x columns) of a dense layer or
+ *   the left (rows x rank) and right (rank x columns) factors of a factored
+ *   one, whose product is never stored.
+ *
+ * The constructor maps the whole file with a single mmap and validates it
+ * once. The blocks are then read in place, with no parsing and no copy, and
+ * the pages are shared through the page cache by every process mapping the
+ * same file.
+ */
+class ModelFile {
+ public:
+  static constexpr char kMagic[8] = {'M', 'L', 'P', 'M', 'O', 'D', 'E', 'L'};
+  static constexpr std::uint32_t kVersion = 2;
+  static constexpr std::uint32_t kFloat64 = 1;
+  static constexpr std::size_t kAlignment = 64;
+
+  explicit ModelFile(const std::string &path);
+  ModelFile(const ModelFile &) = delete;
+  ModelFile &operator=(const ModelFile &) = delete;
+  ~ModelFile();
+
+  static bool IsModelFile(const std::string &path);
+  static void Write(const std::string &path, const Tensor &weights,
+                    const Tensor &biases, const std::vector<Activation> &,
+                    const std::vector<Factorization> &);
+
+  std::size_t GetLayersCount() const { return layers_; }
+  Topology GetTopology() const;
+  std::size_t GetRows(std::size_t layer) const;
+  std::size_t GetCols(std::size_t layer) const;
+  std::size_t GetRank(std::size_t layer) const;
+  Activation GetActivation(std::size_t layer) const;
+  // Blocks of a layer; the weights are null for a factored layer and the
+  // factors for a dense one
+  const double *GetWeights(std::size_t layer) const;
+  const double *GetBiases(std::size_t layer) const;
+  const double *GetLeft(std::size_t layer) const;
+  const double *GetRight(std::size_t layer) const;
+
+  Tensor CopyWeights() const;
+  Tensor CopyBiases() const;
+  std::vector<Factorization> CopyFactorizations() const;
+
+ private:
+  struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t dtype;
+    std::uint64_t layers;
+    std::uint64_t size;
+    std::uint64_t checksum;
+    std::uint64_t reserved[3];
+  };
+
+  struct Entry {
+    std::uint64_t rows;
+    std::uint64_t cols;
+    std::uint64_t rank;
+    std::uint32_t activation;
+    std::uint32_t reserved;
+    std::uint64_t weights;
+    std::uint64_t biases;
+    std::uint64_t left;
+    std::uint64_t right;
+  };
+
+  static_assert(sizeof(Header) == kAlignment and sizeof(Entry) == kAlignment,
+                "Header and entries must keep the blocks aligned");
+
+  static std::uint64_t Checksum(const unsigned char *, std::size_t);
+  void Validate(const std::string &path) const;
+  const double *Block(std::uint64_t offset) const;
+
+  const unsigned char *data_ = nullptr;
+  std::size_t size_ = 0;
+  const Entry *entries_ = nullptr;
+  std::size_t layers_ = 0;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_MODEL_FILE_H_
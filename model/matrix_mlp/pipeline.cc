@@ -0,0 +1,175 @@
+#include "pipeline.h"
+
+namespace s21 {
+
+namespace {
+
+std::size_t CountWeights(const Matrix &matrix) {
+  return matrix.size() * matrix[0].size();
+}
+
+Tensor ZerosLike(const Tensor &tensor, std::size_t first, std::size_t last) {
+  Tensor zeros;
+  for (std::size_t i = first; i < last; ++i) {
+    zeros.emplace_back(tensor[i].size(), Vector(tensor[i][0].size(), 0.0));
+  }
+  return zeros;
+}
+
+}  // namespace
+
+Pipeline::Pipeline(MatrixMlp &mlp, std::size_t stages,
+                   std::size_t micro_batches)
+    : mlp_{mlp},
+      micro_batches_{std::max<std::size_t>(micro_batches, 1)},
+      pool_{std::min(std::max<std::size_t>(stages, 1),
+                     mlp.GetWeights().size())} {
+  const Tensor &weights = mlp_.GetWeights();
+  const std::size_t count = std::min(std::max<std::size_t>(stages, 1),
+                                     weights.size());
+  std::size_t total = 0;
+  for (const Matrix &matrix : weights) total += CountWeights(matrix);
+
+  // Cut the layers into contiguous stages with a similar number of weights,
+  // keeping at least one layer for every remaining stage.
+  std::size_t first = 0, accumulated = 0;
+  for (std::size_t layer = 0; layer < weights.size(); ++layer) {
+    accumulated += CountWeights(weights[layer]);
+    const std::size_t layers_left = weights.size() - layer - 1;
+    const std::size_t stages_left = count - stages_.size() - 1;
+    if (stages_left == 0) break;
+    if (layers_left == stages_left or
+        accumulated * count >= total * (stages_.size() + 1)) {
+      stages_.push_back({first, layer + 1, {}, {}, {}, {}});
+      first = layer + 1;
+    }
+  }
+  stages_.push_back({first, weights.size(), {}, {}, {}, {}});
+
+  for (Stage &stage : stages_) {
+    stage.weight_grads = ZerosLike(weights, stage.first, stage.last);
+    stage.bias_grads = ZerosLike(mlp_.GetBiases(), stage.first, stage.last);
+    activations_.push_back(std::make_unique<Queue>(micro_batches_));
+    errors_.push_back(std::make_unique<Queue>(micro_batches_));
+  }
+}
+
+/**
+ * Trains the MLP on a single mini-batch split into micro-batches.
+ *
+ * @param data The dataset to take the samples from.
+ * @param indices Order in which the samples of the dataset are visited.
+ * @param begin First position of the batch in the indices (inclusive).
+ * @param end Last position of the batch in the indices (exclusive).
+ * @param learning_rate Learning rate of the update made with the mean
+ * gradient of the batch.
+ * @return The summed loss of the batch.
+ */
+double Pipeline::TrainBatch(const Dataset &data,
+                            const std::vector<std::size_t> &indices,
+                            std::size_t begin, std::size_t end,
+                            double learning_rate) {
+  const Batch batch{&data, &indices, begin, end - begin,
+                    std::min(micro_batches_, end - begin)};
+  const double scale = 1.0 / static_cast<double>(batch.size);
+
+  mlp_.GetOptimizer().NextStep();
+  std::vector<std::future<double>> tasks;
+  for (std::size_t s = 0; s < stages_.size(); ++s) {
+    tasks.push_back(pool_.enqueue(&Pipeline::RunStage, this, s,
+                                  std::cref(batch), scale, learning_rate));
+  }
+
+  double loss = 0.0;
+  for (auto &task : tasks) loss += task.get();
+
+  return loss;
+}
+
+double Pipeline::RunStage(std::size_t s, const Batch &batch, double scale,
+                          double lr) {
+  Stage &stage = stages_[s];
+  stage.stash.resize(batch.count);
+  stage.output_errors.resize(batch.count);
+  double loss = 0.0;
+
+  // 1F1B schedule: the deeper the stage, the fewer warm-up forward passes it
+  // needs before the first error comes back.
+  const std::size_t warmup = std::min(stages_.size() - s - 1, batch.count);
+  std::size_t forward = 0;
+  for (; forward < warmup; ++forward) {
+    loss += Forward(s, forward, batch);
+  }
+  for (std::size_t backward = 0; backward < batch.count; ++backward) {
+    if (forward < batch.count) {
+      loss += Forward(s, forward++, batch);
+    }
+    Backward(s, backward);
+  }
+
+  for (std::size_t layer = stage.first; layer < stage.last; ++layer) {
+    Matrix &weight_grads = stage.weight_grads[layer - stage.first];
+    Vector &bias_grads = stage.bias_grads[layer - stage.first][0];
+    for (std::size_t row = 0; row < weight_grads.size(); ++row) {
+      for (double &value : weight_grads[row]) value *= scale;
+      mlp_.UpdateWeights(layer, row, weight_grads[row], lr);
+      std::fill(weight_grads[row].begin(), weight_grads[row].end(), 0.0);
+    }
+    for (double &value : bias_grads) value *= scale;
+    mlp_.UpdateBiases(layer, bias_grads, lr);
+    std::fill(bias_grads.begin(), bias_grads.end(), 0.0);
+  }
+
+  return loss;
+}
+
+double Pipeline::Forward(std::size_t s, std::size_t k, const Batch &batch) {
+  Stage &stage = stages_[s];
+  Tensor &values = stage.stash[k];
+  values.resize(stage.last - stage.first + 1);
+
+  if (s == 0) {
+    values[0].clear();
+    for (std::size_t i = batch.From(k); i < batch.From(k + 1); ++i) {
+      values[0].push_back((*batch.data)[(*batch.indices)[i]].GetPixels());
+    }
+  } else {
+    values[0] = activations_[s]->Pop();
+  }
+
+  for (std::size_t layer = stage.first; layer < stage.last; ++layer) {
+    values[layer - stage.first + 1] =
+        mlp_.ForwardLayer(layer, values[layer - stage.first]);
+  }
+
+  if (s + 1 < stages_.size()) {
+    activations_[s + 1]->Push(std::move(values.back()));
+    return 0.0;
+  }
+
+  Labels labels;
+  for (std::size_t i = batch.From(k); i < batch.From(k + 1); ++i) {
+    labels.push_back((*batch.data)[(*batch.indices)[i]].GetLabel());
+  }
+  return mlp_.OutputErrors(values.back(), labels, stage.output_errors[k]);
+}
+
+void Pipeline::Backward(std::size_t s, std::size_t k) {
+  Stage &stage = stages_[s];
+  Tensor &values = stage.stash[k];
+  Matrix errors = s + 1 == stages_.size() ? std::move(stage.output_errors[k])
+                                          : errors_[s]->Pop();
+
+  for (std::size_t layer = stage.last; layer-- > stage.first;) {
+    errors = mlp_.BackwardLayer(layer, values[layer - stage.first], errors,
+                                stage.weight_grads[layer - stage.first],
+                                stage.bias_grads[layer - stage.first]);
+  }
+
+  if (s > 0) {
+    errors_[s - 1]->Push(std::move(errors));
+  }
+  values.clear();
+}
+
+}  // namespace s21
@@ -0,0 +1,70 @@
+#ifndef MLP_MODEL_MATRIX_MLP_PIPELINE_H_
+#define MLP_MODEL_MATRIX_MLP_PIPELINE_H_
+
+#include <memory>
+
+#include "io.h"
+#include "matrix_mlp.h"
+#include "spsc_queue.h"
+#include "thread_pool.h"
+
+namespace s21 {
+
+/**
+ * @class Pipeline
+ * @brief Layer-pipelined model-parallel mini-batch trainer for MatrixMlp.
+ *
+ * The layers of the MLP are split into contiguous stages with a similar number
+ * of weights, and every stage runs on its own thread. A mini-batch is cut into
+ * micro-batches that stream through the stages in a one-forward-one-backward
+ * (1F1B) schedule, so the forward pass of one micro-batch overlaps the backward
+ * pass of another. Activations and errors travel between neighbour stages
+ * through lock-free single-producer single-consumer queues. Each stage applies
+ * the update of its own layers once the whole mini-batch is done, so the
+ * result matches plain mini-batch training.
+ */
+class Pipeline {
+ public:
+  Pipeline(MatrixMlp &mlp, std::size_t stages, std::size_t micro_batches);
+
+  double TrainBatch(const Dataset &, const std::vector<std::size_t> &,
+                    std::size_t, std::size_t, double);
+  std::size_t GetStagesCount() const { return stages_.size(); }
+
+ private:
+  using Queue = SpscQueue<Matrix>;
+
+  struct Stage {
+    std::size_t first;
+    std::size_t last;
+    std::vector<Tensor> stash;
+    std::vector<Matrix> output_errors;
+    Tensor weight_grads;
+    Tensor bias_grads;
+  };
+
+  struct Batch {
+    const Dataset *data;
+    const std::vector<std::size_t> *indices;
+    std::size_t begin;
+    std::size_t size;
+    std::size_t count;
+
+    std::size_t From(std::size_t k) const { return begin + size * k / count; }
+  };
+
+  double RunStage(std::size_t, const Batch &, double, double);
+  double Forward(std::size_t, std::size_t, const Batch &);
+  void Backward(std::size_t, std::size_t);
+
+  MatrixMlp &mlp_;
+  std::size_t micro_batches_;
+  std::vector<Stage> stages_;
+  std::vector<std::unique_ptr<Queue>> activations_;
+  std::vector<std::unique_ptr<Queue>> errors_;
+  ThreadPool pool_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_PIPELINE_H_
@@ -0,0 +1,61 @@
+#include "replica.h"
+
+#include "data_parallel.h"
+#include "evaluator.h"
+
+namespace s21 {
+
+/**
+ * Trains an epoch over the given images, with per-sample updates or, when
+ * the batch size is larger than one, with data-parallel mini-batches.
+ *
+ * @param replica The model to train.
+ * @param dataset The shared images.
+ * @param order Indices of the images to train on, in training order.
+ * @param config The learning rate, batch size and memory budget.
+ * @param threads Threads of the data-parallel trainer.
+ */
+void TrainReplica(MatrixMlp &replica, const Dataset &dataset,
+                  const std::vector<std::size_t> &order, const Config &config,
+                  std::size_t threads) {
+  const double rate = config.GetLearningRate();
+  const std::size_t batch_size = config.GetBatchSize();
+  if (batch_size > 1 or threads > 1) {
+    DataParallel trainer(replica, threads);
+    trainer.SetMemoryBudget(config.GetMemoryBudget());
+    for (std::size_t begin = 0; begin < order.size(); begin += batch_size) {
+      const std::size_t end = std::min(begin + batch_size, order.size());
+      trainer.TrainBatch(dataset, order, begin, end, rate);
+    }
+    return;
+  }
+
+  Vector expected;
+  for (std::size_t idx : order) {
+    const Image &image = dataset[idx];
+    replica.SetInputLayer(image.GetPixels());
+    replica.ForwardPropagation();
+    if (expected.empty()) expected.resize(replica.GetOutput().size());
+    std::fill(expected.begin(), expected.end(), 0.0);
+    expected[image.GetLabel() - 1] = 1.0;
+    replica.BackPropagation(expected, rate);
+  }
+}
+
+/**
+ * Tests a replica on the given images with batched forward passes.
+ *
+ * @return The metrics of the test; the loss is averaged over the images.
+ */
+Metrics EvaluateReplica(const MatrixMlp &replica, const Topology &topology,
+                        const Dataset &dataset,
+                        const std::vector<std::size_t> &indices) {
+  Metrics metrics{topology.GetOutputSize()};
+  metrics.SetCrossEntropy(topology.IsCrossEntropy());
+  metrics.StartMeasure(indices.size());
+  AddPredictions(replica, dataset, indices, 0, indices.size(), metrics);
+  metrics.StopMeasure();
+  return metrics;
+}
+
+}  // namespace s21
@@ -0,0 +1,22 @@
+#ifndef MLP_MODEL_MATRIX_MLP_REPLICA_H_
+#define MLP_MODEL_MATRIX_MLP_REPLICA_H_
+
+#include "config.h"
+#include "io.h"
+#include "matrix_mlp.h"
+#include "metrics.h"
+
+namespace s21 {
+
+// Training and testing of independent MatrixMlp replicas that share one
+// read-only dataset and address it through index lists
+
+void TrainReplica(MatrixMlp &, const Dataset &,
+                  const std::vector<std::size_t> &, const Config &,
+                  std::size_t threads);
+Metrics EvaluateReplica(const MatrixMlp &, const Topology &, const Dataset &,
+                        const std::vector<std::size_t> &);
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_REPLICA_H_
@@ -0,0 +1,192 @@
+#include "sparse_mlp.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace s21 {
+
+namespace {
+
+template <typename T>
+void Write(std::ofstream &file, const T *data, std::size_t count) {
+  file.write(reinterpret_cast<const char *>(data), sizeof(T) * count);
+}
+
+template <typename T>
+void Read(std::ifstream &file, T *data, std::size_t count) {
+  file.read(reinterpret_cast<char *>(data), sizeof(T) * count);
+}
+
+}  // namespace
+
+SparseMlp::SparseMlp(const Tensor &weights, const Tensor &biases,
+                     const std::vector<Activation> &activations)
+    : biases_{biases}, activations_{activations} {
+  if (biases.size() != weights.size() or
+      activations.size() != weights.size()) {
+    throw std::invalid_argument("Layers count doesn't match");
+  }
+  weights_.reserve(weights.size());
+  for (const Matrix &layer : weights) weights_.push_back(ToSparse(layer));
+}
+
+/**
+ * Runs a forward pass for a whole batch.
+ *
+ * @param input One input per row.
+ * @return The activations of the output layer, one sample per row.
+ */
+Matrix SparseMlp::Forward(const Matrix &input) const {
+  Matrix values = input, output;
+  for (std::size_t layer = 0; layer < weights_.size(); ++layer) {
+    MultiplySparse(values, weights_[layer], output);
+    const Vector &biases = biases_[layer][0];
+    for (Vector &row : output) {
+      for (std::size_t j = 0; j < row.size(); ++j) row[j] += biases[j];
+    }
+    DispatchActivation(activations_[layer], [&](auto func) {
+      ActivateInPlace<decltype(func)>(output);
+    });
+    values.swap(output);
+  }
+  return values;
+}
+
+Vector SparseMlp::Predict(const Vector &input) const {
+  return Forward(Matrix(1, input))[0];
+}
+
+std::size_t SparseMlp::PredictLabel(const Vector &input) const {
+  Vector predicted = Predict(input);
+  auto it = std::max_element(predicted.begin(), predicted.end());
+  return std::distance(predicted.begin(), it) + 1;
+}
+
+/**
+ * Saves the network: a magic string, the number of layers, then for every
+ * layer its dimensions, non-zeros count, CSR arrays, biases and activation.
+ *
+ * @param path Path of the file.
+ * @throws std::runtime_error if the file can't be opened.
+ */
+void SparseMlp::Save(const std::string &path) const {
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+
+  Write(file, kMagic, sizeof(kMagic));
+  const std::size_t layers = weights_.size();
+  Write(file, &layers, 1);
+  for (std::size_t i = 0; i < layers; ++i) {
+    const SparseMatrix &weights = weights_[i];
+    const std::size_t header[3] = {weights.rows, weights.cols,
+                                   weights.GetNonZeros()};
+    const std::int32_t activation = static_cast<std::int32_t>(activations_[i]);
+    Write(file, header, 3);
+    Write(file, weights.row_offsets.data(), weights.row_offsets.size());
+    Write(file, weights.columns.data(), weights.columns.size());
+    Write(file, weights.values.data(), weights.values.size());
+    Write(file, biases_[i][0].data(), weights.cols);
+    Write(file, &activation, 1);
+  }
+}
+
+/**
+ * Loads a network written by Save. The sizes in the file are checked
+ * against its length before anything is allocated, and the CSR arrays and
+ * layer dimensions are validated before the network is replaced.
+ *
+ * @param path Path of the file.
+ * @throws std::runtime_error if the file can't be opened or is not a valid
+ * sparse network.
+ */
+void SparseMlp::Load(const std::string &path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+  const std::streamoff size = file.tellg();
+  file.seekg(0);
+
+  char magic[sizeof(kMagic)];
+  std::size_t layers = 0;
+  Read(file, magic, sizeof(magic));
+  Read(file, &layers, 1);
+  if (!file or !std::equal(magic, magic + sizeof(magic), kMagic)) {
+    throw std::runtime_error("Not a sparse network file: " + path);
+  }
+  if (layers > static_cast<std::size_t>(size) / sizeof(std::size_t[3])) {
+    throw std::runtime_error("Truncated sparse network file: " + path);
+  }
+
+  std::vector<SparseMatrix> weights(layers);
+  Tensor biases(layers);
+  std::vector<Activation> activations(layers);
+  for (std::size_t i = 0; i < layers; ++i) {
+    std::size_t header[3];
+    std::int32_t activation;
+    Read(file, header, 3);
+    const std::size_t rows = header[0], cols = header[1];
+    const std::size_t non_zeros = header[2];
+    if (!file) {
+      throw std::runtime_error("Truncated sparse network file: " + path);
+    }
+    const auto left = static_cast<std::size_t>(size - file.tellg());
+    const bool fits =
+        rows < left / sizeof(std::size_t) and cols <= left / sizeof(double) and
+        non_zeros <= left / (sizeof(std::uint32_t) + sizeof(double)) and
+        (rows + 1) * sizeof(std::size_t) + cols * sizeof(double) +
+                non_zeros * (sizeof(std::uint32_t) + sizeof(double)) +
+                sizeof(activation) <=
+            left;
+    if (!fits) {
+      throw std::runtime_error("Truncated sparse network file: " + path);
+    }
+    if (i > 0 and rows != weights[i - 1].cols) {
+      throw std::runtime_error("Corrupted sparse network file: " + path);
+    }
+
+    weights[i].rows = rows;
+    weights[i].cols = cols;
+    weights[i].row_offsets.resize(rows + 1);
+    weights[i].columns.resize(non_zeros);
+    weights[i].values.resize(non_zeros);
+    biases[i].assign(1, Vector(cols));
+    Read(file, weights[i].row_offsets.data(), rows + 1);
+    Read(file, weights[i].columns.data(), non_zeros);
+    Read(file, weights[i].values.data(), non_zeros);
+    Read(file, biases[i][0].data(), cols);
+    Read(file, &activation, 1);
+    activations[i] = static_cast<Activation>(activation);
+    if (!file) {
+      throw std::runtime_error("Truncated sparse network file: " + path);
+    }
+
+    const std::vector<std::size_t> &offsets = weights[i].row_offsets;
+    const std::vector<std::uint32_t> &columns = weights[i].columns;
+    const bool valid =
+        offsets.front() == 0 and offsets.back() == non_zeros and
+        std::is_sorted(offsets.begin(), offsets.end()) and
+        std::all_of(columns.begin(), columns.end(),
+                    [cols](std::uint32_t column) { return column < cols; });
+    if (!valid) {
+      throw std::runtime_error("Corrupted sparse network file: " + path);
+    }
+  }
+
+  weights_ = std::move(weights);
+  biases_ = std::move(biases);
+  activations_ = std::move(activations);
+}
+
+std::size_t SparseMlp::GetNonZeros() const {
+  std::size_t non_zeros = 0;
+  for (const SparseMatrix &weights : weights_) {
+    non_zeros += weights.GetNonZeros();
+  }
+  return non_zeros;
+}
+
+}  // namespace s21
@@ -0,0 +1,49 @@
+#ifndef MLP_MODEL_MATRIX_MLP_SPARSE_MLP_H_
+#define MLP_MODEL_MATRIX_MLP_SPARSE_MLP_H_
+
+#include <string>
+
+#include "abstract_mlp.h"
+#include "config.h"
+#include "sparse_matrix.h"
+
+namespace s21 {
+
+/**
+ * @class SparseMlp
+ * @brief Inference-only perceptron with weights stored in CSR format.
+ *
+ * The SparseMlp class serves pruned networks: every weight matrix keeps only
+ * its non-zeros and the forward pass runs sparse-dense products, so its cost
+ * falls with the sparsity of the weights and of the inputs. It has its own
+ * file format, written by Save and read by Load.
+ */
+class SparseMlp {
+ public:
+  SparseMlp() = default;
+  SparseMlp(const Tensor &, const Tensor &, const std::vector<Activation> &);
+
+  Matrix Forward(const Matrix &) const;
+  Vector Predict(const Vector &) const;
+  std::size_t PredictLabel(const Vector &) const;
+
+  void Save(const std::string &) const;
+  void Load(const std::string &);
+
+  std::size_t GetLayersCount() const { return weights_.size(); }
+  const SparseMatrix &GetWeights(std::size_t layer) const {
+    return weights_[layer];
+  }
+  std::size_t GetNonZeros() const;
+
+ private:
+  static constexpr char kMagic[8] = {'M', 'L', 'P', 'C', 'S', 'R', '1', '\0'};
+
+  std::vector<SparseMatrix> weights_;
+  Tensor biases_;
+  std::vector<Activation> activations_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_SPARSE_MLP_H_
@@ -0,0 +1,308 @@
+#include "sweep.h"
+
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+
+#include "optimizer.h"
+#include "replica.h"
+
+namespace s21 {
+
+/**
+ * @return The trials in CSV, one row per trial with its rank.
+ */
+std::string Leaderboard::ToCsv() const {
+  std::ostringstream csv;
+  csv.precision(10);
+  csv << "rank,id,learning_rate,hidden_size,hidden_count,epochs,batch_size,"
+         "trained_epochs,loss,accuracy,seconds,pruned\n";
+  for (std::size_t i = 0; i < trials.size(); ++i) {
+    const SweepTrial &trial = trials[i];
+    csv << i + 1 << ',' << trial.id << ',' << trial.learning_rate << ','
+        << trial.hidden_size << ',' << trial.hidden_count << ','
+        << trial.epochs << ',' << trial.batch_size << ','
+        << trial.trained_epochs << ',' << trial.loss << ',' << trial.accuracy
+        << ',' << trial.seconds << ',' << trial.pruned << '\n';
+  }
+  return csv.str();
+}
+
+/**
+ * @return The trials as a JSON array, in rank order.
+ */
+std::string Leaderboard::ToJson() const {
+  std::ostringstream json;
+  json.precision(10);
+  json << "[";
+  for (std::size_t i = 0; i < trials.size(); ++i) {
+    const SweepTrial &trial = trials[i];
+    json << (i ? ",\n " : "\n ") << "{\"rank\": " << i + 1
+         << ", \"id\": " << trial.id
+         << ", \"learning_rate\": " << trial.learning_rate
+         << ", \"hidden_size\": " << trial.hidden_size
+         << ", \"hidden_count\": " << trial.hidden_count
+         << ", \"epochs\": " << trial.epochs
+         << ", \"batch_size\": " << trial.batch_size
+         << ", \"trained_epochs\": " << trial.trained_epochs
+         << ", \"loss\": " << trial.loss << ", \"accuracy\": " << trial.accuracy
+         << ", \"seconds\": " << trial.seconds
+         << ", \"pruned\": " << (trial.pruned ? "true" : "false") << "}";
+  }
+  json << "\n]\n";
+  return json.str();
+}
+
+Sweep::Sweep(const Topology &topology, const Config &config,
+             const SweepSpace &space, const SweepOptions &options)
+    : topology_{topology}, config_{config}, space_{space}, options_{options} {
+  if (space_.learning_rates.empty() or space_.hidden_sizes.empty() or
+      space_.hidden_counts.empty() or space_.epochs.empty() or
+      space_.batch_sizes.empty()) {
+    throw std::invalid_argument("Empty sweep space");
+  }
+  options_.threads_per_trial = std::max<std::size_t>(
+      options_.threads_per_trial, 1);
+  options_.min_epochs = std::max<std::size_t>(options_.min_epochs, 1);
+  options_.reduction = std::max<std::size_t>(options_.reduction, 1);
+}
+
+/**
+ * Trains every trial of the space, pruning the weak ones by successive
+ * halving. New trials and promotions are scheduled on the calling thread as
+ * soon as a core partition is free; promotions to the highest rung go first.
+ *
+ * @param train The training images, shared by every trial.
+ * @param validation The images that rank the trials.
+ * @param func Called on the calling thread after every finished rung.
+ * @return The leaderboard: trials trained to their full epochs first, each
+ * group by validation loss.
+ * @throws std::runtime_error if a dataset is empty.
+ * @throws std::invalid_argument if a random search has a non-positive rate.
+ */
+Leaderboard Sweep::Run(const Dataset &train, const Dataset &validation,
+                       const TrialFunc &func) {
+  if (train.empty() or validation.empty()) {
+    throw std::runtime_error("Train or validation dataset not loaded.");
+  }
+  MakeTrials();
+  states_.clear();
+  states_.resize(trials_.size());
+  rungs_.clear();
+  started_ = 0;
+  finished_.clear();
+  validation_indices_.resize(validation.size());
+  std::iota(validation_indices_.begin(), validation_indices_.end(), 0);
+
+  const std::size_t cores =
+      options_.threads ? options_.threads
+                       : std::max(1u, std::thread::hardware_concurrency());
+  const std::size_t slots =
+      std::max<std::size_t>(cores / options_.threads_per_trial, 1);
+  ThreadPool pool{slots};
+  std::vector<std::future<JobResult>> jobs(trials_.size());
+  std::size_t running = 0;
+  Job job;
+  while (true) {
+    while (running < slots and NextJob(job)) {
+      states_[job.trial].busy = true;
+      jobs[job.trial] = pool.enqueue([this, job, &train, &validation] {
+        try {
+          const JobResult result = RunJob(job, train, validation);
+          Finish(job.trial);
+          return result;
+        } catch (...) {
+          Finish(job.trial);
+          throw;
+        }
+      });
+      ++running;
+    }
+    if (!running) break;
+
+    std::size_t trial;
+    {
+      std::unique_lock<std::mutex> lock{mtx_};
+      cv_.wait(lock, [this] { return !finished_.empty(); });
+      trial = finished_.back();
+      finished_.pop_back();
+    }
+    --running;
+    states_[trial].busy = false;
+    const JobResult result = jobs[trial].get();
+    const std::size_t rung = result.rung;
+    trials_[trial].trained_epochs = result.trained_epochs;
+    trials_[trial].loss = result.loss;
+    trials_[trial].rung_losses.resize(rung + 1);
+    trials_[trial].rung_losses[rung] = result.loss;
+    trials_[trial].accuracy = result.accuracy;
+    trials_[trial].seconds += result.seconds;
+    states_[trial].rung = rung;
+    if (rungs_.size() <= rung) rungs_.resize(rung + 1);
+    rungs_[rung].push_back(trial);
+    if (func) func(trials_[trial]);
+  }
+
+  Leaderboard leaderboard;
+  for (std::size_t i = 0; i < trials_.size(); ++i) {
+    trials_[i].pruned = trials_[i].trained_epochs < trials_[i].epochs;
+    states_[i].mlp.reset();
+  }
+  leaderboard.trials = trials_;
+  std::stable_sort(leaderboard.trials.begin(), leaderboard.trials.end(),
+                   [](const SweepTrial &a, const SweepTrial &b) {
+                     if (a.pruned != b.pruned) return b.pruned;
+                     return a.loss < b.loss;
+                   });
+  return leaderboard;
+}
+
+void Sweep::MakeTrials() {
+  trials_.clear();
+  auto add = [this](double rate, std::size_t size, std::size_t count,
+                    std::size_t epochs, std::size_t batch) {
+    SweepTrial trial;
+    trial.id = trials_.size();
+    trial.learning_rate = rate;
+    trial.hidden_size = size;
+    trial.hidden_count = count;
+    trial.epochs = std::max<std::size_t>(epochs, 1);
+    trial.batch_size = std::max<std::size_t>(batch, 1);
+    trials_.push_back(trial);
+  };
+
+  if (options_.search == SweepOptions::Search::kGrid) {
+    for (double rate : space_.learning_rates) {
+      for (std::size_t size : space_.hidden_sizes) {
+        for (std::size_t count : space_.hidden_counts) {
+          for (std::size_t epochs : space_.epochs) {
+            for (std::size_t batch : space_.batch_sizes) {
+              add(rate, size, count, epochs, batch);
+            }
+          }
+        }
+      }
+    }
+    return;
+  }
+
+  std::mt19937 gen{options_.seed};
+  auto [min_rate, max_rate] = std::minmax_element(
+      space_.learning_rates.begin(), space_.learning_rates.end());
+  if (*min_rate <= 0.0) {
+    throw std::invalid_argument("Random sweep needs positive learning rates");
+  }
+  std::uniform_real_distribution<double> log_rate(std::log(*min_rate),
+                                                  std::log(*max_rate));
+  auto pick = [&gen](const std::vector<std::size_t> &values) {
+    std::uniform_int_distribution<std::size_t> idx(0, values.size() - 1);
+    return values[idx(gen)];
+  };
+  for (std::size_t i = 0; i < options_.trials; ++i) {
+    const double rate = std::exp(log_rate(gen));
+    const std::size_t size = pick(space_.hidden_sizes);
+    const std::size_t count = pick(space_.hidden_counts);
+    const std::size_t epochs = pick(space_.epochs);
+    add(rate, size, count, epochs, pick(space_.batch_sizes));
+  }
+}
+
+/**
+ * @return The epochs a trial has trained after the given rung.
+ */
+std::size_t Sweep::GetRungEpochs(std::size_t trial, std::size_t rung) const {
+  if (options_.reduction == 1) return trials_[trial].epochs;
+  std::size_t epochs = options_.min_epochs;
+  for (std::size_t i = 0; i < rung and epochs < trials_[trial].epochs; ++i) {
+    epochs *= options_.reduction;
+  }
+  return std::min(epochs, trials_[trial].epochs);
+}
+
+/**
+ * Picks the next job: the promotion of a trial in the best 1 / reduction of
+ * its rung by the losses at that rung, highest rung first, or else the first
+ * rung of a new trial.
+ *
+ * @return False if no job can start until a running one ends.
+ */
+bool Sweep::NextJob(Job &job) {
+  for (std::size_t rung = rungs_.size(); rung-- > 0;) {
+    std::vector<std::size_t> ranked = rungs_[rung];
+    const std::size_t top = ranked.size() / options_.reduction;
+    std::partial_sort(ranked.begin(), ranked.begin() + top, ranked.end(),
+                      [this, rung](std::size_t a, std::size_t b) {
+                        return trials_[a].rung_losses[rung] <
+                               trials_[b].rung_losses[rung];
+                      });
+    for (std::size_t i = 0; i < top; ++i) {
+      const std::size_t trial = ranked[i];
+      if (!states_[trial].busy and states_[trial].rung == rung and
+          trials_[trial].trained_epochs < trials_[trial].epochs) {
+        job = {trial, rung + 1};
+        return true;
+      }
+    }
+  }
+  if (started_ == trials_.size()) return false;
+  job = {started_++, 0};
+  return true;
+}
+
+/**
+ * Trains a trial up to the epochs of the rung of the job. Runs on a worker
+ * and only reads the trial; the scheduler publishes the result.
+ */
+Sweep::JobResult Sweep::RunJob(const Job &job, const Dataset &train,
+                               const Dataset &validation) {
+  const SweepTrial &trial = trials_[job.trial];
+  State &state = states_[job.trial];
+  const auto start = std::chrono::steady_clock::now();
+  Config config = config_;
+  config.SetLearningRate(trial.learning_rate);
+  config.SetBatchSize(trial.batch_size);
+
+  if (!state.mlp) {
+    std::vector<std::size_t> sizes(trial.hidden_count + 2, trial.hidden_size);
+    sizes.front() = topology_.GetInputSize();
+    sizes.back() = topology_.GetOutputSize();
+    state.topology = topology_;
+    state.topology.SetTopology(sizes);
+    state.mlp =
+        std::make_unique<MatrixMlp>(state.topology, options_.seed + trial.id);
+    state.mlp->SetOptimizer(MakeOptimizer(config));
+    state.order.resize(train.size());
+    std::iota(state.order.begin(), state.order.end(), 0);
+    state.gen.seed(options_.seed + trial.id);
+  }
+
+  JobResult result;
+  result.rung = job.rung;
+  result.trained_epochs = trial.trained_epochs;
+  const std::size_t epochs = GetRungEpochs(job.trial, job.rung);
+  for (; result.trained_epochs < epochs; ++result.trained_epochs) {
+    std::shuffle(state.order.begin(), state.order.end(), state.gen);
+    TrainReplica(*state.mlp, train, state.order, config,
+                 options_.threads_per_trial);
+  }
+  const Metrics metrics = EvaluateReplica(*state.mlp, state.topology,
+                                          validation, validation_indices_);
+  result.loss = metrics.GetLoss();
+  result.accuracy = metrics.GetAccuracy();
+  if (result.trained_epochs == trial.epochs) state.mlp.reset();
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  result.seconds = elapsed.count();
+  return result;
+}
+
+void Sweep::Finish(std::size_t trial) {
+  {
+    std::lock_guard<std::mutex> lock{mtx_};
+    finished_.push_back(trial);
+  }
+  cv_.notify_one();
+}
+
+}  // namespace s21
@@ -0,0 +1,162 @@
+#ifndef MLP_MODEL_MATRIX_MLP_SWEEP_H_
+#define MLP_MODEL_MATRIX_MLP_SWEEP_H_
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+
+#include "config.h"
+#include "io.h"
+#include "matrix_mlp.h"
+#include "thread_pool.h"
+
+namespace s21 {
+
+/**
+ * @struct SweepSpace
+ * @brief Values tried by a hyperparameter sweep.
+ *
+ * A grid search tries every combination. A random search draws the learning
+ * rate log-uniformly between the smallest and the largest listed rate and
+ * picks every other value from its list.
+ */
+struct SweepSpace {
+  std::vector<double> learning_rates{0.01};
+  std::vector<std::size_t> hidden_sizes{100};
+  std::vector<std::size_t> hidden_counts{2};
+  std::vector<std::size_t> epochs{5};
+  std::vector<std::size_t> batch_sizes{1};
+};
+
+/**
+ * @struct SweepOptions
+ * @brief Search, scheduling and pruning settings of a sweep.
+ *
+ * Trials are pruned by asynchronous successive halving (ASHA): rung k trains
+ * a trial up to min_epochs * reduction^k epochs, and a trial is promoted to
+ * the next rung once its validation loss is in the best 1 / reduction of the
+ * trials that reached its rung so far. A reduction of 1 trains every trial
+ * to its full epochs. The cores are split into trials of threads_per_trial
+ * threads each.
+ */
+struct SweepOptions {
+  enum class Search { kGrid, kRandom };
+
+  Search search = Search::kGrid;
+  std::size_t trials = 16;
+  std::size_t threads = 0;
+  std::size_t threads_per_trial = 1;
+  std::size_t min_epochs = 1;
+  std::size_t reduction = 3;
+  unsigned seed = 42;
+};
+
+/**
+ * @struct SweepTrial
+ * @brief Hyperparameters and results of one trial of a sweep.
+ *
+ * The loss is the latest validation loss, and rung_losses[k] the one at the
+ * end of rung k, which ranks the trial against the others of that rung.
+ */
+struct SweepTrial {
+  std::size_t id = 0;
+  double learning_rate = 0.0;
+  std::size_t hidden_size = 0;
+  std::size_t hidden_count = 0;
+  std::size_t epochs = 0;
+  std::size_t batch_size = 0;
+  std::size_t trained_epochs = 0;
+  double loss = 0.0;
+  std::vector<double> rung_losses;
+  double accuracy = 0.0;
+  double seconds = 0.0;
+  bool pruned = false;
+};
+
+/**
+ * @struct Leaderboard
+ * @brief Trials of a sweep, best validation loss first.
+ */
+struct Leaderboard {
+  std::vector<SweepTrial> trials;
+
+  std::string ToCsv() const;
+  std::string ToJson() const;
+};
+
+/**
+ * @class Sweep
+ * @brief Trains many configurations of a network concurrently and ranks
+ * them by validation loss.
+ *
+ * Every trial is a MatrixMlp of its own built from the base topology and
+ * config, with the hidden layers, learning rate and batch size of the trial.
+ * All trials read the same training and validation images, which are parsed
+ * once and never copied. The weights of a trial are drawn from the sweep
+ * seed plus the trial id, so a sweep is reproducible. The base config sets
+ * everything else, such as the optimizer and the memory budget.
+ */
+class Sweep {
+ public:
+  using TrialFunc = std::function<void(const SweepTrial &)>;
+
+  Sweep(const Topology &, const Config &, const SweepSpace &,
+        const SweepOptions &);
+
+  Leaderboard Run(const Dataset &train, const Dataset &validation,
+                  const TrialFunc & = {});
+  const std::vector<SweepTrial> &GetTrials() const { return trials_; }
+
+ private:
+  struct Job {
+    std::size_t trial;
+    std::size_t rung;
+  };
+
+  // Outcome of a job, published to the trial by the scheduler
+  struct JobResult {
+    std::size_t rung = 0;
+    std::size_t trained_epochs = 0;
+    double loss = 0.0;
+    double accuracy = 0.0;
+    double seconds = 0.0;
+  };
+
+  // Touched by one job at a time; busy and rung are only touched by Run
+  struct State {
+    Topology topology;
+    std::unique_ptr<MatrixMlp> mlp;
+    std::vector<std::size_t> order;
+    std::mt19937 gen;
+    std::size_t rung = 0;
+    bool busy = false;
+  };
+
+  void MakeTrials();
+  std::size_t GetRungEpochs(std::size_t trial, std::size_t rung) const;
+  bool NextJob(Job &);
+  JobResult RunJob(const Job &, const Dataset &, const Dataset &);
+  void Finish(std::size_t trial);
+
+  Topology topology_;
+  Config config_;
+  SweepSpace space_;
+  SweepOptions options_;
+  std::vector<SweepTrial> trials_;
+  std::vector<State> states_;
+  std::vector<std::size_t> validation_indices_;
+  // Trials that finished each rung
+  std::vector<std::vector<std::size_t>> rungs_;
+  std::size_t started_ = 0;
+  // Trials whose job ended, guarded by mtx_
+  std::vector<std::size_t> finished_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_MATRIX_MLP_SWEEP_H_
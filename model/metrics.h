@@ -1,6 +1,7 @@
 #ifndef MLP_MODEL_METRICS_H_
 #define MLP_MODEL_METRICS_H_
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <iostream>
@@ -12,6 +13,23 @@
 
 namespace s21 {
 
+/**
+ * @struct OnlineStats
+ * @brief Counters of online learning.
+ */
+struct OnlineStats {
+  std::size_t steps = 0;
+  std::size_t samples = 0;
+  std::size_t replayed = 0;
+  double seconds = 0.0;
+  double last_latency = 0.0;
+  double max_latency = 0.0;
+
+  // New samples learned per second of training steps
+  double GetThroughput() const { return seconds > 0.0 ? samples / seconds : 0; }
+  double GetAverageLatency() const { return steps ? seconds / steps : 0.0; }
+};
+
 /**
  * @class Metrics
  * @brief Class for calculating various evaluation metrics and tracking
@@ -30,7 +48,13 @@ class Metrics {
         fn_(num_classes, 0),
         loss_(0.0),
         time_(0),
-        size_(1) {}
+        size_(1),
+        cross_entropy_(false),
+        validation_loss_(0.0),
+        epochs_saved_(0),
+        snapshot_epoch_(0),
+        allocations_(0),
+        allocations_counted_(false) {}
 
   void AddTruePositive(std::size_t label) { ++tp_[label - 1]; }
   void AddFalsePositive(std::size_t label) { ++fp_[label - 1]; }
@@ -99,11 +123,61 @@ class Metrics {
     return loss;
   }
 
+  static double GetCrossEntropy(const Vector& predict, std::size_t label) {
+    return -std::log(std::max(predict[label - 1], 1e-12));
+  }
+
+  // Loss of a prediction against a label (starting from 1), without building
+  // the one-hot expected vector
+  static double GetLoss(const Vector& predict, std::size_t label,
+                        bool cross_entropy) {
+    if (cross_entropy) return GetCrossEntropy(predict, label);
+    double loss = 0.0;
+    for (std::size_t i = 0; i < predict.size(); ++i) {
+      double diff = (i + 1 == label ? 1.0 : 0.0) - predict[i];
+      loss += diff * diff;
+    }
+    return loss;
+  }
+
   double GetLoss() const { return loss_ / size_; }
   void SetLoss(double loss) { loss_ = loss; }
   void AddLoss(const Vector& predict, const Vector& expect) {
     loss_ += GetMSE(predict, expect);
   }
+  void AddLoss(double loss) { loss_ += loss; }
+  void AddLoss(const Vector& predict, std::size_t label) {
+    loss_ += GetLoss(predict, label, cross_entropy_);
+  }
+  bool IsCrossEntropy() const { return cross_entropy_; }
+  void SetCrossEntropy(bool cross_entropy) { cross_entropy_ = cross_entropy; }
+  const char* GetLossName() const {
+    return cross_entropy_ ? "Cross-entropy" : "MSE";
+  }
+
+  // Set by training runs with a validation slice; epochs saved counts the
+  // epochs skipped by early stopping
+  double GetValidationLoss() const { return validation_loss_; }
+  void SetValidationLoss(double loss) { validation_loss_ = loss; }
+  std::size_t GetEpochsSaved() const { return epochs_saved_; }
+  void SetEpochsSaved(std::size_t epochs) { epochs_saved_ = epochs; }
+
+  // Heap allocations of the last epoch, set while AllocationCounter counts
+  bool HasAllocations() const { return allocations_counted_; }
+  std::size_t GetAllocations() const { return allocations_; }
+  void SetAllocations(std::size_t allocations) {
+    allocations_ = allocations;
+    allocations_counted_ = true;
+  }
+  // Epoch of the weights evaluated by asynchronous validation, from 1; 0 for
+  // the metrics of training and of synchronous tests
+  std::size_t GetSnapshotEpoch() const { return snapshot_epoch_; }
+  void SetSnapshotEpoch(std::size_t epoch) { snapshot_epoch_ = epoch; }
+
+  const std::vector<double>& GetThroughput() const { return throughput_; }
+  void SetThroughput(const std::vector<double>& throughput) {
+    throughput_ = throughput;
+  }
 
   long long GetTotalTime() const { return time_; }
   void SetTime(long long time) { time_ += time; }
@@ -117,6 +191,18 @@ class Metrics {
     }
   }
 
+  // Adds the counts and the loss of metrics over other images of the same
+  // classes
+  void Merge(const Metrics& other) {
+    for (std::size_t i = 0; i < tp_.size(); ++i) {
+      tp_[i] += other.tp_[i];
+      fp_[i] += other.fp_[i];
+      tn_[i] += other.tn_[i];
+      fn_[i] += other.fn_[i];
+    }
+    loss_ += other.loss_;
+  }
+
   void StartMeasure(std::size_t size) {
     Clear();
     size_ = size;
@@ -131,6 +217,7 @@ class Metrics {
     loss_ = 0.0;
     time_ = 0;
     size_ = 1;
+    throughput_.clear();
   }
 
   void StartTimer() { start_time_ = std::chrono::high_resolution_clock::now(); }
@@ -144,7 +231,7 @@ class Metrics {
 
   void TestReport() const {
     std::cout << "Test on " << size_ << " images\n";
-    std::cout << "\tLoss: " << GetLoss() << std::endl;
+    std::cout << "\tLoss (" << GetLossName() << "): " << GetLoss() << std::endl;
     std::cout << "\tAccuracy: " << GetAccuracy() << std::endl;
     std::cout << "\tPrecision: " << GetPrecision() << std::endl;
     std::cout << "\tRecall: " << GetRecall() << std::endl;
@@ -164,7 +251,18 @@ class Metrics {
     std::cout << "\nEpoch: " << epoch + 1 << std::endl;
     std::cout << "\nTime Elapsed: " << epoch_time << " seconds\n";
     std::cout << "Time Remaining: " << remaining_time << " seconds\n";
-    std::cout << "Loss: " << GetLoss() << "\n\n";
+    std::cout << "Loss (" << GetLossName() << "): " << GetLoss() << "\n";
+    if (validation_loss_ > 0.0) {
+      std::cout << "Validation loss: " << validation_loss_ << "\n";
+    }
+    if (allocations_counted_) {
+      std::cout << "Allocations: " << allocations_ << "\n";
+    }
+    for (std::size_t i = 0; i < throughput_.size(); ++i) {
+      std::cout << "Thread " << i << ": " << throughput_[i]
+                << " samples/sec\n";
+    }
+    std::cout << "\n";
   }
 
  private:
@@ -172,9 +270,70 @@ class Metrics {
   double loss_;
   long long time_;
   std::size_t size_;
+  bool cross_entropy_;
+  double validation_loss_;
+  std::size_t epochs_saved_;
+  std::size_t snapshot_epoch_;
+  std::size_t allocations_;
+  bool allocations_counted_;
+  std::vector<double> throughput_;
   std::chrono::time_point<std::chrono::high_resolution_clock> start_time_;
 };
 
+/**
+ * @struct FoldSummary
+ * @brief Metrics of every fold of a cross-validation merged into the mean
+ * and the sample standard deviation over the folds.
+ */
+struct FoldSummary {
+  struct Statistic {
+    double mean = 0.0;
+    double stddev = 0.0;
+  };
+
+  FoldSummary() = default;
+  explicit FoldSummary(const std::vector<Metrics>& metrics)
+      : folds{metrics},
+        loss{Merge([](const Metrics& m) { return m.GetLoss(); })},
+        accuracy{Merge([](const Metrics& m) { return m.GetAccuracy(); })},
+        precision{Merge([](const Metrics& m) { return m.GetPrecision(); })},
+        recall{Merge([](const Metrics& m) { return m.GetRecall(); })},
+        f1_score{Merge([](const Metrics& m) { return m.GetF1Score(); })} {}
+
+  void Report() const {
+    std::cout << "Cross-validation on " << folds.size() << " folds\n";
+    Print("Loss", loss);
+    Print("Accuracy", accuracy);
+    Print("Precision", precision);
+    Print("Recall", recall);
+    Print("F1 Score", f1_score);
+  }
+
+  std::vector<Metrics> folds;
+  Statistic loss, accuracy, precision, recall, f1_score;
+
+ private:
+  template <typename Getter>
+  Statistic Merge(Getter get) const {
+    Statistic statistic;
+    if (folds.empty()) return statistic;
+    for (const Metrics& fold : folds) statistic.mean += get(fold);
+    statistic.mean /= folds.size();
+    if (folds.size() < 2) return statistic;
+    for (const Metrics& fold : folds) {
+      const double diff = get(fold) - statistic.mean;
+      statistic.stddev += diff * diff;
+    }
+    statistic.stddev = std::sqrt(statistic.stddev / (folds.size() - 1));
+    return statistic;
+  }
+
+  static void Print(const char* name, const Statistic& statistic) {
+    std::cout << "\t" << name << ": " << statistic.mean << " +- "
+              << statistic.stddev << std::endl;
+  }
+};
+
 }  // namespace s21
 
 #endif  // MLP_MODEL_METRICS_H_
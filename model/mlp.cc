@@ -3,8 +3,15 @@
 namespace s21 {
 
 MLP::MLP(const Topology& topology)
-    : topology_{topology}, metrics_{topology_.GetOutputSize()} {
+    : ptr_metrics_{[](Metrics&) {}},
+      ptr_progress_{[](int) {}},
+      ptr_full_progress_{[](double) {}},
+      topology_{topology},
+      metrics_{topology_.GetOutputSize()},
+      replay_{config_.GetReplayCapacity()} {
   mlp_ = std::make_unique<MatrixMlp>(topology_);
+  mlp_->SetOptimizer(MakeOptimizer(config_));
+  ResetMetrics();
 }
 
 void MLP::Train() {
@@ -14,6 +21,8 @@ void MLP::Train() {
 
   switch (config_.GetTrainType()) {
     case Config::TrainType::kTrain:
+    case Config::TrainType::kHogwild:
+    case Config::TrainType::kPipeline:
       TrainEpochs();
       break;
     case Config::TrainType::kCrossValidation:
@@ -24,69 +33,453 @@ void MLP::Train() {
   }
 }
 
-void MLP::TrainEpoch(const Dataset& train) {
-  std::size_t percent = static_cast<std::size_t>(train.size() / 100.0);
+void MLP::TrainEpoch(const Dataset& train, std::size_t begin) {
+  last_progress_ = -1;
+  if (config_.GetTrainType() == Config::TrainType::kHogwild) {
+    TrainHogwild(train);
+    return;
+  }
+
+  if (config_.GetTrainType() == Config::TrainType::kPipeline) {
+    Pipeline trainer(GetMatrixMlp(), config_.GetThreads(),
+                     config_.GetMicroBatches());
+    TrainBatches(train, trainer, begin);
+    return;
+  }
 
-  for (std::size_t i = 0; i < train.size(); ++i) {
+  if (mixed_precision_) {
+    TrainBatches(train, *mixed_precision_, begin);
+    return;
+  }
+
+  if (config_.GetBatchSize() > 1 or config_.GetThreads() > 1) {
+    DataParallel trainer(GetMatrixMlp(), config_.GetThreads());
+    trainer.SetMemoryBudget(config_.GetMemoryBudget());
+    if (sampler_) {
+      TrainSampled(train, trainer);
+    } else {
+      TrainBatches(train, trainer, begin);
+    }
+    return;
+  }
+
+  if (sampler_) {
+    TrainSampled(train);
+    return;
+  }
+
+  for (std::size_t i = begin; i < train.size(); ++i) {
     mlp_->SetInputLayer(train[i].GetPixels());
     mlp_->ForwardPropagation();
-    const Vector expected_output = ExpectedOutput(train[i]);
-    mlp_->BackPropagation(expected_output, config_.GetLearningRate());
-    metrics_.AddLoss(mlp_->GetOutput(), expected_output);
+    mlp_->BackPropagation(ExpectedOutput(train[i]), config_.GetLearningRate());
+    metrics_.AddLoss(mlp_->GetOutput(), train[i].GetLabel());
+    MaybeCheckpoint(epoch_, i + 1, config_.GetLearningRate());
+    ReportProgress(i + 1, train.size());
+  }
+}
 
-    if (i % percent == 0) {
-      ptr_progress_((i / percent) + 1);
+template <typename Trainer>
+void MLP::TrainBatches(const Dataset& train, Trainer& trainer,
+                       std::size_t first) {
+  std::vector<std::size_t> indices(train.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  const std::size_t batch_size = config_.GetBatchSize();
+
+  for (std::size_t begin = first; begin < train.size(); begin += batch_size) {
+    std::size_t end = std::min(begin + batch_size, train.size());
+    metrics_.AddLoss(trainer.TrainBatch(train, indices, begin, end,
+                                        config_.GetLearningRate()));
+    MaybeCheckpoint(epoch_, end, config_.GetLearningRate());
+    ReportProgress(end, train.size());
+  }
+}
+
+/**
+ * Trains an epoch of per-sample updates on samples drawn by the importance
+ * sampler, scaling the learning rate of every sample by its bias correction.
+ */
+void MLP::TrainSampled(const Dataset& train) {
+  const std::vector<std::size_t> indices = sampler_->Draw(train.size());
+  for (std::size_t i = 0; i < indices.size(); ++i) {
+    const Image& image = train[indices[i]];
+    mlp_->SetInputLayer(image.GetPixels());
+    mlp_->ForwardPropagation();
+    const double loss = Metrics::GetLoss(mlp_->GetOutput(), image.GetLabel(),
+                                         topology_.IsCrossEntropy());
+    metrics_.AddLoss(loss);
+    const double rate =
+        config_.GetLearningRate() * sampler_->GetWeight(indices[i]);
+    mlp_->BackPropagation(ExpectedOutput(image), rate);
+    sampler_->Update(indices[i], loss);
+    ReportProgress(i + 1, indices.size());
+  }
+}
+
+/**
+ * Trains an epoch of mini-batches drawn by the importance sampler, weighting
+ * the gradient of every sample by its bias correction.
+ */
+void MLP::TrainSampled(const Dataset& train, DataParallel& trainer) {
+  const std::vector<std::size_t> indices = sampler_->Draw(train.size());
+  Vector weights(indices.size());
+  for (std::size_t i = 0; i < indices.size(); ++i) {
+    weights[i] = sampler_->GetWeight(indices[i]);
+  }
+  trainer.SetSampleWeights(&weights);
+
+  const std::size_t batch_size = config_.GetBatchSize();
+  for (std::size_t begin = 0; begin < indices.size(); begin += batch_size) {
+    std::size_t end = std::min(begin + batch_size, indices.size());
+    metrics_.AddLoss(trainer.TrainBatch(train, indices, begin, end,
+                                        config_.GetLearningRate()));
+    for (std::size_t i = begin; i < end; ++i) {
+      sampler_->Update(indices[i], trainer.GetSampleLosses()[i]);
     }
+    ReportProgress(end, indices.size());
   }
+  trainer.SetSampleWeights(nullptr);
+}
+
+void MLP::TrainHogwild(const Dataset& train) {
+  Hogwild trainer(GetMatrixMlp(), config_.GetThreads());
+  metrics_.AddLoss(trainer.Train(train, config_.GetLearningRate()));
+  metrics_.SetThroughput(trainer.GetThroughput());
+  ReportProgress(1, 1);
 }
 
+/**
+ * Runs the configured epochs over the train dataset.
+ *
+ * With a validation split, the tail of the shuffled train dataset is held
+ * out, the validation loss is measured after every epoch and the weights of
+ * the best epoch are restored at the end. Training stops early once the
+ * validation loss hasn't improved for the configured patience, and the
+ * skipped epochs are reported by Metrics::GetEpochsSaved. The learning rate
+ * of every epoch follows the configured schedule.
+ *
+ * All shuffles come from one seed, so a run resumed from a checkpoint
+ * replays the sample order of the finished epochs and continues with the
+ * same order as the interrupted run.
+ */
 void MLP::TrainEpochs() {
-  double percent = static_cast<double>(100.0 / config_.GetEpochs());
+  Densify();
+  const std::size_t epochs = config_.GetEpochs();
+  double percent = static_cast<double>(100.0 / epochs);
+  const std::unique_ptr<Checkpoint> resume = std::move(resume_);
+  if (resume) {
+    seed_ = static_cast<unsigned>(resume->seed);
+  } else {
+    seed_ = config_.GetSeed() ? config_.GetSeed() : std::random_device{}();
+  }
+  std::mt19937 gen(seed_);
 
-  metrics_.StartMeasure(train_.size());
-  for (std::size_t epoch = 0; epoch < config_.GetEpochs(); ++epoch) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+  const auto held_out = static_cast<std::size_t>(
+      train_.size() * config_.GetValidationSplit());
+  Dataset validation;
+  if (held_out and held_out < train_.size()) {
     std::shuffle(train_.begin(), train_.end(), gen);
+    validation.assign(std::make_move_iterator(train_.end() - held_out),
+                      std::make_move_iterator(train_.end()));
+    train_.resize(train_.size() - held_out);
+  }
+
+  const double base_rate = config_.GetLearningRate();
+  LrSchedule schedule(config_);
+  Tensor best_weights, best_biases;
+  double best_loss = std::numeric_limits<double>::infinity();
+  std::size_t best_epoch = 0, epoch = 0;
+
+  std::unique_ptr<AsyncValidator> validator;
+  if (config_.GetAsyncValidation() and !test_.empty()) {
+    validator = std::make_unique<AsyncValidator>(topology_, SpareThreads());
+  }
+
+  // The sampler keys its loss estimates by position, so the dataset keeps
+  // its order while it is used. Only the per-sample and data-parallel
+  // trainers draw from it; the others keep shuffling.
+  if (config_.GetImportanceSampling() and
+      config_.GetTrainType() == Config::TrainType::kTrain and
+      config_.GetPrecision() != Config::Precision::kMixed) {
+    sampler_ = std::make_unique<ImportanceSampler>(train_.size());
+  }
+
+  std::size_t begin = 0;
+  if (resume) {
+    for (; epoch < resume->epoch; ++epoch) {
+      if (!sampler_) std::shuffle(train_.begin(), train_.end(), gen);
+    }
+    schedule.Restore(epoch, resume->learning_rate);
+    begin = std::min<std::size_t>(resume->sample, train_.size());
+    best_epoch = epoch;
+  }
+  if (!checkpoint_path_.empty() and (config_.GetCheckpointSamples() or
+                                     config_.GetCheckpointSeconds() > 0.0)) {
+    checkpoints_ = std::make_unique<CheckpointWriter>(checkpoint_path_);
+    checkpoint_sample_ = epoch * train_.size() + begin;
+    checkpoint_time_ = std::chrono::steady_clock::now();
+  }
+
+  metrics_.StartMeasure(train_.size());
+  metrics_.SetValidationLoss(0.0);
+  metrics_.SetEpochsSaved(0);
+  try {
+    // The loss scale carries over from one epoch to the next
+    if (config_.GetTrainType() == Config::TrainType::kTrain and
+        config_.GetPrecision() == Config::Precision::kMixed) {
+      mixed_precision_ = std::make_unique<MixedPrecision>(GetMatrixMlp());
+      if (resume and resume->loss_scale > 0.0) {
+        mixed_precision_->Restore(resume->loss_scale, resume->good_steps);
+      }
+    }
+    while (epoch < epochs) {
+      if (!sampler_) std::shuffle(train_.begin(), train_.end(), gen);
+
+      config_.SetLearningRate(schedule.GetRate());
+      epoch_ = epoch;
+      const std::size_t allocations = AllocationCounter::GetCount();
+      TrainEpoch(train_, begin);
+      begin = 0;
+      if (AllocationCounter::IsEnabled()) {
+        metrics_.SetAllocations(AllocationCounter::GetCount() - allocations);
+      }
 
-    TrainEpoch(train_);
+      double loss = metrics_.GetLoss();
+      if (!validation.empty()) {
+        loss = Validate(validation);
+        metrics_.SetValidationLoss(loss);
+        if (loss < best_loss) {
+          best_loss = loss;
+          best_epoch = epoch;
+          std::tie(best_weights, best_biases) = mlp_->GetMlp();
+        }
+      }
+      schedule.Step(loss);
+
+      if (config_.GetVerbose()) {
+        metrics_.TrainReport(epochs, epoch);
+      }
 
+      ++epoch;
+      // The last epoch of an early stop reports the skipped epochs
+      const bool stop = config_.GetPatience() and !validation.empty() and
+                        epoch - best_epoch > config_.GetPatience();
+      if (stop) metrics_.SetEpochsSaved(epochs - epoch);
+      MaybeCheckpoint(epoch, 0, schedule.GetRate());
+      if (validator and epoch % config_.GetAsyncValidation() == 0) {
+        validator->Submit(epoch, *mlp_, test_);
+      }
+      ReportFullProgress(epoch * percent);
+      ReportMetrics(metrics_);
+      metrics_.SetLoss(0);
+      if (validator) ReportValidation(*validator, false);
+      if (stop) break;
+    }
+  } catch (...) {
+    checkpoints_.reset();
+    mixed_precision_.reset();
+    sampler_.reset();
+    config_.SetLearningRate(base_rate);
+    train_.insert(train_.end(), std::make_move_iterator(validation.begin()),
+                  std::make_move_iterator(validation.end()));
+    throw;
+  }
+
+  // A failed checkpoint write is rethrown once the run is cleaned up
+  std::exception_ptr error;
+  mixed_precision_.reset();
+  sampler_.reset();
+  config_.SetLearningRate(base_rate);
+  if (checkpoints_) {
+    const std::unique_ptr<CheckpointWriter> writer = std::move(checkpoints_);
+    try {
+      writer->Wait();
+    } catch (...) {
+      error = std::current_exception();
+    }
+  }
+  if (!validation.empty()) {
+    if (!best_weights.empty()) RestoreWeights(best_weights, best_biases);
+    train_.insert(train_.end(), std::make_move_iterator(validation.begin()),
+                  std::make_move_iterator(validation.end()));
+  }
+  metrics_.SetEpochsSaved(epochs - epoch);
+  if (epoch < epochs) {
     if (config_.GetVerbose()) {
-      metrics_.TrainReport(config_.GetEpochs(), epoch);
+      std::cout << "Stopped early after " << epoch << " epochs, best epoch "
+                << best_epoch + 1 << "\n";
     }
+    ReportFullProgress(100.0);
+  }
+  if (validator) ReportValidation(*validator, true);
+  if (error) std::rethrow_exception(error);
+}
 
-    ptr_full_progress_((epoch * percent) + percent);
-    ptr_metrics_(metrics_);
-    metrics_.SetLoss(0);
+/**
+ * Passes the finished asynchronous evaluations to the metrics callback.
+ *
+ * @param validator The validator.
+ * @param wait If true, waits for every queued evaluation.
+ */
+void MLP::ReportValidation(AsyncValidator& validator, bool wait) {
+  for (Metrics& metrics : validator.Collect(wait)) {
+    if (config_.GetVerbose()) {
+      std::cout << "Validation of epoch " << metrics.GetSnapshotEpoch()
+                << ":\n";
+      metrics.TestReport();
+    }
+    ReportMetrics(metrics);
   }
 }
 
-void MLP::Test(const Dataset& test) {
-  std::vector<std::size_t> indices(test.size());
-  std::iota(indices.begin(), indices.end(), 0);
-  std::shuffle(indices.begin(), indices.end(), std::default_random_engine());
-  std::size_t test_size =
-      static_cast<std::size_t>(test.size() * config_.GetTestSample());
-  std::size_t percent = static_cast<std::size_t>(test_size / 100.0);
+/**
+ * Reports the progress of an epoch, only when its whole percentage changes,
+ * so the per-sample loops pay a division and a comparison per sample.
+ *
+ * @param done Samples or batches done.
+ * @param total Samples or batches of the epoch.
+ */
+void MLP::ReportProgress(std::size_t done, std::size_t total) {
+  const int percent = total ? static_cast<int>(done * 100 / total) : 100;
+  if (percent == last_progress_) return;
+  last_progress_ = percent;
+  if (events_) {
+    events_->PublishProgress(Event::Type::kProgress, percent);
+  } else {
+    ptr_progress_(percent);
+  }
+}
+
+/**
+ * Submits a checkpoint once the configured samples or seconds have passed
+ * since the last one. The training thread only copies the state; the file
+ * is written by the checkpoint writer's thread.
+ *
+ * @throws std::runtime_error if the writer failed to write a checkpoint.
+ *
+ * @param epoch The finished epochs.
+ * @param done The samples done in the current epoch.
+ * @param rate The learning rate of the current epoch, or of the next one
+ * at the end of an epoch.
+ */
+void MLP::MaybeCheckpoint(std::size_t epoch, std::size_t done, double rate) {
+  // The end of an epoch is checkpointed as the start of the next one
+  if (!checkpoints_ or done == train_.size()) return;
+  const std::size_t sample = epoch * train_.size() + done;
+  const std::size_t every = config_.GetCheckpointSamples();
+  bool due = every and sample - checkpoint_sample_ >= every;
+  if (!due and config_.GetCheckpointSeconds() > 0.0) {
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - checkpoint_time_;
+    due = elapsed.count() >= config_.GetCheckpointSeconds();
+  }
+  if (!due) return;
+  checkpoints_->Check();
+  checkpoint_sample_ = sample;
+  checkpoint_time_ = std::chrono::steady_clock::now();
+
+  Checkpoint checkpoint;
+  std::tie(checkpoint.weights, checkpoint.biases) = mlp_->GetMlp();
+  checkpoint.activations = topology_.GetActivations();
+  if (auto* matrix_mlp = dynamic_cast<MatrixMlp*>(mlp_.get())) {
+    checkpoint.weight_slots = matrix_mlp->GetWeightSlots();
+    checkpoint.bias_slots = matrix_mlp->GetBiasSlots();
+    checkpoint.optimizer_step = matrix_mlp->GetOptimizer().GetStep();
+  }
+  if (mixed_precision_) {
+    checkpoint.loss_scale = mixed_precision_->GetLossScale();
+    checkpoint.good_steps = mixed_precision_->GetGoodSteps();
+  }
+  checkpoint.epoch = epoch;
+  checkpoint.sample = done;
+  checkpoint.seed = seed_;
+  checkpoint.learning_rate = rate;
+  checkpoints_->Submit(std::move(checkpoint));
+}
+
+void MLP::ReportFullProgress(double percent) {
+  if (events_) {
+    events_->PublishProgress(Event::Type::kFullProgress, percent);
+  } else {
+    ptr_full_progress_(percent);
+  }
+}
+
+void MLP::ReportMetrics(Metrics& metrics) {
+  if (events_) {
+    events_->PublishMetrics(metrics);
+  } else {
+    ptr_metrics_(metrics);
+  }
+}
+
+/**
+ * @return The number of cores left over by the training threads, at least 1.
+ */
+std::size_t MLP::SpareThreads() const {
+  const std::size_t cores = std::thread::hardware_concurrency();
+  return cores > config_.GetThreads() ? cores - config_.GetThreads() : 1;
+}
 
-  metrics_.StartMeasure(test_size);
-  for (std::size_t i = 0; i < test_size; ++i) {
-    const Image& image = test[indices[i]];
+/**
+ * @return The average loss over a dataset, without updating the metrics.
+ */
+double MLP::Validate(const Dataset& dataset) {
+  double loss = 0.0;
+  for (const Image& image : dataset) {
     mlp_->SetInputLayer(image.GetPixels());
     mlp_->ForwardPropagation();
+    loss += Metrics::GetLoss(mlp_->GetOutput(), image.GetLabel(),
+                             topology_.IsCrossEntropy());
+  }
+  return loss / dataset.size();
+}
 
-    metrics_.AddLoss(mlp_->GetOutput(), ExpectedOutput(image));
-    metrics_.AddPrediction(PredictLabel(image), image.GetLabel());
+/**
+ * Puts back earlier weights, keeping the pruning masks of the matrix model.
+ */
+void MLP::RestoreWeights(const Tensor& weights, const Tensor& biases) {
+  auto* matrix_mlp = dynamic_cast<MatrixMlp*>(mlp_.get());
+  Tensor masks;
+  if (matrix_mlp) masks = matrix_mlp->GetMasks();
+  mlp_->SetMlp(weights, biases);
+  if (matrix_mlp) matrix_mlp->SetMasks(masks);
+}
 
-    if (i % percent == 0) {
-      ptr_progress_((i / percent) + 1);
-    }
+/**
+ * Tests on a sample of the dataset with one forward pass per image, split
+ * across every core. The graph model is tested through a matrix copy of its
+ * weights.
+ */
+void MLP::Test(const Dataset& test) {
+  std::vector<std::size_t> indices(test.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  std::shuffle(indices.begin(), indices.end(), std::default_random_engine());
+  indices.resize(
+      static_cast<std::size_t>(test.size() * config_.GetTestSample()));
+
+  const MatrixMlp* matrix_mlp = dynamic_cast<MatrixMlp*>(mlp_.get());
+  std::unique_ptr<MatrixMlp> snapshot;
+  if (!matrix_mlp) {
+    snapshot = std::make_unique<MatrixMlp>(topology_);
+    const auto [weights, biases] = mlp_->GetMlp();
+    snapshot->SetMlp(weights, biases);
+    matrix_mlp = snapshot.get();
   }
-  metrics_.StopMeasure();
+
+  Evaluator evaluator(std::max(1u, std::thread::hardware_concurrency()));
+  evaluator.Evaluate(*matrix_mlp, topology_, test, indices, metrics_,
+                     [this](int percent) {
+                       if (events_) {
+                         events_->PublishProgress(Event::Type::kTestProgress,
+                                                  percent);
+                       } else {
+                         ptr_progress_(percent);
+                       }
+                     });
   if (config_.GetVerbose()) {
     metrics_.TestReport();
   }
-  ptr_metrics_(metrics_);
+  ReportMetrics(metrics_);
 }
 
 void MLP::Test() {
@@ -97,45 +490,246 @@ void MLP::Test() {
   Test(test_);
 }
 
+/**
+ * Trains every fold on its own replica of the current model, all folds at
+ * once on the available cores. The validation metrics of every fold are
+ * reported as they end and merged into the fold summary; the model keeps the
+ * weights of the fold with the best validation accuracy.
+ */
 void MLP::CrossValidate() {
-  std::vector<Dataset> folds(config_.GetKFolds());
+  const std::size_t k_folds = config_.GetKFolds();
+  const std::size_t threads = std::min<std::size_t>(
+      k_folds, std::max(1u, std::thread::hardware_concurrency()));
+  const double percent = 100.0 / k_folds;
+  CrossValidator validator(topology_, config_, threads);
+
+  std::vector<Metrics> folds = validator.Run(
+      *mlp_, train_, [this, percent](std::size_t fold, const Metrics& metrics) {
+        if (config_.GetVerbose()) {
+          std::cout << "Fold " << fold + 1 << ":\n";
+          metrics.TestReport();
+        }
+        Metrics report = metrics;
+        ReportMetrics(report);
+        ReportFullProgress((fold + 1) * percent);
+      });
+
+  fold_summary_ = FoldSummary(folds);
+  if (config_.GetVerbose()) fold_summary_.Report();
+
+  std::size_t best = 0;
+  for (std::size_t fold = 1; fold < folds.size(); ++fold) {
+    if (folds[fold].GetAccuracy() > folds[best].GetAccuracy()) best = fold;
+  }
+  const auto [weights, biases] = validator.GetReplica(best).GetMlp();
+  RestoreWeights(weights, biases);
+  metrics_ = folds[best];
+}
+
+/**
+ * Runs a learning rate range test: trains on the train dataset while the rate
+ * grows exponentially and records the loss of every step. Steps are mini-
+ * batches with the configured batch size, or groups of kRangeGroup per-sample
+ * updates when training is per-sample, so the recommendation matches the way
+ * the model is trained. The weights are restored afterwards.
+ *
+ * @param options The range and the length of the test.
+ * @return The loss curve and the recommended learning rate.
+ * @throws std::runtime_error if the train dataset is empty.
+ * @throws std::invalid_argument if the range is not valid.
+ */
+LrRange MLP::FindLearningRate(const LrRangeOptions& options) {
+  if (train_.empty()) {
+    throw std::runtime_error("Train dataset not loaded.");
+  }
+  if (options.min_rate <= 0.0 or options.max_rate <= options.min_rate or
+      options.steps < 2) {
+    throw std::invalid_argument("Invalid learning rate range");
+  }
+
+  Densify();
+  const auto [weights, biases] = mlp_->GetMlp();
+  const bool batched = config_.GetBatchSize() > 1 or config_.GetThreads() > 1;
+  const std::size_t batch = batched ? config_.GetBatchSize() : kRangeGroup;
+  std::unique_ptr<DataParallel> trainer;
+  if (batched) {
+    trainer = std::make_unique<DataParallel>(GetMatrixMlp(),
+                                             config_.GetThreads());
+  }
   std::vector<std::size_t> indices(train_.size());
   std::iota(indices.begin(), indices.end(), 0);
-  std::shuffle(indices.begin(), indices.end(), std::default_random_engine());
-  double percent = static_cast<double>(100.0 / config_.GetKFolds());
+  std::mt19937 gen(std::random_device{}());
+  std::shuffle(indices.begin(), indices.end(), gen);
 
-  for (std::size_t i = 0; i < indices.size(); ++i) {
-    folds[i % config_.GetKFolds()].push_back(train_[indices[i]]);
-  }
+  LrRange range;
+  const double growth = std::log(options.max_rate / options.min_rate) /
+                        static_cast<double>(options.steps - 1);
+  try {
+    std::size_t begin = 0;
+    for (std::size_t step = 0; step < options.steps; ++step) {
+      const double rate = options.min_rate * std::exp(growth * step);
+      if (begin >= indices.size()) {
+        std::shuffle(indices.begin(), indices.end(), gen);
+        begin = 0;
+      }
+      const std::size_t end = std::min(begin + batch, indices.size());
+
+      double loss = 0.0;
+      if (trainer) {
+        loss = trainer->TrainBatch(train_, indices, begin, end, rate);
+      } else {
+        for (std::size_t i = begin; i < end; ++i) {
+          const Image& image = train_[indices[i]];
+          mlp_->SetInputLayer(image.GetPixels());
+          mlp_->ForwardPropagation();
+          loss += Metrics::GetLoss(mlp_->GetOutput(), image.GetLabel(),
+                                   topology_.IsCrossEntropy());
+          mlp_->BackPropagation(ExpectedOutput(image), rate);
+        }
+      }
+      range.Add(rate, loss / (end - begin), options.smoothing);
+      begin = end;
 
-  for (std::size_t fold = 0; fold < config_.GetKFolds(); ++fold) {
-    Dataset validation = folds[fold];
-    Dataset train;
-    for (std::size_t i = 0; i < folds.size(); ++i) {
-      if (i != fold) {
-        train.insert(train.end(), folds[i].begin(), folds[i].end());
+      const double lowest =
+          *std::min_element(range.smoothed.begin(), range.smoothed.end());
+      if (!std::isfinite(loss) or
+          range.smoothed.back() > options.divergence * lowest) {
+        break;
       }
     }
+  } catch (...) {
+    trainer.reset();
+    RestoreWeights(weights, biases);
+    mlp_->SetOptimizer(MakeOptimizer(config_));
+    throw;
+  }
 
-    std::shuffle(train.begin(), train.end(), std::default_random_engine());
-    metrics_.StartMeasure(train.size());
+  trainer.reset();
+  RestoreWeights(weights, biases);
+  mlp_->SetOptimizer(MakeOptimizer(config_));
+  range.Recommend();
+  return range;
+}
 
-    TrainEpoch(train);
+/**
+ * Learns from a single image of a stream. See Learn(const Dataset&).
+ */
+double MLP::Learn(const Image& image) { return Learn(Dataset{image}); }
 
-    if (config_.GetVerbose()) {
-      metrics_.TrainReport(config_.GetKFolds(), fold);
+/**
+ * Learns from images as they arrive, without a full training run.
+ *
+ * Every step trains on the new images mixed with images replayed from a
+ * fixed-size reservoir of the stream, so the model doesn't forget older data,
+ * and then offers the new images to the reservoir. The cost of a step only
+ * depends on the number of new images and the replay ratio, and the memory on
+ * the replay capacity. Mini-batch settings of the matrix model apply to the
+ * step.
+ *
+ * @param samples The new images.
+ * @return The average loss of the step.
+ */
+double MLP::Learn(const Dataset& samples) {
+  if (samples.empty()) return 0.0;
+  auto start = std::chrono::high_resolution_clock::now();
+  Densify();
+
+  Dataset step = samples;
+  const auto replayed = static_cast<std::size_t>(
+      samples.size() * config_.GetReplayRatio() + 0.5);
+  replay_.Sample(replayed, step);
+
+  double loss = 0.0;
+  if (config_.GetBatchSize() > 1 or config_.GetThreads() > 1) {
+    DataParallel& trainer = GetOnlineTrainer();
+    std::vector<std::size_t> indices(step.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    std::shuffle(indices.begin(), indices.end(), online_gen_);
+    for (std::size_t begin = 0; begin < step.size();
+         begin += config_.GetBatchSize()) {
+      std::size_t end = std::min(begin + config_.GetBatchSize(), step.size());
+      loss += trainer.TrainBatch(step, indices, begin, end,
+                                 config_.GetLearningRate());
+    }
+  } else {
+    for (const Image& image : step) {
+      mlp_->SetInputLayer(image.GetPixels());
+      mlp_->ForwardPropagation();
+      loss += Metrics::GetLoss(mlp_->GetOutput(), image.GetLabel(),
+                               topology_.IsCrossEntropy());
+      mlp_->BackPropagation(ExpectedOutput(image), config_.GetLearningRate());
     }
+  }
+
+  for (const Image& image : samples) replay_.Add(image);
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::high_resolution_clock::now() - start;
+  ++online_stats_.steps;
+  online_stats_.samples += samples.size();
+  online_stats_.replayed += step.size() - samples.size();
+  online_stats_.seconds += elapsed.count();
+  online_stats_.last_latency = elapsed.count();
+  online_stats_.max_latency =
+      std::max(online_stats_.max_latency, elapsed.count());
+  return loss / step.size();
+}
+
+/**
+ * Empties the replay buffer and the online learning counters.
+ */
+void MLP::ResetOnline() {
+  replay_.Clear();
+  online_stats_ = OnlineStats{};
+  online_trainer_.reset();
+}
 
-    Test(validation);
+/**
+ * @return The mini-batch trainer of Learn. It is kept across steps and
+ * rebuilt when the network or the thread count changes, together with the
+ * generator of the step order, seeded from the configured seed.
+ */
+DataParallel& MLP::GetOnlineTrainer() {
+  MatrixMlp& mlp = GetMatrixMlp();
+  if (!online_trainer_ or online_threads_ != config_.GetThreads()) {
+    online_trainer_ = std::make_unique<DataParallel>(mlp, config_.GetThreads());
+    online_threads_ = config_.GetThreads();
+    online_gen_.seed(config_.GetSeed() ? config_.GetSeed()
+                                       : std::random_device{}());
+  }
+  online_trainer_->SetMemoryBudget(config_.GetMemoryBudget());
+  return *online_trainer_;
+}
+
+/**
+ * Makes the factored layers of a compressed matrix network dense before
+ * training, on the calling thread.
+ */
+void MLP::Densify() {
+  if (auto* matrix_mlp = dynamic_cast<MatrixMlp*>(mlp_.get())) {
+    matrix_mlp->Densify();
+  }
+}
 
-    ptr_full_progress_((fold * percent) + percent);
+MatrixMlp& MLP::GetMatrixMlp() {
+  auto* matrix_mlp = dynamic_cast<MatrixMlp*>(mlp_.get());
+  if (!matrix_mlp) {
+    throw std::runtime_error("This training mode requires the matrix model.");
+  }
+  if (matrix_mlp->IsMapped()) {
+    throw std::runtime_error("Mapped weights are read-only.");
   }
+  return *matrix_mlp;
 }
 
-Vector MLP::ExpectedOutput(const Image& image) {
-  Vector expected_output(topology_.GetOutputSize(), 0.0);
-  expected_output[image.GetLabel() - 1] = 1.0;
-  return expected_output;
+/**
+ * @return The one-hot output of an image, in a buffer reused by every sample
+ * and valid until the next call.
+ */
+const Vector& MLP::ExpectedOutput(const Image& image) {
+  expected_.assign(topology_.GetOutputSize(), 0.0);
+  expected_[image.GetLabel() - 1] = 1.0;
+  return expected_;
 }
 
 Vector MLP::Predict(const Vector& input) {
@@ -149,59 +743,153 @@ char MLP::Predict(const Image& image) {
 }
 
 std::size_t MLP::PredictLabel(const Image& image) {
-  Vector input = image.GetPixels();
-  Vector predicted = Predict(input);
+  mlp_->SetInputLayer(image.GetPixels());
+  mlp_->ForwardPropagation();
+  const Vector& predicted = mlp_->GetOutput();
   auto it = std::max_element(predicted.begin(), predicted.end());
   return std::distance(predicted.begin(), it) + 1;
 }
 
 void MLP::SetType(Config::ModelType type) {
   config_.SetModelType(type);
+  online_trainer_.reset();
   if (type == Config::ModelType::kMatrix) {
     mlp_ = std::make_unique<MatrixMlp>(topology_);
   } else if (type == Config::ModelType::kGraph) {
     mlp_ = std::make_unique<GraphMlp>(topology_);
   }
+  mlp_->SetOptimizer(MakeOptimizer(config_));
 }
 
-void MLP::Save(const std::string& path) {
-  std::stringstream ss(path);
-  std::ofstream file(ss.str(), std::ios::binary);
-  if (!file.is_open()) {
-    throw std::runtime_error("Failed to open file: " + ss.str());
-  }
+void MLP::SetOptimizer(Config::OptimizerType type) {
+  config_.SetOptimizer(type);
+  mlp_->SetOptimizer(MakeOptimizer(config_));
+}
 
-  const auto& [weights, biases] = mlp_->GetMlp();
+void MLP::SetMomentum(double momentum) {
+  config_.SetMomentum(momentum);
+  mlp_->SetOptimizer(MakeOptimizer(config_));
+}
 
-  // Write the number of layers
-  std::size_t num_layers = weights.size();
-  file.write(reinterpret_cast<const char*>(&num_layers), sizeof(num_layers));
+/**
+ * Saves the network in the v2 model format described by ModelFile.
+ *
+ * @param path Path of the file.
+ * @throws std::runtime_error if the file can't be written.
+ */
+void MLP::Save(const std::string& path) {
+  auto* matrix_mlp = dynamic_cast<MatrixMlp*>(mlp_.get());
+  if (matrix_mlp and !matrix_mlp->IsMapped()) {
+    // Factored layers are written from their factors, never multiplied out
+    ModelFile::Write(path, matrix_mlp->GetWeights(), matrix_mlp->GetBiases(),
+                     topology_.GetActivations(),
+                     matrix_mlp->GetFactorizations());
+    return;
+  }
+  const auto [weights, biases] = mlp_->GetMlp();
+  ModelFile::Write(path, weights, biases, topology_.GetActivations(),
+                   matrix_mlp ? matrix_mlp->GetFactorizations()
+                              : std::vector<Factorization>{});
+}
 
-  for (std::size_t i = 0; i < num_layers; ++i) {
-    const Matrix& layer_weights = weights[i];
-    const Matrix& layer_biases = biases[i];
-
-    // Write the dimensions of the weight matrix
-    std::size_t rows = layer_weights.size();
-    std::size_t cols = layer_weights[0].size();
-    file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
-    file.write(reinterpret_cast<const char*>(&cols), sizeof(cols));
-
-    // Write the weight matrix
-    for (const Vector& row : layer_weights) {
-      file.write(reinterpret_cast<const char*>(row.data()),
-                 sizeof(double) * cols);
-    }
+/**
+ * Continues an interrupted training run from its last checkpoint. The train
+ * dataset and the config must be those of the interrupted run, as the order
+ * of the samples is replayed from the seed in the checkpoint. The weights,
+ * the optimizer state of the matrix model and the loss scaling of mixed
+ * precision are restored, so the run continues exactly where it stopped.
+ *
+ * Runs whose state isn't in the checkpoint are refused rather than resumed
+ * differently: the graph model with a stateful optimizer, importance
+ * sampling, the plateau schedule and a validation split, whose early
+ * stopping keeps the best weights.
+ *
+ * @param path The checkpoint file.
+ * @throws std::runtime_error if the dataset isn't loaded, the run can't be
+ * resumed exactly or the checkpoint can't be read.
+ */
+void MLP::Resume(const std::string& path) {
+  if (train_.empty()) {
+    throw std::runtime_error("Train dataset not loaded.");
+  }
+  if (config_.GetTrainType() == Config::TrainType::kCrossValidation) {
+    throw std::runtime_error("Cross-validation can't be resumed.");
+  }
+  if (config_.GetModelType() == Config::ModelType::kGraph and
+      config_.GetOptimizer() != Config::OptimizerType::kSgd) {
+    throw std::runtime_error(
+        "The graph model can only resume runs with plain SGD.");
+  }
+  if (config_.GetImportanceSampling()) {
+    throw std::runtime_error("Importance sampling runs can't be resumed.");
+  }
+  if (config_.GetSchedule() == Config::Schedule::kPlateau) {
+    throw std::runtime_error("Plateau schedule runs can't be resumed.");
+  }
+  if (config_.GetValidationSplit() > 0.0) {
+    throw std::runtime_error("Runs with a validation split can't be resumed.");
+  }
 
-    // Write the bias vector
-    for (const Vector& bias : layer_biases) {
-      file.write(reinterpret_cast<const char*>(bias.data()),
-                 sizeof(double) * bias.size());
-    }
+  auto checkpoint = std::make_unique<Checkpoint>(ReadCheckpoint(path));
+  UpdateMlp(checkpoint->weights, checkpoint->biases, checkpoint->activations);
+  auto* matrix_mlp = dynamic_cast<MatrixMlp*>(mlp_.get());
+  if (matrix_mlp and checkpoint->optimizer_step) {
+    matrix_mlp->SetOptimizerState(checkpoint->weight_slots,
+                                  checkpoint->bias_slots,
+                                  checkpoint->optimizer_step);
   }
+  checkpoint->weights.clear();
+  checkpoint->biases.clear();
+  checkpoint->weight_slots.clear();
+  checkpoint->bias_slots.clear();
+  resume_ = std::move(checkpoint);
+  Train();
 }
 
+/**
+ * Loads a network saved in the v2 model format, with a single mmap of the
+ * file, or in the legacy format of earlier versions.
+ *
+ * @param path Path of the file.
+ * @throws std::runtime_error if the file can't be read or is corrupted.
+ */
 void MLP::Load(const std::string& path) {
+  if (!ModelFile::IsModelFile(path)) {
+    LoadLegacy(path);
+    return;
+  }
+  const ModelFile file{path};
+  UpdateMlp(file.CopyWeights(), file.CopyBiases(),
+            file.GetTopology().GetActivations());
+  SetFactorizations(file.CopyFactorizations());
+}
+
+/**
+ * Replaces the network with a read-only matrix network running on the
+ * mapped weights of a v2 model file. The weights are never copied: every
+ * process mapping the file shares them through the page cache. Predict and
+ * Test work as usual; training needs Load or UpdateMlp first.
+ *
+ * @param path Path of the file.
+ * @throws std::runtime_error if the file can't be mapped or is not a valid
+ * v2 model file.
+ */
+void MLP::Map(const std::string& path) {
+  auto file = std::make_shared<const ModelFile>(path);
+  topology_ = file->GetTopology();
+  config_.SetModelType(Config::ModelType::kMatrix);
+  online_trainer_.reset();
+  mlp_ = std::make_unique<MatrixMlp>(std::move(file));
+  mlp_->SetOptimizer(MakeOptimizer(config_));
+  ResetMetrics();
+}
+
+/**
+ * Loads a file of the legacy format: the number of layers, then the
+ * dimensions, weights and biases of every layer, optionally followed by the
+ * activations and the low-rank factors.
+ */
+void MLP::LoadLegacy(const std::string& path) {
   std::ifstream file(path, std::ios::binary);
   if (!file.is_open()) {
     throw std::runtime_error("Failed to open file: " + path);
@@ -234,10 +922,63 @@ void MLP::Load(const std::string& path) {
     biases[i] = std::move(layer_biases);
   }
 
-  UpdateMlp(weights, biases);
+  // Files saved before activations became configurable end here and are
+  // loaded as sigmoid networks
+  std::vector<Activation> activations;
+  std::int32_t value;
+  while (activations.size() < num_layers and
+         file.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+    activations.push_back(static_cast<Activation>(value));
+  }
+  if (activations.size() != num_layers) {
+    activations.assign(num_layers, Activation::kSigmoid);
+  }
+
+  // Low-rank factors follow the activations in files of compressed networks
+  std::vector<Factorization> factorizations(num_layers);
+  for (std::size_t i = 0; i < num_layers; ++i) {
+    std::size_t rank = 0;
+    if (!file.read(reinterpret_cast<char*>(&rank), sizeof(rank))) break;
+    const std::size_t rows = weights[i].size(), cols = weights[i][0].size();
+    Factorization& factorization = factorizations[i];
+    factorization.left.assign(rows, Vector(rank));
+    factorization.right.assign(rank, Vector(cols));
+    for (Matrix* factor : {&factorization.left, &factorization.right}) {
+      for (Vector& row : *factor) {
+        file.read(reinterpret_cast<char*>(row.data()),
+                  sizeof(double) * row.size());
+      }
+    }
+    if (!file) {
+      throw std::runtime_error("Truncated low-rank factors: " + path);
+    }
+  }
+
+  UpdateMlp(weights, biases, activations);
+  SetFactorizations(factorizations);
+}
+
+void MLP::SetFactorizations(const std::vector<Factorization>& factorizations) {
+  if (auto* matrix_mlp = dynamic_cast<MatrixMlp*>(mlp_.get())) {
+    for (std::size_t i = 0; i < factorizations.size(); ++i) {
+      if (factorizations[i].GetRank()) {
+        matrix_mlp->SetFactorization(i, factorizations[i]);
+      }
+    }
+  }
 }
 
-void MLP::UpdateMlp(const Tensor& weights, const Tensor& biases) {
+/**
+ * Replaces the network with the given weights and biases, adjusting the
+ * topology to their sizes.
+ *
+ * @param weights Weight matrices of every layer.
+ * @param biases Bias rows of every layer.
+ * @param activations Activation of every layer. The current ones are kept
+ * when it is empty or doesn't match the number of layers.
+ */
+void MLP::UpdateMlp(const Tensor& weights, const Tensor& biases,
+                    const std::vector<Activation>& activations) {
   std::vector<std::size_t> layer_sizes;
   layer_sizes.push_back(weights[0].size());
 
@@ -246,12 +987,44 @@ void MLP::UpdateMlp(const Tensor& weights, const Tensor& biases) {
   }
 
   topology_.SetTopology(layer_sizes);
+  topology_.SetActivations(activations);
   SetType(config_.GetModelType());
   mlp_->SetMlp(weights, biases);
-  metrics_ = Metrics{topology_.GetOutputSize()};
+  ResetMetrics();
 }
 
-void MLP::UpdateTopology(std::size_t hidden, std::size_t size) {
+/**
+ * Replaces the network with one of the given hidden layers.
+ *
+ * @param hidden Number of hidden layers.
+ * @param size Size of every hidden layer.
+ * @param grow If true, the trained network is grown into the new topology
+ * with Widen and Deepen instead of being re-randomized, so it keeps its
+ * function. Layers added after a layer with signed outputs, or after the
+ * input layer, are twice as wide.
+ * @throws std::invalid_argument if growing would remove layers or neurons.
+ */
+void MLP::UpdateTopology(std::size_t hidden, std::size_t size, bool grow) {
+  if (grow) {
+    const std::size_t current = topology_.GetHiddenCount();
+    if (hidden < current) {
+      throw std::invalid_argument("Growing can't remove hidden layers");
+    }
+    // The network is grown on a copy and replaced once, so a failed step
+    // leaves the current one untouched
+    const auto [weights, biases] = mlp_->GetMlp();
+    Network network{weights, biases, topology_.GetActivations()};
+    std::mt19937 gen(std::random_device{}());
+    for (std::size_t layer = 1; layer <= current; ++layer) {
+      s21::Widen(network, layer, size, gen);
+    }
+    for (std::size_t layer = current; layer < hidden; ++layer) {
+      s21::Deepen(network, layer);
+    }
+    UpdateMlp(network.weights, network.biases, network.activations);
+    return;
+  }
+
   std::vector<std::size_t> layer_sizes;
   layer_sizes.push_back(topology_.GetInputSize());
 
@@ -262,7 +1035,115 @@ void MLP::UpdateTopology(std::size_t hidden, std::size_t size) {
   layer_sizes.push_back(topology_.GetOutputSize());
   topology_.SetTopology(layer_sizes);
   SetType(config_.GetModelType());
+  ResetMetrics();
+}
+
+/**
+ * Widens a hidden layer, keeping the function of the network so training
+ * continues from the current accuracy.
+ *
+ * @param layer Index of the hidden layer in the topology, from 1.
+ * @param size New size of the layer, at least the current one.
+ */
+void MLP::Widen(std::size_t layer, std::size_t size) {
+  const auto [weights, biases] = mlp_->GetMlp();
+  Network network{weights, biases, topology_.GetActivations()};
+  std::mt19937 gen(std::random_device{}());
+  s21::Widen(network, layer, size, gen);
+  UpdateMlp(network.weights, network.biases, network.activations);
+}
+
+/**
+ * Inserts a ReLU hidden layer that passes its inputs through, keeping the
+ * function of the network so training continues from the current accuracy.
+ *
+ * @param layer Index in the topology of the layer the new one follows.
+ */
+void MLP::Deepen(std::size_t layer) {
+  const auto [weights, biases] = mlp_->GetMlp();
+  Network network{weights, biases, topology_.GetActivations()};
+  s21::Deepen(network, layer);
+  UpdateMlp(network.weights, network.biases, network.activations);
+}
+
+/**
+ * Sets the activation of every layer, keeping the current weights.
+ *
+ * @param activations One activation per weight layer, the last one being the
+ * output layer. Ignored if the count doesn't match the topology.
+ */
+void MLP::SetActivations(const std::vector<Activation>& activations) {
+  const auto [weights, biases] = mlp_->GetMlp();
+  topology_.SetActivations(activations);
+  SetType(config_.GetModelType());
+  mlp_->SetMlp(weights, biases);
+  ResetMetrics();
+}
+
+/**
+ * Sets the same activation for every hidden layer, keeping the current
+ * weights and the output activation.
+ */
+void MLP::SetHiddenActivation(Activation activation) {
+  std::vector<Activation> activations = topology_.GetActivations();
+  std::fill(activations.begin(), activations.end() - 1, activation);
+  SetActivations(activations);
+}
+
+/**
+ * Sets the activation of the output layer, keeping the current weights.
+ * Softmax switches both training and reported loss to cross-entropy.
+ */
+void MLP::SetOutputActivation(Activation activation) {
+  std::vector<Activation> activations = topology_.GetActivations();
+  activations.back() = activation;
+  SetActivations(activations);
+}
+
+/**
+ * Prunes the weights by magnitude. On the matrix model the masks of the
+ * pruned weights are kept, so further training fine-tunes the remaining
+ * weights without regrowing the pruned ones, until the model is replaced.
+ *
+ * @param options The pruning settings.
+ * @return The masks of the kept weights of every layer.
+ */
+Tensor MLP::Prune(const PruneOptions& options) {
+  const auto [weights, biases] = mlp_->GetMlp();
+  Tensor pruned = weights;
+  Tensor masks = s21::Prune(pruned, options);
+  UpdateMlp(pruned, biases);
+  if (auto* matrix_mlp = dynamic_cast<MatrixMlp*>(mlp_.get())) {
+    matrix_mlp->SetMasks(masks);
+  }
+  return masks;
+}
+
+/**
+ * @return The current network in CSR form for sparse inference.
+ */
+SparseMlp MLP::GetSparseMlp() const {
+  const auto [weights, biases] = mlp_->GetMlp();
+  return SparseMlp{weights, biases, topology_.GetActivations()};
+}
+
+/**
+ * Factors the weight matrices into low-rank products, keeping the accuracy on
+ * the test dataset within the budget. Factored layers run their forward pass
+ * as two thin GEMMs until they are trained again.
+ *
+ * @param budget The allowed accuracy drop, as a fraction.
+ * @return The rank of every layer, 0 for layers kept dense.
+ * @throws std::runtime_error if the model is not the matrix one.
+ * @throws std::invalid_argument if the test dataset is empty.
+ */
+std::vector<std::size_t> MLP::CompressLowRank(double budget) {
+  return s21::CompressLowRank(GetMatrixMlp(), test_, budget);
+}
+
+void MLP::ResetMetrics() {
   metrics_ = Metrics{topology_.GetOutputSize()};
+  metrics_.SetCrossEntropy(topology_.IsCrossEntropy());
 }
 
 }  // namespace s21
@@ -1,11 +1,34 @@
 #ifndef MLP_MODEL_MLP_H_
 #define MLP_MODEL_MLP_H_
 
+#include <chrono>
+#include <cstdint>
+
+#include "allocation_counter.h"
+#include "async_validator.h"
+#include "checkpoint.h"
 #include "config.h"
+#include "cross_validator.h"
+#include "data_parallel.h"
+#include "event_channel.h"
+#include "evaluator.h"
 #include "graph_mlp.h"
+#include "hogwild.h"
+#include "importance_sampler.h"
+#include "inference_server.h"
 #include "io.h"
+#include "low_rank.h"
+#include "lr_schedule.h"
 #include "matrix_mlp.h"
 #include "metrics.h"
+#include "mixed_precision.h"
+#include "model_file.h"
+#include "net2net.h"
+#include "pipeline.h"
+#include "pruning.h"
+#include "replay_buffer.h"
+#include "sparse_mlp.h"
+#include "sweep.h"
 
 namespace s21 {
 
@@ -19,6 +42,8 @@ namespace s21 {
  */
 class MLP {
  public:
+  static constexpr std::size_t kRangeGroup = 32;
+
   explicit MLP(const Topology&);
 
   void Train();
@@ -28,8 +53,28 @@ class MLP {
   std::size_t PredictLabel(const Image&);
   void Save(const std::string&);
   void Load(const std::string&);
-  void UpdateMlp(const Tensor&, const Tensor&);
-  void UpdateTopology(std::size_t hidden, std::size_t size);
+  void Map(const std::string&);
+  void Resume(const std::string&);
+  void UpdateMlp(const Tensor&, const Tensor&,
+                 const std::vector<Activation>& = {});
+  void UpdateTopology(std::size_t hidden, std::size_t size, bool grow = false);
+  void Widen(std::size_t layer, std::size_t size);
+  void Deepen(std::size_t layer);
+  void SetActivations(const std::vector<Activation>&);
+  void SetHiddenActivation(Activation);
+  void SetOutputActivation(Activation);
+  Tensor Prune(const PruneOptions&);
+  SparseMlp GetSparseMlp() const;
+  std::vector<std::size_t> CompressLowRank(double budget);
+  LrRange FindLearningRate(const LrRangeOptions& = {});
+  double Learn(const Image&);
+  double Learn(const Dataset&);
+  const OnlineStats& GetOnlineStats() const { return online_stats_; }
+  std::size_t GetReplaySize() const { return replay_.GetSize(); }
+  void ResetOnline();
+  std::pair<const Tensor, const Tensor> GetMlp() const {
+    return mlp_->GetMlp();
+  }
 
   void SetTrainDataset(const std::string& path) { train_ = ParseEmnist(path); }
   void SetTrainDataset(const Dataset& dataset) { train_ = dataset; };
@@ -44,6 +89,7 @@ class MLP {
   std::size_t GetTestDatasetSize() { return test_.size(); }
   Topology& GetTopology() { return topology_; }
   Metrics& GetMetrics() { return metrics_; }
+  const FoldSummary& GetFoldSummary() const { return fold_summary_; }
 
   void SetVerbose(bool verbose) { config_.SetVerbose(verbose); }
   void SetTrainType(Config::TrainType type) { config_.SetTrainType(type); }
@@ -51,23 +97,85 @@ class MLP {
   void SetLearningRate(double rate) { config_.SetLearningRate(rate); }
   void SetTestSample(double sample) { config_.SetTestSample(sample); }
   void SetKFolds(std::size_t k_folds) { config_.SetKFolds(k_folds); }
+  void SetBatchSize(std::size_t size) { config_.SetBatchSize(size); }
+  void SetThreads(std::size_t threads) { config_.SetThreads(threads); }
+  void SetMicroBatches(std::size_t count) { config_.SetMicroBatches(count); }
+  void SetOptimizer(Config::OptimizerType);
+  void SetMomentum(double);
+  void SetPrecision(Config::Precision precision) {
+    config_.SetPrecision(precision);
+  }
+  void SetMemoryBudget(std::size_t bytes) { config_.SetMemoryBudget(bytes); }
+  void SetSchedule(Config::Schedule schedule) {
+    config_.SetSchedule(schedule);
+  }
+  void SetScheduleStep(std::size_t epochs) { config_.SetScheduleStep(epochs); }
+  void SetDecay(double decay) { config_.SetDecay(decay); }
+  void SetValidationSplit(double split) { config_.SetValidationSplit(split); }
+  void SetPatience(std::size_t epochs) { config_.SetPatience(epochs); }
+  void SetReplayCapacity(std::size_t size) {
+    config_.SetReplayCapacity(size);
+    replay_.SetCapacity(size);
+  }
+  void SetReplayRatio(double ratio) { config_.SetReplayRatio(ratio); }
+  void SetAsyncValidation(std::size_t epochs) {
+    config_.SetAsyncValidation(epochs);
+  }
+  void SetImportanceSampling(bool enable) {
+    config_.SetImportanceSampling(enable);
+  }
+  // Training runs write a checkpoint to the path every given samples or
+  // seconds, whichever comes first; an empty path turns checkpoints off
+  void SetCheckpoint(const std::string& path, std::size_t samples,
+                     double seconds = 0.0) {
+    checkpoint_path_ = path;
+    config_.SetCheckpointSamples(samples);
+    config_.SetCheckpointSeconds(seconds);
+  }
+  void SetSeed(unsigned seed) { config_.SetSeed(seed); }
 
   void SetMFunc(std::function<void(Metrics)> func) { ptr_metrics_ = func; }
   void SetPFunc(std::function<void(int)> func) { ptr_progress_ = func; }
   void SetFPFunc(std::function<void(double)> func) {
     ptr_full_progress_ = func;
   }
+  // While a channel is set, progress and metrics go to it instead of the
+  // callbacks. Train and Test must then run on a single thread at a time.
+  void SetEventChannel(std::shared_ptr<EventChannel> channel) {
+    events_ = std::move(channel);
+  }
 
  private:
-  Vector ExpectedOutput(const Image&);
-  void TrainEpoch(const Dataset&);
+  MatrixMlp& GetMatrixMlp();
+  DataParallel& GetOnlineTrainer();
+  void Densify();
+  void ResetMetrics();
+  void LoadLegacy(const std::string&);
+  void SetFactorizations(const std::vector<Factorization>&);
+  const Vector& ExpectedOutput(const Image&);
+  void TrainEpoch(const Dataset&, std::size_t begin = 0);
+  template <typename Trainer>
+  void TrainBatches(const Dataset&, Trainer&, std::size_t first);
+  void TrainHogwild(const Dataset&);
+  void TrainSampled(const Dataset&);
+  void TrainSampled(const Dataset&, DataParallel&);
   void TrainEpochs();
+  double Validate(const Dataset&);
+  void RestoreWeights(const Tensor&, const Tensor&);
+  void ReportValidation(AsyncValidator&, bool wait);
+  std::size_t SpareThreads() const;
+  void ReportProgress(std::size_t done, std::size_t total);
+  void ReportFullProgress(double);
+  void ReportMetrics(Metrics&);
+  void MaybeCheckpoint(std::size_t epoch, std::size_t done, double rate);
   void Test(const Dataset&);
   void CrossValidate();
 
   std::function<void(Metrics&)> ptr_metrics_;
   std::function<void(int)> ptr_progress_;
   std::function<void(double)> ptr_full_progress_;
+  std::shared_ptr<EventChannel> events_;
+  int last_progress_ = -1;
 
   Config config_;
   Topology topology_;
@@ -75,6 +183,24 @@ class MLP {
   Dataset train_;
   Dataset test_;
   Metrics metrics_;
+  FoldSummary fold_summary_;
+  ReplayBuffer replay_;
+  std::unique_ptr<ImportanceSampler> sampler_;
+  std::unique_ptr<MixedPrecision> mixed_precision_;
+  OnlineStats online_stats_;
+  // Trainer of Learn, reset whenever the network is replaced
+  std::unique_ptr<DataParallel> online_trainer_;
+  std::size_t online_threads_ = 0;
+  std::mt19937 online_gen_;
+  Vector expected_;
+
+  std::string checkpoint_path_;
+  std::unique_ptr<CheckpointWriter> checkpoints_;
+  std::unique_ptr<Checkpoint> resume_;
+  std::size_t epoch_ = 0;
+  std::size_t checkpoint_sample_ = 0;
+  std::chrono::steady_clock::time_point checkpoint_time_;
+  unsigned seed_ = 0;
 };
 
 }  // namespace s21
@@ -1,6 +1,7 @@
 #ifndef MLP_MODEL_UTILITY_ACTIVATION_FUNCTIONS_H_
 #define MLP_MODEL_UTILITY_ACTIVATION_FUNCTIONS_H_
 
+#include <algorithm>
 #include <cmath>
 #include <functional>
 
@@ -21,6 +22,73 @@ constexpr double tanh_derivative(double x) {
 }
 constexpr double relu_derivative(double x) { return (x > 0.0) ? 1.0 : 0.0; }
 
+/**
+ * @enum Activation
+ * @brief Activation functions that can be selected for a layer.
+ */
+enum class Activation { kSigmoid, kTanh, kRelu, kLeakyRelu, kSoftmax };
+
+// Activation functors. Derivatives take the activated value, which is what
+// the layers keep after the forward pass.
+struct Sigmoid {
+  static double Apply(double x) { return 1.0 / (1.0 + std::exp(-x)); }
+  static double Derivative(double y) { return y * (1.0 - y); }
+};
+
+struct Tanh {
+  static double Apply(double x) { return std::tanh(x); }
+  static double Derivative(double y) { return 1.0 - y * y; }
+};
+
+struct Relu {
+  static double Apply(double x) { return (x > 0.0) ? x : 0.0; }
+  static double Derivative(double y) { return (y > 0.0) ? 1.0 : 0.0; }
+};
+
+struct LeakyRelu {
+  static constexpr double kSlope = 0.01;
+  static double Apply(double x) { return (x > 0.0) ? x : kSlope * x; }
+  static double Derivative(double y) { return (y > 0.0) ? 1.0 : kSlope; }
+};
+
+// Softmax is only valid for the output layer. Its element-wise part is the
+// identity and the rows are normalized by Normalize. The derivative is 1, as
+// the output errors of softmax with cross-entropy are simply softmax - onehot.
+struct Softmax {
+  static double Apply(double x) { return x; }
+  static double Derivative(double) { return 1.0; }
+
+  template <typename Row>
+  static void Normalize(Row& row) {
+    double max = row[0];
+    for (double value : row) max = std::max(max, value);
+    double sum = 0.0;
+    for (auto& value : row) {
+      value = std::exp(value - max);
+      sum += value;
+    }
+    for (auto& value : row) value /= sum;
+  }
+};
+
+// Call a generic function with the functor of the given activation, so the
+// function body is instantiated and inlined once per activation.
+template <typename Func>
+auto DispatchActivation(Activation activation, Func&& func) {
+  switch (activation) {
+    case Activation::kTanh:
+      return func(Tanh{});
+    case Activation::kRelu:
+      return func(Relu{});
+    case Activation::kLeakyRelu:
+      return func(LeakyRelu{});
+    case Activation::kSoftmax:
+      return func(Softmax{});
+    default:
+      return func(Sigmoid{});
+  }
+}
+
 // Apply an activation function to a single value
 inline double ApplyActivation(double x, activation_func func) {
   return (*func)(x);
@@ -0,0 +1,47 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace s21 {
+
+namespace {
+
+std::atomic<bool> counting{false};
+std::atomic<std::size_t> allocations{0};
+
+}  // namespace
+
+void AllocationCounter::Enable(bool enabled) {
+  counting.store(enabled, std::memory_order_relaxed);
+}
+
+bool AllocationCounter::IsEnabled() {
+  return counting.load(std::memory_order_relaxed);
+}
+
+std::size_t AllocationCounter::GetCount() {
+  return allocations.load(std::memory_order_relaxed);
+}
+
+}  // namespace s21
+
+// The array and nothrow forms of the library call these two, so they are
+// counted as well; over-aligned allocations are not
+void *operator new(std::size_t size) {
+  if (s21::counting.load(std::memory_order_relaxed)) {
+    s21::allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (size == 0) size = 1;
+  while (true) {
+    if (void *ptr = std::malloc(size)) return ptr;
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) throw std::bad_alloc();
+    handler();
+  }
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
@@ -0,0 +1,27 @@
+#ifndef MLP_MODEL_UTILITY_ALLOCATION_COUNTER_H_
+#define MLP_MODEL_UTILITY_ALLOCATION_COUNTER_H_
+
+#include <cstddef>
+
+namespace s21 {
+
+/**
+ * @class AllocationCounter
+ * @brief Opt-in count of the heap allocations of the process.
+ *
+ * allocation_counter.cc replaces the global operator new with one that counts
+ * its calls while counting is enabled. Counting is disabled by default and
+ * then costs a relaxed atomic load per allocation. The count covers every
+ * thread, so it is meant to be read around code that runs alone, such as a
+ * training epoch.
+ */
+class AllocationCounter {
+ public:
+  static void Enable(bool);
+  static bool IsEnabled();
+  static std::size_t GetCount();
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_UTILITY_ALLOCATION_COUNTER_H_
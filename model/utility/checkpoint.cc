@@ -0,0 +1,300 @@
+#include "checkpoint.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace s21 {
+
+namespace {
+
+constexpr char kMagic[8] = {'M', 'L', 'P', 'C', 'K', 'P', 'T', '\0'};
+constexpr std::uint32_t kVersion = 2;
+
+class Writer {
+ public:
+  template <typename T>
+  void Put(T value) {
+    data_.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  void Put(const Tensor &tensor) {
+    Put<std::uint64_t>(tensor.size());
+    for (const Matrix &matrix : tensor) {
+      Put<std::uint64_t>(matrix.size());
+      Put<std::uint64_t>(matrix.empty() ? 0 : matrix[0].size());
+      for (const Vector &row : matrix) {
+        data_.append(reinterpret_cast<const char *>(row.data()),
+                     sizeof(double) * row.size());
+      }
+    }
+  }
+
+  std::string &GetData() { return data_; }
+
+ private:
+  std::string data_;
+};
+
+class Reader {
+ public:
+  Reader(const std::string &data, const std::string &path)
+      : data_{data}, path_{path} {}
+
+  template <typename T>
+  T Get() {
+    T value;
+    Take(&value, sizeof(value));
+    return value;
+  }
+
+  Tensor GetTensor() {
+    Tensor tensor(Count(2 * sizeof(std::uint64_t)));
+    for (Matrix &matrix : tensor) {
+      const auto rows = Get<std::uint64_t>();
+      const auto cols = Get<std::uint64_t>();
+      if (rows > data_.size() or
+          (cols and rows > (data_.size() - offset_) / sizeof(double) / cols)) {
+        Fail();
+      }
+      matrix.assign(rows, Vector(cols));
+      for (Vector &row : matrix) Take(row.data(), sizeof(double) * cols);
+    }
+    return tensor;
+  }
+
+  // Reads a count of items that take at least the given bytes each
+  std::size_t Count(std::size_t bytes) {
+    const auto count = Get<std::uint64_t>();
+    if (count > (data_.size() - offset_) / bytes) Fail();
+    return count;
+  }
+
+  bool AtEnd() const { return offset_ == data_.size(); }
+  [[noreturn]] void Fail() const {
+    throw std::runtime_error("Corrupted checkpoint: " + path_);
+  }
+
+ private:
+  void Take(void *out, std::size_t size) {
+    if (size > data_.size() - offset_) Fail();
+    std::memcpy(out, data_.data() + offset_, size);
+    offset_ += size;
+  }
+
+  const std::string &data_;
+  const std::string &path_;
+  std::size_t offset_ = 0;
+};
+
+void SyncDirectory(const std::string &path) {
+  const std::size_t slash = path.rfind('/');
+  const std::string dir =
+      slash == std::string::npos ? "." : path.substr(0, slash + 1);
+  const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) return;
+  ::fsync(fd);
+  ::close(fd);
+}
+
+}  // namespace
+
+/**
+ * Writes a file crash-safely: the data goes to a temporary file next to the
+ * target, which is synced to disk and then renamed over the target, and the
+ * directory is synced so the rename itself is durable. Readers that opened
+ * or mapped the old file keep reading it. The temporary file is removed if
+ * any step fails.
+ *
+ * @throws std::runtime_error if a write, the sync or the rename fails.
+ */
+void WriteFileAtomically(const std::string &path, const std::string &data) {
+  const std::string temp = path + ".tmp";
+  const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) throw std::runtime_error("Failed to open file: " + temp);
+  std::size_t done = 0;
+  while (done < data.size()) {
+    const ssize_t count = ::write(fd, data.data() + done, data.size() - done);
+    if (count < 0 and errno == EINTR) continue;
+    if (count <= 0) {
+      ::close(fd);
+      std::remove(temp.c_str());
+      throw std::runtime_error("Failed to write file: " + temp);
+    }
+    done += static_cast<std::size_t>(count);
+  }
+  const bool synced = ::fsync(fd) == 0;
+  if (::close(fd) != 0 or !synced) {
+    std::remove(temp.c_str());
+    throw std::runtime_error("Failed to write file: " + temp);
+  }
+  if (std::rename(temp.c_str(), path.c_str()) != 0) {
+    std::remove(temp.c_str());
+    throw std::runtime_error("Failed to rename file: " + temp);
+  }
+  SyncDirectory(path);
+}
+
+/**
+ * Writes a checkpoint crash-safely, see WriteFileAtomically.
+ *
+ * @throws std::runtime_error if the file can't be written.
+ */
+void WriteCheckpoint(const std::string &path, const Checkpoint &checkpoint) {
+  Writer writer;
+  for (char c : kMagic) writer.Put(c);
+  writer.Put(kVersion);
+  writer.Put<std::uint64_t>(checkpoint.optimizer_step);
+  writer.Put<std::uint64_t>(checkpoint.epoch);
+  writer.Put<std::uint64_t>(checkpoint.sample);
+  writer.Put<std::uint64_t>(checkpoint.seed);
+  writer.Put(checkpoint.learning_rate);
+  writer.Put(checkpoint.loss_scale);
+  writer.Put<std::uint64_t>(checkpoint.good_steps);
+  writer.Put<std::uint64_t>(checkpoint.activations.size());
+  for (Activation activation : checkpoint.activations) {
+    writer.Put(static_cast<std::int32_t>(activation));
+  }
+  writer.Put(checkpoint.weights);
+  writer.Put(checkpoint.biases);
+  for (const auto *slots : {&checkpoint.weight_slots, &checkpoint.bias_slots}) {
+    writer.Put<std::uint64_t>(slots->size());
+    for (const Tensor &slot : *slots) writer.Put(slot);
+  }
+  WriteFileAtomically(path, writer.GetData());
+}
+
+/**
+ * @throws std::runtime_error if the file can't be opened or isn't a complete
+ * checkpoint.
+ */
+Checkpoint ReadCheckpoint(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  const std::string data = buffer.str();
+
+  Reader reader{data, path};
+  for (char c : kMagic) {
+    if (reader.Get<char>() != c) reader.Fail();
+  }
+  if (reader.Get<std::uint32_t>() != kVersion) reader.Fail();
+  Checkpoint checkpoint;
+  checkpoint.optimizer_step = reader.Get<std::uint64_t>();
+  checkpoint.epoch = reader.Get<std::uint64_t>();
+  checkpoint.sample = reader.Get<std::uint64_t>();
+  checkpoint.seed = reader.Get<std::uint64_t>();
+  checkpoint.learning_rate = reader.Get<double>();
+  checkpoint.loss_scale = reader.Get<double>();
+  checkpoint.good_steps = reader.Get<std::uint64_t>();
+  checkpoint.activations.resize(reader.Count(sizeof(std::int32_t)));
+  for (Activation &activation : checkpoint.activations) {
+    activation = static_cast<Activation>(reader.Get<std::int32_t>());
+  }
+  checkpoint.weights = reader.GetTensor();
+  checkpoint.biases = reader.GetTensor();
+  for (auto *slots : {&checkpoint.weight_slots, &checkpoint.bias_slots}) {
+    slots->resize(reader.Count(sizeof(std::uint64_t)));
+    for (Tensor &slot : *slots) slot = reader.GetTensor();
+  }
+  if (!reader.AtEnd() or checkpoint.weights.empty() or
+      checkpoint.weights.size() != checkpoint.biases.size()) {
+    reader.Fail();
+  }
+  return checkpoint;
+}
+
+CheckpointWriter::CheckpointWriter(std::string path)
+    : path_{std::move(path)}, thread_{&CheckpointWriter::Run, this} {}
+
+/**
+ * Writes the checkpoint still waiting, if any, and stops the thread. Errors
+ * not collected by Wait are dropped.
+ */
+CheckpointWriter::~CheckpointWriter() {
+  {
+    std::lock_guard<std::mutex> lock{mtx_};
+    stop_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+void CheckpointWriter::Submit(Checkpoint checkpoint) {
+  auto next = std::make_unique<Checkpoint>(std::move(checkpoint));
+  {
+    std::lock_guard<std::mutex> lock{mtx_};
+    if (pending_) ++skipped_;
+    pending_.swap(next);
+  }
+  cv_.notify_all();
+}
+
+/**
+ * Waits until every submitted checkpoint is on disk.
+ *
+ * @throws std::runtime_error if a write failed since the last call.
+ */
+void CheckpointWriter::Wait() {
+  std::unique_lock<std::mutex> lock{mtx_};
+  cv_.wait(lock, [this] { return !pending_ and !writing_; });
+  if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+/**
+ * Reports a failed write without waiting for the checkpoint being written.
+ *
+ * @throws std::runtime_error if a write failed since the last call.
+ */
+void CheckpointWriter::Check() {
+  std::lock_guard<std::mutex> lock{mtx_};
+  if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+std::size_t CheckpointWriter::GetWritten() {
+  std::lock_guard<std::mutex> lock{mtx_};
+  return written_;
+}
+
+std::size_t CheckpointWriter::GetSkipped() {
+  std::lock_guard<std::mutex> lock{mtx_};
+  return skipped_;
+}
+
+void CheckpointWriter::Run() {
+  std::unique_lock<std::mutex> lock{mtx_};
+  while (true) {
+    cv_.wait(lock, [this] { return pending_ or stop_; });
+    if (!pending_) return;
+    std::unique_ptr<Checkpoint> checkpoint = std::move(pending_);
+    writing_ = true;
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+      WriteCheckpoint(path_, *checkpoint);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    checkpoint.reset();
+    lock.lock();
+    writing_ = false;
+    if (error) {
+      error_ = error;
+    } else {
+      ++written_;
+    }
+    cv_.notify_all();
+  }
+}
+
+}  // namespace s21
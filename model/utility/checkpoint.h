@@ -0,0 +1,86 @@
+#ifndef MLP_MODEL_UTILITY_CHECKPOINT_H_
+#define MLP_MODEL_UTILITY_CHECKPOINT_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "../abstract_mlp.h"
+#include "activation_functions.h"
+
+namespace s21 {
+
+/**
+ * @struct Checkpoint
+ * @brief Snapshot of a training run that it can be resumed from.
+ *
+ * The position is given by the finished epochs and the samples done in the
+ * current epoch. The order of the samples is not stored: it is replayed from
+ * the shuffle seed on the same train dataset.
+ */
+struct Checkpoint {
+  Tensor weights;
+  Tensor biases;
+  std::vector<Activation> activations;
+  // Optimizer state of the matrix model, empty for the graph model
+  std::vector<Tensor> weight_slots;
+  std::vector<Tensor> bias_slots;
+  std::uint64_t optimizer_step = 0;
+  std::uint64_t epoch = 0;
+  std::uint64_t sample = 0;
+  std::uint64_t seed = 0;
+  double learning_rate = 0.0;
+  // Loss scaling of a mixed-precision run, 0 for double precision
+  double loss_scale = 0.0;
+  std::uint64_t good_steps = 0;
+};
+
+void WriteFileAtomically(const std::string &path, const std::string &data);
+void WriteCheckpoint(const std::string &path, const Checkpoint &);
+Checkpoint ReadCheckpoint(const std::string &path);
+
+/**
+ * @class CheckpointWriter
+ * @brief Writes checkpoints to a file from a background thread.
+ *
+ * Submit only moves the snapshot under a lock, so the training thread never
+ * waits for the disk. A snapshot submitted while another one is still being
+ * written replaces any older one waiting behind it: only the latest matters.
+ * Every file is written by WriteCheckpoint, so a crash at any time leaves
+ * the previous checkpoint or the new one, never a partial file.
+ */
+class CheckpointWriter {
+ public:
+  explicit CheckpointWriter(std::string path);
+  CheckpointWriter(const CheckpointWriter &) = delete;
+  CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+  ~CheckpointWriter();
+
+  void Submit(Checkpoint);
+  void Wait();
+  void Check();
+  std::size_t GetWritten();
+  std::size_t GetSkipped();
+
+ private:
+  void Run();
+
+  std::string path_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::unique_ptr<Checkpoint> pending_;
+  bool writing_ = false;
+  bool stop_ = false;
+  std::size_t written_ = 0;
+  std::size_t skipped_ = 0;
+  std::exception_ptr error_;
+  std::thread thread_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_UTILITY_CHECKPOINT_H_
@@ -0,0 +1,62 @@
+#include "event_channel.h"
+
+namespace s21 {
+
+EventChannel::EventChannel(std::size_t capacity) : queue_{capacity} {}
+
+/**
+ * Publishes a progress event, or drops it if the ring is full.
+ */
+void EventChannel::PublishProgress(Event::Type type, double percent) {
+  Event event{type, percent, nullptr};
+  if (!queue_.TryPush(std::move(event))) ++dropped_;
+}
+
+/**
+ * Publishes a copy of the metrics. If the ring is full, or earlier metrics
+ * are still in the spill, the event goes to the spill for the consumer.
+ */
+void EventChannel::PublishMetrics(const Metrics &metrics) {
+  Event event{Event::Type::kMetrics, 0.0,
+              std::make_shared<const Metrics>(metrics)};
+  if (!spilled_.load(std::memory_order_acquire) and
+      queue_.TryPush(std::move(event))) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock{spill_mtx_};
+  spill_.push_back(std::move(event));
+  spilled_.store(true, std::memory_order_release);
+}
+
+/**
+ * Drains a channel into a log, one comma-separated line per event: the
+ * event type, then the percentage of a progress event or the loss,
+ * accuracy, precision, recall, F1 score and snapshot epoch of a metrics one.
+ *
+ * @return The number of written events.
+ */
+std::size_t ExportEvents(EventChannel &channel, std::ostream &log) {
+  return channel.Drain([&log](const Event &event) {
+    switch (event.type) {
+      case Event::Type::kProgress:
+        log << "progress," << event.value << '\n';
+        break;
+      case Event::Type::kFullProgress:
+        log << "full_progress," << event.value << '\n';
+        break;
+      case Event::Type::kTestProgress:
+        log << "test_progress," << event.value << '\n';
+        break;
+      case Event::Type::kMetrics: {
+        const Metrics &metrics = *event.metrics;
+        log << "metrics," << metrics.GetLoss() << ',' << metrics.GetAccuracy()
+            << ',' << metrics.GetPrecision() << ',' << metrics.GetRecall()
+            << ',' << metrics.GetF1Score() << ','
+            << metrics.GetSnapshotEpoch() << '\n';
+        break;
+      }
+    }
+  });
+}
+
+}  // namespace s21
@@ -0,0 +1,121 @@
+#ifndef MLP_MODEL_UTILITY_EVENT_CHANNEL_H_
+#define MLP_MODEL_UTILITY_EVENT_CHANNEL_H_
+
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "../metrics.h"
+#include "spsc_queue.h"
+
+namespace s21 {
+
+/**
+ * @struct Event
+ * @brief Progress or metrics reported by a training or test run.
+ *
+ * Progress events carry a percentage in value. Metrics events carry the
+ * metrics of an epoch, a fold or a test.
+ */
+struct Event {
+  enum class Type { kProgress, kFullProgress, kTestProgress, kMetrics };
+
+  Type type = Type::kProgress;
+  double value = 0.0;
+  std::shared_ptr<const Metrics> metrics;
+};
+
+/**
+ * @class EventChannel
+ * @brief Lock-free channel of events from one training thread to one
+ * consumer.
+ *
+ * The producer writes into an SpscQueue and never waits for the consumer.
+ * Progress events are dropped when the ring is full, since only the latest
+ * one matters. Metrics events are never dropped: when the ring is full they
+ * go to a mutex-guarded spill, which the consumer takes over on its next
+ * Drain. The spill is only touched while it holds events, so the lock stays
+ * off the common path. The consumer drains at its own rate, and repeated
+ * progress events of one type are coalesced into the latest.
+ */
+class EventChannel {
+ public:
+  static constexpr std::size_t kCapacity = 1024;
+
+  explicit EventChannel(std::size_t capacity = kCapacity);
+
+  // Producer side
+  void PublishProgress(Event::Type, double percent);
+  void PublishMetrics(const Metrics &);
+  std::size_t GetDropped() const { return dropped_; }
+
+  // Consumer side
+  template <typename Func>
+  std::size_t Drain(Func func);
+
+ private:
+  SpscQueue<Event> queue_;
+  std::size_t dropped_ = 0;
+
+  // Metrics events that didn't fit in the ring, guarded by spill_mtx_. While
+  // it holds any, new metrics events go to it too, so they keep their order
+  std::vector<Event> spill_;
+  std::atomic<bool> spilled_{false};
+  std::mutex spill_mtx_;
+
+  // Touched by the consumer only
+  std::vector<Event> drained_;
+};
+
+/**
+ * Passes every metrics event in order, then the latest event of every
+ * progress type.
+ *
+ * @param func Called with every coalesced event.
+ * @return The number of events passed to func.
+ */
+template <typename Func>
+std::size_t EventChannel::Drain(Func func) {
+  constexpr auto kTypes = static_cast<std::size_t>(Event::Type::kMetrics);
+  std::array<Event, kTypes> latest;
+  std::array<bool, kTypes> seen{};
+  std::size_t count = 0;
+  {
+    // The ring is emptied under the lock: no event can enter the spill
+    // meanwhile, so the spilled events are the newest ones
+    std::lock_guard<std::mutex> lock{spill_mtx_};
+    Event event;
+    while (queue_.TryPop(event)) drained_.push_back(std::move(event));
+    std::move(spill_.begin(), spill_.end(), std::back_inserter(drained_));
+    spill_.clear();
+    spilled_.store(false, std::memory_order_release);
+  }
+  for (Event &event : drained_) {
+    if (event.type == Event::Type::kMetrics) {
+      func(event);
+      ++count;
+    } else {
+      const auto idx = static_cast<std::size_t>(event.type);
+      latest[idx] = std::move(event);
+      seen[idx] = true;
+    }
+  }
+  drained_.clear();
+  for (std::size_t i = 0; i < kTypes; ++i) {
+    if (seen[i]) {
+      func(latest[i]);
+      ++count;
+    }
+  }
+  return count;
+}
+
+std::size_t ExportEvents(EventChannel &, std::ostream &);
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_UTILITY_EVENT_CHANNEL_H_
@@ -0,0 +1,56 @@
+#include "importance_sampler.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace s21 {
+
+ImportanceSampler::ImportanceSampler(std::size_t size, double uniform,
+                                     unsigned seed)
+    : losses_(size, 1.0),
+      probabilities_(size, size ? 1.0 / size : 0.0),
+      uniform_{std::clamp(uniform, 0.0, 1.0)},
+      gen_{seed} {}
+
+/**
+ * Draws samples with replacement from the current loss estimates. The
+ * probabilities are fixed until the next call, so GetWeight matches the draw.
+ *
+ * @param count Number of samples to draw.
+ * @return The drawn indices.
+ */
+std::vector<std::size_t> ImportanceSampler::Draw(std::size_t count) {
+  const std::size_t size = losses_.size();
+  std::vector<std::size_t> indices;
+  if (!size) return indices;
+
+  const double total = std::accumulate(losses_.begin(), losses_.end(), 0.0);
+  Vector cumulative(size);
+  double sum = 0.0;
+  for (std::size_t i = 0; i < size; ++i) {
+    probabilities_[i] = total > 0.0
+                            ? (1.0 - uniform_) * losses_[i] / total +
+                                  uniform_ / size
+                            : 1.0 / size;
+    sum += probabilities_[i];
+    cumulative[i] = sum;
+  }
+
+  std::uniform_real_distribution<double> position(0.0, sum);
+  indices.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    auto it = std::upper_bound(cumulative.begin(), cumulative.end(),
+                               position(gen_));
+    indices.push_back(std::min<std::size_t>(it - cumulative.begin(), size - 1));
+  }
+  return indices;
+}
+
+/**
+ * @return The bias correction of a sample drawn by the last Draw.
+ */
+double ImportanceSampler::GetWeight(std::size_t idx) const {
+  return 1.0 / (losses_.size() * probabilities_[idx]);
+}
+
+}  // namespace s21
@@ -0,0 +1,42 @@
+#ifndef MLP_MODEL_UTILITY_IMPORTANCE_SAMPLER_H_
+#define MLP_MODEL_UTILITY_IMPORTANCE_SAMPLER_H_
+
+#include <random>
+#include <vector>
+
+#include "../abstract_mlp.h"
+
+namespace s21 {
+
+/**
+ * @class ImportanceSampler
+ * @brief Draws training samples in proportion to their last known loss.
+ *
+ * Every sample is drawn with probability
+ * p = (1 - uniform) * loss / total_loss + uniform / size, so hard samples are
+ * revisited more often while every sample keeps a floor of uniform / size.
+ * GetWeight returns 1 / (size * p), the factor that keeps the expected
+ * gradient of an epoch equal to the one of uniform sampling; the floor bounds
+ * it by 1 / uniform. Samples start with equal loss estimates.
+ */
+class ImportanceSampler {
+ public:
+  explicit ImportanceSampler(std::size_t size, double uniform = 0.1,
+                             unsigned seed = std::random_device{}());
+
+  std::vector<std::size_t> Draw(std::size_t count);
+  double GetWeight(std::size_t idx) const;
+  void Update(std::size_t idx, double loss) { losses_[idx] = loss; }
+  double GetLoss(std::size_t idx) const { return losses_[idx]; }
+  std::size_t GetSize() const { return losses_.size(); }
+
+ private:
+  Vector losses_;
+  Vector probabilities_;
+  double uniform_;
+  std::mt19937 gen_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_UTILITY_IMPORTANCE_SAMPLER_H_
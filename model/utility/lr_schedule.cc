@@ -0,0 +1,118 @@
+#include "lr_schedule.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace s21 {
+
+LrSchedule::LrSchedule(const Config &config)
+    : type_{config.GetSchedule()},
+      base_rate_{config.GetLearningRate()},
+      rate_{config.GetLearningRate()},
+      epochs_{config.GetEpochs()},
+      step_{config.GetScheduleStep()},
+      decay_{config.GetDecay()} {}
+
+/**
+ * Moves to the next epoch.
+ *
+ * @param loss The loss of the finished epoch, used by the plateau schedule.
+ */
+void LrSchedule::Step(double loss) {
+  ++epoch_;
+  switch (type_) {
+    case Config::Schedule::kConstant:
+      break;
+    case Config::Schedule::kStep:
+      rate_ = base_rate_ *
+              std::pow(decay_, static_cast<double>(epoch_ / step_));
+      break;
+    case Config::Schedule::kCosine:
+      rate_ = 0.5 * base_rate_ *
+              (1.0 + std::cos(M_PI * std::min(epoch_, epochs_) / epochs_));
+      break;
+    case Config::Schedule::kPlateau:
+      if (loss < best_loss_) {
+        best_loss_ = loss;
+        bad_epochs_ = 0;
+      } else if (++bad_epochs_ >= step_) {
+        rate_ *= decay_;
+        bad_epochs_ = 0;
+      }
+      break;
+  }
+}
+
+/**
+ * Moves to a later epoch of a resumed run. The plateau schedule starts
+ * tracking the loss anew from there.
+ *
+ * @param epoch The finished epochs.
+ * @param rate The rate of the next epoch.
+ */
+void LrSchedule::Restore(std::size_t epoch, double rate) {
+  epoch_ = epoch;
+  rate_ = rate;
+}
+
+/**
+ * Records the loss of a step and its exponential moving average, corrected
+ * for the bias towards zero of the first steps.
+ *
+ * @throws std::invalid_argument if the smoothing is not in [0, 1).
+ */
+void LrRange::Add(double rate, double loss, double smoothing) {
+  if (!(smoothing >= 0.0 and smoothing < 1.0)) {
+    throw std::invalid_argument("Smoothing must be in [0, 1)");
+  }
+  const auto correction = [smoothing](std::size_t steps) {
+    return 1.0 - std::pow(smoothing, static_cast<double>(steps));
+  };
+  const std::size_t steps = losses.size();
+  const double previous =
+      steps ? smoothed.back() * correction(steps) : 0.0;
+  const double average = smoothing * previous + (1.0 - smoothing) * loss;
+  rates.push_back(rate);
+  losses.push_back(loss);
+  smoothed.push_back(average / correction(steps + 1));
+}
+
+/**
+ * Picks the rate where the smoothed loss falls the fastest, before it reaches
+ * its minimum, and stores it in recommended.
+ *
+ * @return The recommended rate, 0 if the curve has fewer than two points.
+ */
+double LrRange::Recommend() {
+  if (smoothed.size() < 2) return recommended = 0.0;
+  const std::size_t lowest =
+      std::min_element(smoothed.begin(), smoothed.end()) - smoothed.begin();
+  double steepest = 0.0;
+  recommended = rates[lowest] / 10.0;
+  for (std::size_t i = 1; i <= lowest; ++i) {
+    const double slope = (smoothed[i] - smoothed[i - 1]) /
+                         std::log(rates[i] / rates[i - 1]);
+    if (slope < steepest) {
+      steepest = slope;
+      recommended = rates[i];
+    }
+  }
+  return recommended;
+}
+
+/**
+ * @return The curve as CSV with a header line: rate, loss, smoothed loss.
+ */
+std::string LrRange::ToCsv() const {
+  std::ostringstream csv;
+  csv.precision(10);
+  csv << "rate,loss,smoothed_loss\n";
+  for (std::size_t i = 0; i < rates.size(); ++i) {
+    csv << rates[i] << ',' << losses[i] << ',' << smoothed[i] << '\n';
+  }
+  return csv.str();
+}
+
+}  // namespace s21
@@ -0,0 +1,75 @@
+#ifndef MLP_MODEL_UTILITY_LR_SCHEDULE_H_
+#define MLP_MODEL_UTILITY_LR_SCHEDULE_H_
+
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../config.h"
+
+namespace s21 {
+
+/**
+ * @class LrSchedule
+ * @brief Learning rate of every epoch of a training run.
+ *
+ * The step schedule multiplies the rate by the decay every GetScheduleStep()
+ * epochs, the cosine one anneals it to zero over the configured epochs, and
+ * the plateau one multiplies it by the decay once the loss hasn't improved
+ * for GetScheduleStep() epochs. Step() must be called after every epoch.
+ */
+class LrSchedule {
+ public:
+  explicit LrSchedule(const Config &config);
+
+  double GetRate() const { return rate_; }
+  void Step(double loss);
+  void Restore(std::size_t epoch, double rate);
+
+ private:
+  Config::Schedule type_;
+  double base_rate_;
+  double rate_;
+  std::size_t epochs_;
+  std::size_t step_;
+  double decay_;
+  std::size_t epoch_ = 0;
+  double best_loss_ = std::numeric_limits<double>::infinity();
+  std::size_t bad_epochs_ = 0;
+};
+
+/**
+ * @struct LrRangeOptions
+ * @brief Settings of the learning rate range test.
+ *
+ * The rate grows exponentially from min_rate to max_rate over steps training
+ * steps. The test stops early once the smoothed loss exceeds divergence times
+ * its lowest value.
+ */
+struct LrRangeOptions {
+  double min_rate = 1e-5;
+  double max_rate = 10.0;
+  std::size_t steps = 200;
+  double smoothing = 0.98;
+  double divergence = 4.0;
+};
+
+/**
+ * @struct LrRange
+ * @brief Loss curve of a learning rate range test.
+ */
+struct LrRange {
+  std::vector<double> rates;
+  std::vector<double> losses;
+  std::vector<double> smoothed;
+  double recommended = 0.0;
+
+  void Add(double rate, double loss, double smoothing);
+  double Recommend();
+  std::string ToCsv() const;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_UTILITY_LR_SCHEDULE_H_
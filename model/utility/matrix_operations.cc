@@ -55,6 +55,48 @@ Matrix Subtraction(const Matrix& m1, const Matrix& m2) {
   return BinaryOp(m1, m2, sub);
 }
 
+/**
+ * Adds a single-row matrix to every row of another matrix.
+ *
+ * @param matrix The input matrix.
+ * @param row The matrix of one row to be added to each row of the input.
+ * @return A new matrix after performing the broadcast addition.
+ * @throws std::logic_error if the matrices have inconsistent dimensions.
+ */
+Matrix BroadcastAddition(const Matrix& matrix, const Matrix& row) {
+  if (matrix.empty() or row.size() != 1 or
+      matrix[0].size() != row[0].size()) {
+    throw std::logic_error("Matrices have inconsistent dimensions");
+  }
+  Matrix result_matrix(matrix.size(), Vector(row[0].size()));
+  for (std::size_t i = 0; i < matrix.size(); ++i) {
+    std::transform(matrix[i].begin(), matrix[i].end(), row[0].begin(),
+                   result_matrix[i].begin(), std::plus<double>());
+  }
+
+  return result_matrix;
+}
+
+/**
+ * Sums all rows of a matrix into a single row.
+ *
+ * @param matrix The input matrix.
+ * @return A new matrix of one row holding the column-wise sums.
+ * @throws std::logic_error if the matrix is empty.
+ */
+Matrix SumRows(const Matrix& matrix) {
+  if (matrix.empty() or matrix[0].empty()) {
+    throw std::logic_error("Matrix have inconsistent dimensions");
+  }
+  Matrix result_matrix(1, Vector(matrix[0].size(), 0.0));
+  for (const Vector& row : matrix) {
+    std::transform(row.begin(), row.end(), result_matrix[0].begin(),
+                   result_matrix[0].begin(), std::plus<double>());
+  }
+
+  return result_matrix;
+}
+
 /**
  * Multiplies two matrices element-wise using the Hadamard product.
  *
@@ -241,6 +283,21 @@ void RandomizeMatrix(Matrix& matrix) {
   }
 }
 
+/**
+ * Randomizes the elements of a matrix with the given generator, in the same
+ * range as RandomWeight. Unlike RandomizeMatrix, it is safe to call from
+ * many threads with a generator each.
+ *
+ * @param matrix The matrix to be randomized.
+ * @param gen The random number generator.
+ */
+void RandomizeMatrix(Matrix& matrix, std::mt19937_64& gen) {
+  std::uniform_real_distribution<double> dist(-0.5, 0.5);
+  for (Vector& vector : matrix) {
+    for (double& value : vector) value = dist(gen);
+  }
+}
+
 /**
  * Randomizes the elements of a vector by generating a new random value in the
  * range [-1.0, 1.0] for each element. The input vector is modified in place.
@@ -410,6 +467,24 @@ Matrix operator*(const Matrix& matrix, const double d) {
  */
 void operator-=(Matrix& m1, const Matrix& m2) { m1 = m1 - m2; }
 
+/**
+ * Performs an in-place addition of the second matrix to the first one.
+ *
+ * @param m1 The matrix to be accumulated into.
+ * @param m2 The matrix to be added.
+ * @throws std::logic_error if the matrices have inconsistent dimensions.
+ */
+void operator+=(Matrix& m1, const Matrix& m2) {
+  if (m1.empty() or m2.empty() or m1.size() != m2.size() or
+      m1[0].size() != m2[0].size()) {
+    throw std::logic_error("Matrices have inconsistent dimensions");
+  }
+  for (std::size_t i = 0; i < m1.size(); ++i) {
+    std::transform(m1[i].begin(), m1[i].end(), m2[i].begin(), m1[i].begin(),
+                   std::plus<double>());
+  }
+}
+
 /**
  * Prints all elements of a given vector to the standard output stream.
  *
@@ -23,6 +23,8 @@ template <typename Op>
 Matrix BinaryOp(const Matrix &, const Matrix &, Op);
 Matrix Addition(const Matrix &, const Matrix &);
 Matrix Subtraction(const Matrix &, const Matrix &);
+Matrix BroadcastAddition(const Matrix &, const Matrix &);
+Matrix SumRows(const Matrix &);
 Matrix Multiplication(const Matrix &, const Matrix &);
 Matrix MultiplyHadamard(const Matrix &, const Matrix &);
 Matrix MultiplyNumber(const Matrix &, const double);
@@ -32,6 +34,7 @@ Matrix ActivateDerivative(const Matrix &, activation_derivative);
 Matrix Multiply(const Matrix &, const Matrix &);
 Matrix MultiplyWinograd(const Matrix &, const Matrix &);
 void RandomizeMatrix(Matrix &);
+void RandomizeMatrix(Matrix &, std::mt19937_64 &);
 void RandomizeVector(Vector &);
 double RandomWeight();
 
@@ -40,6 +43,7 @@ Matrix operator-(const Matrix &, const Matrix &);
 Matrix operator*(const Matrix &, const Matrix &);
 Matrix operator*(const Matrix &, const double);
 void operator-=(Matrix &, const Matrix &);
+void operator+=(Matrix &, const Matrix &);
 
 void ComputeRowFactors(const Matrix &, Vector &);
 void ComputeColFactors(const Matrix &, Vector &);
@@ -49,6 +53,51 @@ void ComputeResultMatrix(const Matrix &, const Matrix &, const Vector &,
 void PrintVector(const Vector &);
 void PrintMatrix(const Matrix &);
 
+/**
+ * Apply an activation functor element-wise to a matrix in place.
+ *
+ * @tparam F The activation functor.
+ * @param matrix The matrix to be activated.
+ */
+template <typename F>
+void ActivateInPlace(Matrix &matrix) {
+  for (Vector &row : matrix) {
+    for (double &value : row) value = F::Apply(value);
+  }
+}
+
+/**
+ * Apply softmax to every row of a matrix in place.
+ */
+template <>
+inline void ActivateInPlace<Softmax>(Matrix &matrix) {
+  for (Vector &row : matrix) Softmax::Normalize(row);
+}
+
+/**
+ * Multiply errors element-wise by the derivative of an activation functor
+ * taken at the activated values, in place.
+ *
+ * @tparam F The activation functor.
+ * @param errors The matrix of errors to be multiplied.
+ * @param values The activated values of the same size.
+ * @throws std::logic_error if the matrices have inconsistent dimensions.
+ */
+template <typename F>
+void MultiplyDerivative(Matrix &errors, const Matrix &values) {
+  if (errors.size() != values.size() or
+      (!errors.empty() and errors[0].size() != values[0].size())) {
+    throw std::logic_error("Matrices have inconsistent dimensions");
+  }
+  for (std::size_t i = 0; i < errors.size(); ++i) {
+    Vector &row = errors[i];
+    const Vector &value = values[i];
+    for (std::size_t j = 0; j < row.size(); ++j) {
+      row[j] *= F::Derivative(value[j]);
+    }
+  }
+}
+
 }  // namespace s21
 
 #endif  // MLP_MODEL_UTILITY_MATRIX_OPERATIONS_H_
@@ -0,0 +1,120 @@
+#include "net2net.h"
+
+#include <stdexcept>
+
+namespace s21 {
+
+namespace {
+
+bool IsNonNegative(Activation activation) {
+  return activation == Activation::kSigmoid or
+         activation == Activation::kRelu or activation == Activation::kSoftmax;
+}
+
+}  // namespace
+
+/**
+ * Widens a hidden layer without changing the function of the network.
+ *
+ * Every new neuron copies the incoming weights and bias of a random existing
+ * one, so both compute the same value. The outgoing weights of that value are
+ * then split between the copies in random proportions summing to one, which
+ * keeps the next layer's inputs unchanged while letting the copies diverge in
+ * training.
+ *
+ * @param network The network, widened in place.
+ * @param layer Index of the hidden layer in the topology, from 1.
+ * @param size New size of the layer.
+ * @param gen Source of the copied neurons and of the splits.
+ * @throws std::invalid_argument if the layer is not a hidden one or the size
+ * is smaller than the current one.
+ */
+void Widen(Network &network, std::size_t layer, std::size_t size,
+           std::mt19937 &gen) {
+  if (layer == 0 or layer >= network.weights.size()) {
+    throw std::invalid_argument("Only hidden layers can be widened");
+  }
+  Matrix &incoming = network.weights[layer - 1];
+  Vector &biases = network.biases[layer - 1][0];
+  Matrix &outgoing = network.weights[layer];
+  const std::size_t old_size = biases.size();
+  if (size < old_size) {
+    throw std::invalid_argument("Widening can't shrink a layer");
+  }
+
+  std::vector<std::size_t> source(size);
+  std::uniform_int_distribution<std::size_t> pick(0, old_size - 1);
+  for (std::size_t j = 0; j < size; ++j) {
+    source[j] = j < old_size ? j : pick(gen);
+  }
+
+  // Random share of every neuron in the outgoing weights of its original
+  std::uniform_real_distribution<double> share_dist(0.5, 1.5);
+  Vector share(size), total(old_size, 0.0);
+  for (std::size_t j = 0; j < size; ++j) {
+    share[j] = share_dist(gen);
+    total[source[j]] += share[j];
+  }
+
+  for (Vector &row : incoming) {
+    row.resize(size);
+    for (std::size_t j = old_size; j < size; ++j) row[j] = row[source[j]];
+  }
+  biases.resize(size);
+  for (std::size_t j = old_size; j < size; ++j) biases[j] = biases[source[j]];
+
+  outgoing.resize(size);
+  for (std::size_t j = size; j-- > 0;) {
+    outgoing[j] = outgoing[source[j]];
+  }
+  for (std::size_t j = 0; j < size; ++j) {
+    const double scale = share[j] / total[source[j]];
+    for (double &weight : outgoing[j]) weight *= scale;
+  }
+}
+
+/**
+ * Inserts a new ReLU hidden layer that passes its inputs through, so the
+ * function of the network doesn't change.
+ *
+ * After a layer with non-negative outputs the new layer has the same size
+ * and identity weights. Otherwise it is twice as wide and computes
+ * relu(x) and relu(-x), whose difference the next layer takes.
+ *
+ * @param network The network, deepened in place.
+ * @param layer Index in the topology of the layer the new one follows, from
+ * 0 for the input layer up to the last hidden layer.
+ * @throws std::invalid_argument if the index is past the last hidden layer.
+ */
+void Deepen(Network &network, std::size_t layer) {
+  if (layer >= network.weights.size()) {
+    throw std::invalid_argument("Can't add a layer after the output layer");
+  }
+  const std::size_t size = network.weights[layer].size();
+  const bool signed_input =
+      layer == 0 or !IsNonNegative(network.activations[layer - 1]);
+  const std::size_t new_size = signed_input ? 2 * size : size;
+
+  Matrix identity(size, Vector(new_size, 0.0));
+  for (std::size_t i = 0; i < size; ++i) {
+    identity[i][i] = 1.0;
+    if (signed_input) identity[i][size + i] = -1.0;
+  }
+
+  Matrix &next = network.weights[layer];
+  if (signed_input) {
+    for (std::size_t i = 0; i < size; ++i) {
+      Vector negated = next[i];
+      for (double &weight : negated) weight = -weight;
+      next.push_back(std::move(negated));
+    }
+  }
+
+  network.weights.insert(network.weights.begin() + layer, std::move(identity));
+  network.biases.insert(network.biases.begin() + layer,
+                        Matrix(1, Vector(new_size, 0.0)));
+  network.activations.insert(network.activations.begin() + layer,
+                             Activation::kRelu);
+}
+
+}  // namespace s21
@@ -0,0 +1,27 @@
+#ifndef MLP_MODEL_UTILITY_NET2NET_H_
+#define MLP_MODEL_UTILITY_NET2NET_H_
+
+#include <random>
+
+#include "../abstract_mlp.h"
+#include "activation_functions.h"
+
+namespace s21 {
+
+/**
+ * @struct Network
+ * @brief Weights, biases and activations of a perceptron, one per weight
+ * layer, in the layout of AbstractMlp::GetMlp.
+ */
+struct Network {
+  Tensor weights;
+  Tensor biases;
+  std::vector<Activation> activations;
+};
+
+void Widen(Network &, std::size_t layer, std::size_t size, std::mt19937 &);
+void Deepen(Network &, std::size_t layer);
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_UTILITY_NET2NET_H_
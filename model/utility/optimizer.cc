@@ -0,0 +1,71 @@
+#include "optimizer.h"
+
+namespace s21 {
+
+void Sgd::Update(double *params, const double *grads, double *, double *,
+                 std::size_t size, double lr) const {
+  for (std::size_t i = 0; i < size; ++i) {
+    params[i] -= lr * grads[i];
+  }
+}
+
+void Momentum::Update(double *params, const double *grads, double *velocity,
+                      double *, std::size_t size, double lr) const {
+  const double mu = momentum_;
+  if (nesterov_) {
+    for (std::size_t i = 0; i < size; ++i) {
+      velocity[i] = mu * velocity[i] + grads[i];
+      params[i] -= lr * (grads[i] + mu * velocity[i]);
+    }
+  } else {
+    for (std::size_t i = 0; i < size; ++i) {
+      velocity[i] = mu * velocity[i] + grads[i];
+      params[i] -= lr * velocity[i];
+    }
+  }
+}
+
+void Adam::NextStep() { SetStep(step_ + 1); }
+
+void Adam::SetStep(std::size_t step) {
+  Optimizer::SetStep(step);
+  if (step == 0) {
+    correction1_ = correction2_ = 1.0;
+    return;
+  }
+  correction1_ = 1.0 / (1.0 - std::pow(beta1_, static_cast<double>(step_)));
+  correction2_ = 1.0 / (1.0 - std::pow(beta2_, static_cast<double>(step_)));
+}
+
+void Adam::Update(double *params, const double *grads, double *first,
+                  double *second, std::size_t size, double lr) const {
+  const double b1 = beta1_, b2 = beta2_, eps = eps_;
+  const double step = lr * correction1_, c2 = correction2_;
+  for (std::size_t i = 0; i < size; ++i) {
+    const double g = grads[i];
+    first[i] = b1 * first[i] + (1.0 - b1) * g;
+    second[i] = b2 * second[i] + (1.0 - b2) * g * g;
+    params[i] -= step * first[i] / (std::sqrt(second[i] * c2) + eps);
+  }
+}
+
+/**
+ * Creates the optimizer selected in the configuration.
+ *
+ * @param config The configuration holding the optimizer type and momentum.
+ * @return A new optimizer with fresh state.
+ */
+std::shared_ptr<Optimizer> MakeOptimizer(const Config &config) {
+  switch (config.GetOptimizer()) {
+    case Config::OptimizerType::kMomentum:
+      return std::make_shared<Momentum>(config.GetMomentum());
+    case Config::OptimizerType::kNesterov:
+      return std::make_shared<Momentum>(config.GetMomentum(), true);
+    case Config::OptimizerType::kAdam:
+      return std::make_shared<Adam>();
+    default:
+      return std::make_shared<Sgd>();
+  }
+}
+
+}  // namespace s21
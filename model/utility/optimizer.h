@@ -0,0 +1,96 @@
+#ifndef MLP_MODEL_UTILITY_OPTIMIZER_H_
+#define MLP_MODEL_UTILITY_OPTIMIZER_H_
+
+#include <cmath>
+#include <cstddef>
+#include <memory>
+
+#include "config.h"
+
+namespace s21 {
+
+/**
+ * @class Optimizer
+ * @brief Interface of the weight update rules.
+ *
+ * An optimizer updates a contiguous block of parameters from their gradients
+ * in a single fused pass that also advances its per-parameter state. The state
+ * is owned by the model and passed in as up to two arrays of the block's size.
+ * NextStep() must be called once before the updates of every training step.
+ */
+class Optimizer {
+ public:
+  virtual ~Optimizer() = default;
+
+  virtual std::size_t GetSlotsCount() const = 0;
+  virtual void NextStep() { ++step_; }
+  // Steps made so far, restored from checkpoints
+  std::size_t GetStep() const { return step_; }
+  virtual void SetStep(std::size_t step) { step_ = step; }
+  virtual void Update(double *params, const double *grads, double *first,
+                      double *second, std::size_t size, double lr) const = 0;
+
+ protected:
+  std::size_t step_ = 0;
+};
+
+/**
+ * @class Sgd
+ * @brief Plain stochastic gradient descent, keeps no state.
+ */
+class Sgd final : public Optimizer {
+ public:
+  std::size_t GetSlotsCount() const override { return 0; }
+  void Update(double *params, const double *grads, double *, double *,
+              std::size_t size, double lr) const override;
+};
+
+/**
+ * @class Momentum
+ * @brief SGD with classical or Nesterov momentum, keeps one velocity value
+ * per parameter.
+ */
+class Momentum final : public Optimizer {
+ public:
+  explicit Momentum(double momentum, bool nesterov = false)
+      : momentum_{momentum}, nesterov_{nesterov} {}
+
+  std::size_t GetSlotsCount() const override { return 1; }
+  void Update(double *params, const double *grads, double *velocity, double *,
+              std::size_t size, double lr) const override;
+
+ private:
+  double momentum_;
+  bool nesterov_;
+};
+
+/**
+ * @class Adam
+ * @brief Adaptive moment estimation, keeps the first and the second moments
+ * of the gradient per parameter.
+ */
+class Adam final : public Optimizer {
+ public:
+  explicit Adam(double beta1 = 0.9, double beta2 = 0.999, double eps = 1e-8)
+      : beta1_{beta1},
+        beta2_{beta2},
+        eps_{eps},
+        correction1_{1.0},
+        correction2_{1.0} {}
+
+  std::size_t GetSlotsCount() const override { return 2; }
+  void NextStep() override;
+  void SetStep(std::size_t step) override;
+  void Update(double *params, const double *grads, double *first,
+              double *second, std::size_t size, double lr) const override;
+
+ private:
+  double beta1_, beta2_, eps_;
+  double correction1_, correction2_;
+};
+
+std::shared_ptr<Optimizer> MakeOptimizer(const Config &);
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_UTILITY_OPTIMIZER_H_
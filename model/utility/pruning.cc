@@ -0,0 +1,147 @@
+#include "pruning.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace s21 {
+
+namespace {
+
+// Calls zero with the index of each of the count items with the smallest
+// scores.
+template <typename Zero>
+void ZeroSmallest(const Vector &scores, std::size_t count, Zero zero) {
+  std::vector<std::size_t> order(scores.size());
+  std::iota(order.begin(), order.end(), 0);
+  count = std::min(count, order.size());
+  std::nth_element(order.begin(), order.begin() + count, order.end(),
+                   [&scores](std::size_t a, std::size_t b) {
+                     return scores[a] < scores[b];
+                   });
+  for (std::size_t i = 0; i < count; ++i) zero(order[i]);
+}
+
+void PruneUnstructured(Matrix &weights, Matrix &mask, double sparsity) {
+  const std::size_t cols = weights[0].size();
+  Vector scores;
+  scores.reserve(weights.size() * cols);
+  for (const Vector &row : weights) {
+    for (double weight : row) scores.push_back(std::fabs(weight));
+  }
+
+  auto count = static_cast<std::size_t>(sparsity * scores.size() + 0.5);
+  ZeroSmallest(scores, count, [&](std::size_t idx) {
+    weights[idx / cols][idx % cols] = 0.0;
+    mask[idx / cols][idx % cols] = 0.0;
+  });
+}
+
+void PruneNM(Matrix &weights, Matrix &mask, std::size_t n, std::size_t m) {
+  Vector scores(m);
+  for (std::size_t j = 0; j < weights[0].size(); ++j) {
+    for (std::size_t first = 0; first < weights.size(); first += m) {
+      const std::size_t size = std::min(m, weights.size() - first);
+      if (size <= n) continue;
+      scores.resize(size);
+      for (std::size_t k = 0; k < size; ++k) {
+        scores[k] = std::fabs(weights[first + k][j]);
+      }
+      ZeroSmallest(scores, size - n, [&](std::size_t k) {
+        weights[first + k][j] = 0.0;
+        mask[first + k][j] = 0.0;
+      });
+    }
+  }
+}
+
+void PruneBlocks(Matrix &weights, Matrix &mask, double sparsity,
+                 std::size_t block) {
+  const std::size_t block_rows = (weights.size() + block - 1) / block;
+  const std::size_t block_cols = (weights[0].size() + block - 1) / block;
+  Vector scores(block_rows * block_cols, 0.0);
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    for (std::size_t j = 0; j < weights[i].size(); ++j) {
+      const double weight = weights[i][j];
+      scores[i / block * block_cols + j / block] += weight * weight;
+    }
+  }
+
+  auto count = static_cast<std::size_t>(sparsity * scores.size() + 0.5);
+  ZeroSmallest(scores, count, [&](std::size_t idx) {
+    const std::size_t row = idx / block_cols * block;
+    const std::size_t col = idx % block_cols * block;
+    for (std::size_t i = row; i < std::min(row + block, weights.size()); ++i) {
+      for (std::size_t j = col; j < std::min(col + block, weights[i].size());
+           ++j) {
+        weights[i][j] = 0.0;
+        mask[i][j] = 0.0;
+      }
+    }
+  });
+}
+
+}  // namespace
+
+/**
+ * Prunes the weights of a single layer by magnitude.
+ *
+ * @param weights The weight matrix, pruned in place.
+ * @param options The pruning settings.
+ * @return The mask of the kept weights: 1 for kept, 0 for pruned.
+ * @throws std::invalid_argument if the settings are not valid.
+ */
+Matrix PruneLayer(Matrix &weights, const PruneOptions &options) {
+  if (options.sparsity < 0.0 or options.sparsity > 1.0 or options.m == 0 or
+      options.n > options.m or options.block == 0) {
+    throw std::invalid_argument("Invalid pruning options");
+  }
+  Matrix mask(weights.size(), Vector(weights[0].size(), 1.0));
+
+  switch (options.mode) {
+    case PruneOptions::Mode::kUnstructured:
+      PruneUnstructured(weights, mask, options.sparsity);
+      break;
+    case PruneOptions::Mode::kNM:
+      PruneNM(weights, mask, options.n, options.m);
+      break;
+    case PruneOptions::Mode::kBlock:
+      PruneBlocks(weights, mask, options.sparsity, options.block);
+      break;
+  }
+
+  return mask;
+}
+
+/**
+ * Prunes the weights of every layer by magnitude. Biases are never pruned.
+ *
+ * @param weights The weight matrices, pruned in place.
+ * @param options The pruning settings.
+ * @return The masks of the kept weights of every layer.
+ */
+Tensor Prune(Tensor &weights, const PruneOptions &options) {
+  Tensor masks;
+  masks.reserve(weights.size());
+  for (Matrix &layer : weights) {
+    masks.push_back(PruneLayer(layer, options));
+  }
+  return masks;
+}
+
+/**
+ * @return The fraction of zero weights over all layers.
+ */
+double GetSparsity(const Tensor &weights) {
+  std::size_t zeros = 0, total = 0;
+  for (const Matrix &layer : weights) {
+    for (const Vector &row : layer) {
+      zeros += std::count(row.begin(), row.end(), 0.0);
+      total += row.size();
+    }
+  }
+  return total ? static_cast<double>(zeros) / total : 0.0;
+}
+
+}  // namespace s21
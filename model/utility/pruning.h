@@ -0,0 +1,34 @@
+#ifndef MLP_MODEL_UTILITY_PRUNING_H_
+#define MLP_MODEL_UTILITY_PRUNING_H_
+
+#include "abstract_mlp.h"
+
+namespace s21 {
+
+/**
+ * @struct PruneOptions
+ * @brief Settings of magnitude pruning.
+ *
+ * Unstructured pruning zeroes the given fraction of the smallest weights of
+ * each layer. N:M pruning keeps the n largest of every m consecutive weights
+ * feeding the same neuron, which fixes the sparsity at 1 - n / m. Block
+ * pruning zeroes the given fraction of block x block tiles with the smallest
+ * norm.
+ */
+struct PruneOptions {
+  enum class Mode { kUnstructured, kNM, kBlock };
+
+  Mode mode = Mode::kUnstructured;
+  double sparsity = 0.9;
+  std::size_t n = 2;
+  std::size_t m = 4;
+  std::size_t block = 4;
+};
+
+Matrix PruneLayer(Matrix &, const PruneOptions &);
+Tensor Prune(Tensor &, const PruneOptions &);
+double GetSparsity(const Tensor &);
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_UTILITY_PRUNING_H_
@@ -0,0 +1,55 @@
+#include "replay_buffer.h"
+
+#include <algorithm>
+
+namespace s21 {
+
+ReplayBuffer::ReplayBuffer(std::size_t capacity, unsigned seed)
+    : capacity_{capacity}, gen_{seed} {}
+
+/**
+ * Offers an image of the stream to the reservoir.
+ */
+void ReplayBuffer::Add(const Image &image) {
+  ++seen_;
+  if (samples_.size() < capacity_) {
+    samples_.push_back(image);
+    return;
+  }
+  std::uniform_int_distribution<std::size_t> slot(0, seen_ - 1);
+  const std::size_t idx = slot(gen_);
+  if (idx < capacity_) samples_[idx] = image;
+}
+
+/**
+ * Appends images drawn uniformly, with replacement, from the buffer.
+ *
+ * @param count Number of images to draw; none if the buffer is empty.
+ * @param out The dataset to append to.
+ */
+void ReplayBuffer::Sample(std::size_t count, Dataset &out) {
+  if (samples_.empty()) return;
+  std::uniform_int_distribution<std::size_t> slot(0, samples_.size() - 1);
+  for (std::size_t i = 0; i < count; ++i) {
+    out.push_back(samples_[slot(gen_)]);
+  }
+}
+
+void ReplayBuffer::Clear() {
+  samples_.clear();
+  seen_ = 0;
+}
+
+/**
+ * Changes the capacity. Shrinking drops random images, which keeps the
+ * remaining ones a uniform sample of the stream.
+ */
+void ReplayBuffer::SetCapacity(std::size_t capacity) {
+  if (capacity < samples_.size()) {
+    std::shuffle(samples_.begin(), samples_.end(), gen_);
+    samples_.resize(capacity);
+  }
+  capacity_ = capacity;
+}
+
+}  // namespace s21
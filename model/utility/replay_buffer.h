@@ -0,0 +1,41 @@
+#ifndef MLP_MODEL_UTILITY_REPLAY_BUFFER_H_
+#define MLP_MODEL_UTILITY_REPLAY_BUFFER_H_
+
+#include <random>
+
+#include "io.h"
+
+namespace s21 {
+
+/**
+ * @class ReplayBuffer
+ * @brief Fixed-size uniform sample of a stream of images.
+ *
+ * The buffer keeps a reservoir sample: after n images were added, every one
+ * of them is in the buffer with the same probability capacity / n, so old
+ * data keeps being replayed without the memory growing with the stream.
+ */
+class ReplayBuffer {
+ public:
+  explicit ReplayBuffer(std::size_t capacity,
+                        unsigned seed = std::random_device{}());
+
+  void Add(const Image &);
+  void Sample(std::size_t count, Dataset &out);
+  void Clear();
+
+  std::size_t GetSize() const { return samples_.size(); }
+  std::size_t GetCapacity() const { return capacity_; }
+  void SetCapacity(std::size_t);
+  std::size_t GetSeen() const { return seen_; }
+
+ private:
+  std::size_t capacity_;
+  std::size_t seen_ = 0;
+  Dataset samples_;
+  std::mt19937 gen_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_UTILITY_REPLAY_BUFFER_H_
@@ -0,0 +1,87 @@
+#include "sparse_matrix.h"
+
+namespace s21 {
+
+/**
+ * Converts a dense matrix to the CSR format, dropping its zeros.
+ *
+ * @param matrix The dense matrix.
+ * @return The matrix in CSR format.
+ */
+SparseMatrix ToSparse(const Matrix& matrix) {
+  SparseMatrix sparse;
+  sparse.rows = matrix.size();
+  sparse.cols = matrix.empty() ? 0 : matrix[0].size();
+  sparse.row_offsets.reserve(sparse.rows + 1);
+
+  for (const Vector& row : matrix) {
+    for (std::size_t j = 0; j < row.size(); ++j) {
+      if (row[j] != 0.0) {
+        sparse.columns.push_back(static_cast<std::uint32_t>(j));
+        sparse.values.push_back(row[j]);
+      }
+    }
+    sparse.row_offsets.push_back(sparse.values.size());
+  }
+
+  return sparse;
+}
+
+/**
+ * Converts a CSR matrix back to the dense format.
+ *
+ * @param sparse The matrix in CSR format.
+ * @return The dense matrix.
+ */
+Matrix ToDense(const SparseMatrix& sparse) {
+  Matrix matrix(sparse.rows, Vector(sparse.cols, 0.0));
+  for (std::size_t i = 0; i < sparse.rows; ++i) {
+    for (std::size_t p = sparse.row_offsets[i]; p < sparse.row_offsets[i + 1];
+         ++p) {
+      matrix[i][sparse.columns[p]] = sparse.values[p];
+    }
+  }
+  return matrix;
+}
+
+/**
+ * Multiplies a dense matrix by a CSR matrix. Every non-zero of the dense
+ * matrix scales one sparse row into the result, so the work is proportional
+ * to the non-zeros of both operands.
+ *
+ * @param dense The dense matrix, one sample per row.
+ * @param sparse The sparse matrix.
+ * @param result Receives the product.
+ * @throws std::logic_error if the matrices have inconsistent dimensions.
+ */
+void MultiplySparse(const Matrix& dense, const SparseMatrix& sparse,
+                    Matrix& result) {
+  if (dense.empty() or dense[0].size() != sparse.rows) {
+    throw std::logic_error("Matrices have inconsistent dimensions");
+  }
+  result.assign(dense.size(), Vector(sparse.cols, 0.0));
+
+  for (std::size_t i = 0; i < dense.size(); ++i) {
+    const Vector& row = dense[i];
+    double* output = result[i].data();
+    for (std::size_t k = 0; k < sparse.rows; ++k) {
+      const double value = row[k];
+      if (value == 0.0) continue;
+      for (std::size_t p = sparse.row_offsets[k];
+           p < sparse.row_offsets[k + 1]; ++p) {
+        output[sparse.columns[p]] += value * sparse.values[p];
+      }
+    }
+  }
+}
+
+/**
+ * Overloaded operator* that multiplies a dense matrix by a CSR matrix.
+ */
+Matrix operator*(const Matrix& dense, const SparseMatrix& sparse) {
+  Matrix result;
+  MultiplySparse(dense, sparse, result);
+  return result;
+}
+
+}  // namespace s21
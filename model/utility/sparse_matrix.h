@@ -0,0 +1,38 @@
+#ifndef MLP_MODEL_UTILITY_SPARSE_MATRIX_H_
+#define MLP_MODEL_UTILITY_SPARSE_MATRIX_H_
+
+#include <cstdint>
+
+#include "matrix_operations.h"
+
+namespace s21 {
+
+/**
+ * @struct SparseMatrix
+ * @brief Matrix in compressed sparse row (CSR) format.
+ *
+ * The non-zero values of row i are values[row_offsets[i]] up to
+ * values[row_offsets[i + 1]], and columns holds the column of each of them.
+ */
+struct SparseMatrix {
+  std::size_t rows = 0;
+  std::size_t cols = 0;
+  std::vector<std::size_t> row_offsets{0};
+  std::vector<std::uint32_t> columns;
+  Vector values;
+
+  std::size_t GetNonZeros() const { return values.size(); }
+  double GetDensity() const {
+    const std::size_t size = rows * cols;
+    return size ? static_cast<double>(values.size()) / size : 0.0;
+  }
+};
+
+SparseMatrix ToSparse(const Matrix &);
+Matrix ToDense(const SparseMatrix &);
+void MultiplySparse(const Matrix &, const SparseMatrix &, Matrix &);
+Matrix operator*(const Matrix &, const SparseMatrix &);
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_UTILITY_SPARSE_MATRIX_H_
@@ -0,0 +1,68 @@
+#ifndef MLP_MODEL_UTILITY_SPSC_QUEUE_H_
+#define MLP_MODEL_UTILITY_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace s21 {
+
+/**
+ * @class SpscQueue
+ * @brief Bounded lock-free queue for exactly one producer and one consumer.
+ *
+ * The queue is a ring buffer whose head and tail indices live on separate
+ * cache lines. The producer only writes the tail and the consumer only writes
+ * the head, so neither side ever blocks the other.
+ */
+template <typename T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(std::size_t capacity)
+      : buffer_(capacity + 1), head_{0}, tail_{0} {}
+
+  bool TryPush(T&& value) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    const std::size_t next = Next(tail);
+    if (next == head_.load(std::memory_order_acquire)) return false;
+    buffer_[tail] = std::move(value);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool TryPop(T& value) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    value = std::move(buffer_[head]);
+    head_.store(Next(head), std::memory_order_release);
+    return true;
+  }
+
+  void Push(T value) {
+    while (!TryPush(std::move(value))) std::this_thread::yield();
+  }
+
+  T Pop() {
+    T value;
+    while (!TryPop(value)) std::this_thread::yield();
+    return value;
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  std::size_t Next(std::size_t idx) const {
+    return idx + 1 == buffer_.size() ? 0 : idx + 1;
+  }
+
+  std::vector<T> buffer_;
+  alignas(64) std::atomic<std::size_t> head_;
+  alignas(64) std::atomic<std::size_t> tail_;
+};
+
+}  // namespace s21
+
+#endif  // MLP_MODEL_UTILITY_SPSC_QUEUE_H_
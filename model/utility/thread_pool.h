@@ -2,8 +2,11 @@
 #define MLP_MODEL_UTILITY_THREAD_POOL_H_
 
 #include <algorithm>
+#include <condition_variable>
+#include <functional>
 #include <future>
 #include <iterator>
+#include <mutex>
 #include <queue>
 #include <random>
 #include <thread>
@@ -44,8 +47,8 @@ class ThreadPool {
 
   template <typename F, typename... Args>
   auto enqueue(F&& f, Args&&... args)
-      -> std::future<typename std::result_of<F(Args...)>::type> {
-    using return_type = typename std::result_of<F(Args...)>::type;
+      -> std::future<std::invoke_result_t<F, Args...>> {
+    using return_type = std::invoke_result_t<F, Args...>;
     auto task = std::make_shared<std::packaged_task<return_type()>>(
         std::bind(std::forward<F>(f), std::forward<Args>(args)...));
     auto result = task->get_future();
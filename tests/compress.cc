@@ -0,0 +1,59 @@
+#include <chrono>
+#include <iostream>
+
+#include "mlp.h"
+
+using namespace s21;
+
+constexpr std::size_t kBenchmarkBatch = 256;
+constexpr std::size_t kBenchmarkRepeats = 10;
+
+template <typename Func>
+double Seconds(Func func) {
+  auto start = std::chrono::high_resolution_clock::now();
+  for (std::size_t i = 0; i < kBenchmarkRepeats; ++i) func();
+  std::chrono::duration<double> elapsed =
+      std::chrono::high_resolution_clock::now() - start;
+  return elapsed.count() / kBenchmarkRepeats;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cout << "Usage: " << argv[0] << " <weights> <output> [budget]\n";
+    return 1;
+  }
+  const double budget = argc > 3 ? std::stod(argv[3]) : 0.01;
+
+  MLP mlp{Topology{}};
+  mlp.Load(argv[1]);
+  mlp.SetVerbose(false);
+  mlp.SetTestDataset("../datasets/emnist-letters-test.csv");
+  mlp.Test();
+  std::cout << "Dense accuracy: " << mlp.GetMetrics().GetAccuracy() << "\n";
+
+  const auto [weights, biases] = mlp.GetMlp();
+  const std::vector<std::size_t> ranks = mlp.CompressLowRank(budget);
+  mlp.Test();
+  std::cout << "Low-rank accuracy: " << mlp.GetMetrics().GetAccuracy()
+            << "\n";
+  for (std::size_t i = 0; i < ranks.size(); ++i) {
+    std::cout << "Layer " << i << " " << weights[i].size() << "x"
+              << weights[i][0].size() << ": rank "
+              << (ranks[i] ? std::to_string(ranks[i]) : "dense") << "\n";
+  }
+
+  mlp.Save(argv[2]);
+  std::cout << "Saved to " << argv[2] << "\n";
+
+  if (!ranks[0]) return 0;
+  Matrix batch(kBenchmarkBatch, Vector(weights[0].size(), 0.5));
+  LowRank decomposition(weights[0]);
+  const Factorization factors = decomposition.Truncate(ranks[0]);
+  Matrix output;
+  double dense_time = Seconds([&] { output = batch * weights[0]; });
+  double low_rank_time =
+      Seconds([&] { output = (batch * factors.left) * factors.right; });
+  std::cout << "First layer, batch " << kBenchmarkBatch << ": dense "
+            << dense_time << " sec, low-rank " << low_rank_time
+            << " sec, speedup " << dense_time / low_rank_time << "x\n";
+}
@@ -3,6 +3,8 @@
 #include <cmath>
 
 #include "matrix_operations.h"
+#include "pruning.h"
+#include "sparse_matrix.h"
 
 using namespace s21;
 
@@ -169,6 +171,29 @@ TEST(MatrixOperations, OperatorMinusEqual) {
   EXPECT_TRUE(IsEqualMatrices(m1, m3));
 }
 
+TEST(MatrixOperations, OperatorPlusEqual) {
+  Matrix m1 = {{1, 2, 3}, {4, 5, 6}};
+  Matrix m2 = {{6, 5, 4}, {3, 2, 1}};
+  Matrix m3 = {{7, 7, 7}, {7, 7, 7}};
+  m1 += m2;
+  EXPECT_TRUE(IsEqualMatrices(m1, m3));
+}
+
+TEST(MatrixOperations, BroadcastAddition) {
+  Matrix m1 = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+  Matrix row = {{1, 0, -1}};
+  Matrix m2 = {{2, 2, 2}, {5, 5, 5}, {8, 8, 8}};
+  Matrix m = BroadcastAddition(m1, row);
+  EXPECT_TRUE(IsEqualMatrices(m, m2));
+}
+
+TEST(MatrixOperations, SumRows) {
+  Matrix m1 = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+  Matrix m2 = {{12, 15, 18}};
+  Matrix m = SumRows(m1);
+  EXPECT_TRUE(IsEqualMatrices(m, m2));
+}
+
 TEST(MatrixOperations, MultiplyHadamard) {
   Matrix m1 = {{1, 2, 3, 4, 5, 6, 7, 8, 9}, {2, 3, 4, 5, 6, 7, 8, 9, 1},
                {3, 4, 5, 6, 7, 8, 9, 1, 2}, {4, 5, 6, 7, 8, 9, 1, 2, 3},
@@ -297,6 +322,79 @@ TEST(MatrixOperations, ActivateDerivative) {
   EXPECT_TRUE(IsEqualMatrices(m, m2));
 }
 
+TEST(MatrixOperations, ActivateInPlace) {
+  Matrix m1 = {{-2, -0.5, 0}, {0.5, 1, 3}};
+  Matrix m2 = m1;
+  ActivateInPlace<Sigmoid>(m2);
+  EXPECT_TRUE(IsEqualMatrices(m2, Activate(m1, sigmoid)));
+
+  Matrix m3 = m1;
+  ActivateInPlace<LeakyRelu>(m3);
+  EXPECT_TRUE(IsEqualMatrices(m3, {{-0.02, -0.005, 0}, {0.5, 1, 3}}));
+
+  Matrix m4 = {{1, 2, 3}, {1000, 1000, 1000}};
+  ActivateInPlace<Softmax>(m4);
+  EXPECT_NEAR(m4[0][0], 0.090031, 1e-6);
+  EXPECT_NEAR(m4[0][2], 0.665241, 1e-6);
+  EXPECT_NEAR(m4[1][1], 1.0 / 3.0, 1e-12);
+}
+
+TEST(MatrixOperations, MultiplyDerivative) {
+  Matrix values = {{-0.5, 0, 0.5}};
+  Matrix errors = {{2, 2, 2}};
+  MultiplyDerivative<Tanh>(errors, values);
+  EXPECT_TRUE(IsEqualMatrices(errors, {{1.5, 2, 1.5}}));
+
+  errors = {{2, 2, 2}};
+  MultiplyDerivative<Relu>(errors, values);
+  EXPECT_TRUE(IsEqualMatrices(errors, {{0, 0, 2}}));
+  EXPECT_THROW(MultiplyDerivative<Relu>(errors, {{1}}), std::logic_error);
+}
+
+TEST(MatrixOperations, SparseMultiply) {
+  Matrix dense = {{1, 0, 2, 0}, {0, 0, 3, 4}};
+  Matrix weights = {{0, 1, 0}, {2, 0, 0}, {0, 0, 3}, {4, 0, 5}};
+  SparseMatrix sparse = ToSparse(weights);
+  EXPECT_EQ(sparse.GetNonZeros(), 5);
+  EXPECT_DOUBLE_EQ(sparse.GetDensity(), 5.0 / 12.0);
+  EXPECT_TRUE(IsEqualMatrices(ToDense(sparse), weights));
+  EXPECT_TRUE(IsEqualMatrices(dense * sparse, dense * weights));
+  EXPECT_THROW(weights * sparse, std::logic_error);
+}
+
+TEST(Pruning, Unstructured) {
+  Matrix weights = {{0.1, -0.9, 0.3}, {-0.2, 0.5, 0.05}};
+  PruneOptions options;
+  options.sparsity = 0.5;
+  Matrix mask = PruneLayer(weights, options);
+  EXPECT_TRUE(IsEqualMatrices(weights, {{0, -0.9, 0.3}, {0, 0.5, 0}}));
+  EXPECT_TRUE(IsEqualMatrices(mask, {{0, 1, 1}, {0, 1, 0}}));
+  EXPECT_DOUBLE_EQ(GetSparsity({weights}), 0.5);
+}
+
+TEST(Pruning, NM) {
+  Matrix weights = {{1, -8}, {-4, 2}, {3, 1}, {2, 7}};
+  PruneOptions options;
+  options.mode = PruneOptions::Mode::kNM;
+  options.n = 2;
+  options.m = 4;
+  PruneLayer(weights, options);
+  EXPECT_TRUE(IsEqualMatrices(weights, {{0, -8}, {-4, 0}, {3, 0}, {0, 7}}));
+}
+
+TEST(Pruning, Block) {
+  Matrix weights = {{1, 1, 5, 5}, {1, 1, 5, 5}, {9, 9, 2, 2}, {9, 9, 2, 2}};
+  PruneOptions options;
+  options.mode = PruneOptions::Mode::kBlock;
+  options.block = 2;
+  options.sparsity = 0.5;
+  PruneLayer(weights, options);
+  EXPECT_TRUE(IsEqualMatrices(
+      weights, {{0, 0, 5, 5}, {0, 0, 5, 5}, {9, 9, 0, 0}, {9, 9, 0, 0}}));
+  options.n = 5;
+  EXPECT_THROW(PruneLayer(weights, options), std::invalid_argument);
+}
+
 TEST(MatrixOperations, Exceptions) {
   Matrix m1;
   Matrix m2{{1, 2, 3}, {4, 5, 6}};
@@ -309,6 +407,9 @@ TEST(MatrixOperations, Exceptions) {
   EXPECT_THROW(ActivateDerivative(m1, sigmoid_derivative), std::logic_error);
   EXPECT_THROW(MultiplyWinograd(m1, m2), std::logic_error);
   EXPECT_THROW(Multiply(m1, m2), std::logic_error);
+  EXPECT_THROW(BroadcastAddition(m2, m2), std::logic_error);
+  EXPECT_THROW(SumRows(m1), std::logic_error);
+  EXPECT_THROW(m1 += m2, std::logic_error);
   PrintVector(v);
   PrintMatrix(m1);
   RandomizeVector(v);
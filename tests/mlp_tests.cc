@@ -0,0 +1,1731 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+#include "mlp.h"
+
+using namespace s21;
+
+namespace {
+
+constexpr double kTolerance = 1e-9;
+
+Dataset RandomDataset(std::size_t size, std::size_t pixels,
+                      std::size_t classes) {
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> pixel(0.0, Image::kMaxPixel);
+  Dataset dataset;
+  for (std::size_t i = 0; i < size; ++i) {
+    Image::Pixels pixels_values(pixels);
+    for (double& value : pixels_values) value = pixel(gen);
+    dataset.emplace_back(pixels_values, i % classes + 1);
+  }
+  return dataset;
+}
+
+double MaxDifference(const Tensor& t1, const Tensor& t2) {
+  double max_diff = 0.0;
+  for (std::size_t i = 0; i < t1.size(); ++i) {
+    for (std::size_t j = 0; j < t1[i].size(); ++j) {
+      for (std::size_t k = 0; k < t1[i][j].size(); ++k) {
+        max_diff = std::max(max_diff, std::fabs(t1[i][j][k] - t2[i][j][k]));
+      }
+    }
+  }
+  return max_diff;
+}
+
+}  // namespace
+
+TEST(MatrixMlp, BatchForwardMatchesSingleSample) {
+  Topology topology{16, 12, 8, 4};
+  Dataset dataset = RandomDataset(5, 16, 4);
+  MatrixMlp mlp{topology};
+  Tensor values(topology.GetLayersCount());
+  for (const Image& image : dataset) {
+    values[0].push_back(image.GetPixels());
+  }
+
+  mlp.ForwardPropagation(values);
+
+  for (std::size_t i = 0; i < dataset.size(); ++i) {
+    mlp.SetInputLayer(dataset[i].GetPixels());
+    mlp.ForwardPropagation();
+    Vector output = mlp.GetOutput();
+    for (std::size_t j = 0; j < output.size(); ++j) {
+      EXPECT_NEAR(output[j], values.back()[i][j], kTolerance);
+    }
+  }
+}
+
+TEST(MatrixMlp, GradientsMatchNumerical) {
+  for (auto output : {Activation::kSigmoid, Activation::kSoftmax}) {
+    Topology topology{6, 5, 4, 3};
+    topology.SetActivation(Activation::kTanh, 0);
+    topology.SetActivation(Activation::kLeakyRelu, 1);
+    topology.SetActivation(output, 2);
+    Dataset dataset = RandomDataset(3, 6, 3);
+    MatrixMlp mlp{topology};
+    Tensor values(1), weight_grads, bias_grads;
+    for (const Image& image : dataset) values[0].push_back(image.GetPixels());
+    Labels labels{1, 2, 3};
+    const auto& [weights, biases] = mlp.GetMlp();
+    for (std::size_t i = 0; i < weights.size(); ++i) {
+      weight_grads.emplace_back(weights[i].size(),
+                                Vector(weights[i][0].size()));
+      bias_grads.emplace_back(1, Vector(weights[i][0].size()));
+    }
+    // The errors are the gradient of half the squared error, but of the
+    // whole cross-entropy
+    const double scale = (output == Activation::kSoftmax) ? 1.0 : 0.5;
+    auto loss = [&]() {
+      Tensor layers = values;
+      mlp.ForwardPropagation(layers);
+      Matrix errors;
+      return mlp.OutputErrors(layers.back(), labels, errors) * scale;
+    };
+
+    Tensor layers = values;
+    mlp.ForwardPropagation(layers);
+    mlp.ComputeGradients(layers, labels, weight_grads, bias_grads);
+
+    const double h = 1e-6;
+    for (std::size_t i = 0; i < weights.size(); ++i) {
+      double& weight = mlp.GetWeights()[i][1][2];
+      weight += h;
+      double plus = loss();
+      weight -= 2 * h;
+      double minus = loss();
+      weight += h;
+      EXPECT_NEAR(weight_grads[i][1][2], (plus - minus) / (2 * h), 1e-6);
+    }
+  }
+}
+
+TEST(MatrixMlp, MatchesGraphWithActivations) {
+  for (auto output : {Activation::kTanh, Activation::kSoftmax}) {
+    Topology topology{16, 12, 8, 4};
+    topology.SetHiddenActivation(Activation::kRelu);
+    topology.SetOutputActivation(output);
+    Dataset dataset = RandomDataset(5, 16, 4);
+    MatrixMlp matrix{topology};
+    GraphMlp graph{topology};
+    const auto& [weights, biases] = matrix.GetMlp();
+    graph.SetMlp(weights, biases);
+
+    for (const Image& image : dataset) {
+      matrix.SetInputLayer(image.GetPixels());
+      matrix.ForwardPropagation();
+      graph.SetInputLayer(image.GetPixels());
+      graph.ForwardPropagation();
+      Vector output1 = matrix.GetOutput(), output2 = graph.GetOutput();
+      for (std::size_t j = 0; j < output1.size(); ++j) {
+        EXPECT_NEAR(output1[j], output2[j], kTolerance);
+      }
+    }
+  }
+}
+
+TEST(MatrixMlp, CheckpointedGradientsMatch) {
+  Topology topology{16, 12, 10, 8, 6, 4};
+  Dataset dataset = RandomDataset(7, 16, 4);
+  MatrixMlp mlp{topology};
+  Labels labels;
+  Tensor full(1), checkpointed(1);
+  for (const Image& image : dataset) {
+    full[0].push_back(image.GetPixels());
+    labels.push_back(image.GetLabel());
+  }
+  checkpointed[0] = full[0];
+  Tensor grads1 = mlp.GetWeights(), grads2 = mlp.GetWeights();
+  Tensor bias_grads1 = mlp.GetBiases(), bias_grads2 = mlp.GetBiases();
+  for (Tensor* tensor : {&grads1, &grads2, &bias_grads1, &bias_grads2}) {
+    for (Matrix& matrix : *tensor) {
+      for (Vector& row : matrix) std::fill(row.begin(), row.end(), 0.0);
+    }
+  }
+  Checkpoints checkpoints{true, false, false, true, false, true};
+
+  mlp.ForwardPropagation(full);
+  double loss1 = mlp.ComputeGradients(full, labels, grads1, bias_grads1);
+  mlp.ForwardPropagation(checkpointed, checkpoints);
+  EXPECT_TRUE(checkpointed[1].empty());
+  EXPECT_FALSE(checkpointed[3].empty());
+  double loss2 = mlp.ComputeGradients(checkpointed, checkpoints, labels,
+                                      grads2, bias_grads2);
+
+  EXPECT_DOUBLE_EQ(loss1, loss2);
+  EXPECT_EQ(MaxDifference(grads1, grads2), 0.0);
+  EXPECT_EQ(MaxDifference(bias_grads1, bias_grads2), 0.0);
+  EXPECT_TRUE(checkpointed[2].empty());
+  EXPECT_TRUE(checkpointed[4].empty());
+}
+
+TEST(MatrixMlp, SelectCheckpointsFitsBudget) {
+  MatrixMlp mlp{Topology{100, 100, 100, 100, 100, 100, 100, 10}};
+  const std::size_t batch = 64;
+  Checkpoints all(8, true);
+  const std::size_t full = mlp.ActivationMemory(batch, all);
+
+  EXPECT_EQ(mlp.SelectCheckpoints(batch, 0), all);
+  EXPECT_EQ(mlp.SelectCheckpoints(batch, full), all);
+
+  Checkpoints checkpoints = mlp.SelectCheckpoints(batch, full * 3 / 4);
+  EXPECT_LE(mlp.ActivationMemory(batch, checkpoints), full * 3 / 4);
+  EXPECT_TRUE(checkpoints.front());
+  EXPECT_TRUE(checkpoints.back());
+  EXPECT_LT(std::count(checkpoints.begin(), checkpoints.end(), true), 8);
+}
+
+TEST(DataParallel, MatchesSingleThread) {
+  Topology topology{16, 12, 8, 4};
+  Dataset dataset = RandomDataset(64, 16, 4);
+  std::vector<std::size_t> indices(dataset.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  MatrixMlp serial{topology};
+  MatrixMlp parallel{topology};
+  const auto& [weights, biases] = serial.GetMlp();
+  parallel.SetMlp(weights, biases);
+
+  DataParallel single_thread(serial, 1);
+  DataParallel multi_thread(parallel, 4);
+  for (std::size_t begin = 0; begin < dataset.size(); begin += 10) {
+    std::size_t end = std::min(begin + 10, dataset.size());
+    double loss1 = single_thread.TrainBatch(dataset, indices, begin, end, 0.5);
+    double loss2 = multi_thread.TrainBatch(dataset, indices, begin, end, 0.5);
+    EXPECT_NEAR(loss1, loss2, kTolerance);
+  }
+
+  EXPECT_LT(MaxDifference(serial.GetWeights(), parallel.GetWeights()),
+            kTolerance);
+  EXPECT_LT(MaxDifference(serial.GetBiases(), parallel.GetBiases()),
+            kTolerance);
+  EXPECT_GT(MaxDifference(serial.GetWeights(), weights), kTolerance);
+}
+
+TEST(DataParallel, MemoryBudgetKeepsResults) {
+  Topology topology{16, 12, 12, 12, 4};
+  Dataset dataset = RandomDataset(32, 16, 4);
+  std::vector<std::size_t> indices(dataset.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  MatrixMlp full{topology};
+  MatrixMlp bounded{topology};
+  const auto& [weights, biases] = full.GetMlp();
+  bounded.SetMlp(weights, biases);
+
+  DataParallel full_trainer(full, 2);
+  DataParallel bounded_trainer(bounded, 2);
+  bounded_trainer.SetMemoryBudget(1);
+  for (std::size_t begin = 0; begin < dataset.size(); begin += 8) {
+    full_trainer.TrainBatch(dataset, indices, begin, begin + 8, 0.5);
+    bounded_trainer.TrainBatch(dataset, indices, begin, begin + 8, 0.5);
+  }
+
+  EXPECT_EQ(MaxDifference(full.GetWeights(), bounded.GetWeights()), 0.0);
+}
+
+TEST(Pipeline, MatchesDataParallel) {
+  Topology topology{16, 12, 10, 8, 4};
+  Dataset dataset = RandomDataset(64, 16, 4);
+  std::vector<std::size_t> indices(dataset.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  MatrixMlp reference{topology};
+  MatrixMlp pipelined{topology};
+  const auto& [weights, biases] = reference.GetMlp();
+  pipelined.SetMlp(weights, biases);
+
+  DataParallel data_parallel(reference, 1);
+  Pipeline pipeline(pipelined, 3, 3);
+  EXPECT_EQ(pipeline.GetStagesCount(), 3u);
+  for (std::size_t begin = 0; begin < dataset.size(); begin += 10) {
+    std::size_t end = std::min(begin + 10, dataset.size());
+    double loss1 = data_parallel.TrainBatch(dataset, indices, begin, end, 0.5);
+    double loss2 = pipeline.TrainBatch(dataset, indices, begin, end, 0.5);
+    EXPECT_NEAR(loss1, loss2, kTolerance);
+  }
+
+  EXPECT_LT(MaxDifference(reference.GetWeights(), pipelined.GetWeights()),
+            kTolerance);
+  EXPECT_LT(MaxDifference(reference.GetBiases(), pipelined.GetBiases()),
+            kTolerance);
+}
+
+TEST(MixedPrecision, MatchesDoublePrecision) {
+  Topology topology{16, 12, 8, 4};
+  topology.SetOutputActivation(Activation::kSoftmax);
+  Dataset dataset = RandomDataset(64, 16, 4);
+  std::vector<std::size_t> indices(dataset.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  MatrixMlp full{topology};
+  MatrixMlp mixed{topology};
+  const auto& [weights, biases] = full.GetMlp();
+  mixed.SetMlp(weights, biases);
+
+  DataParallel double_trainer(full, 1);
+  MixedPrecision mixed_trainer(mixed);
+  for (std::size_t begin = 0; begin < dataset.size(); begin += 16) {
+    std::size_t end = begin + 16;
+    double loss1 = double_trainer.TrainBatch(dataset, indices, begin, end, 0.5);
+    double loss2 = mixed_trainer.TrainBatch(dataset, indices, begin, end, 0.5);
+    EXPECT_NEAR(loss1, loss2, 1e-3 * loss1);
+  }
+
+  EXPECT_LT(MaxDifference(full.GetWeights(), mixed.GetWeights()), 1e-4);
+  EXPECT_GT(MaxDifference(mixed.GetWeights(), weights), 1e-4);
+  EXPECT_EQ(mixed_trainer.GetSkippedCount(), 0);
+}
+
+TEST(MixedPrecision, SkipsOverflowingStep) {
+  Topology topology{16, 8, 4};
+  Dataset dataset = RandomDataset(8, 16, 4);
+  std::vector<std::size_t> indices(dataset.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  MatrixMlp mlp{topology};
+  const auto [weights, biases] = mlp.GetMlp();
+
+  MixedPrecision trainer(mlp, 1e39);
+  trainer.TrainBatch(dataset, indices, 0, dataset.size(), 0.5);
+
+  EXPECT_EQ(trainer.GetSkippedCount(), 1);
+  EXPECT_DOUBLE_EQ(trainer.GetLossScale(), 5e38);
+  EXPECT_EQ(MaxDifference(mlp.GetWeights(), weights), 0.0);
+
+  while (trainer.GetSkippedCount() < 100) {
+    std::size_t skipped = trainer.GetSkippedCount();
+    trainer.TrainBatch(dataset, indices, 0, dataset.size(), 0.5);
+    if (trainer.GetSkippedCount() == skipped) break;
+  }
+  EXPECT_LT(trainer.GetLossScale(), 3.4e38);
+  EXPECT_GT(MaxDifference(mlp.GetWeights(), weights), 0.0);
+}
+
+TEST(MixedPrecision, RecoversWithinBoundedSkips) {
+  Dataset dataset = RandomDataset(8, 16, 4);
+  std::vector<std::size_t> indices(dataset.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  MatrixMlp mlp{Topology{16, 8, 4}};
+  const Tensor weights = mlp.GetWeights();
+
+  MixedPrecision trainer(mlp, 1e39);
+  std::size_t skipped = 0;
+  do {
+    skipped = trainer.GetSkippedCount();
+    trainer.TrainBatch(dataset, indices, 0, dataset.size(), 0.5);
+    EXPECT_LE(trainer.GetLossScale(), 5e38);
+  } while (trainer.GetSkippedCount() > skipped and skipped < 100);
+  EXPECT_LT(trainer.GetSkippedCount(), 100);
+  EXPECT_GT(MaxDifference(mlp.GetWeights(), weights), 0.0);
+}
+
+TEST(Hogwild, ReducesLoss) {
+  Topology topology{16, 12, 4};
+  Dataset dataset = RandomDataset(64, 16, 4);
+  MatrixMlp mlp{topology};
+  Hogwild trainer(mlp, 4);
+
+  double first_loss = trainer.Train(dataset, 0.5);
+  double last_loss = first_loss;
+  for (int epoch = 0; epoch < 50; ++epoch) {
+    last_loss = trainer.Train(dataset, 0.5);
+  }
+
+  EXPECT_LT(last_loss, first_loss);
+  EXPECT_EQ(trainer.GetThroughput().size(), 4u);
+}
+
+TEST(Optimizer, Momentum) {
+  Vector params{1.0, 2.0}, grads{0.5, -1.0}, velocity{0.0, 0.0};
+  Momentum momentum(0.9);
+  momentum.NextStep();
+  momentum.Update(params.data(), grads.data(), velocity.data(), nullptr, 2,
+                  0.1);
+  momentum.NextStep();
+  momentum.Update(params.data(), grads.data(), velocity.data(), nullptr, 2,
+                  0.1);
+  EXPECT_NEAR(params[0], 1.0 - 0.05 - 0.095, kTolerance);
+  EXPECT_NEAR(params[1], 2.0 + 0.1 + 0.19, kTolerance);
+}
+
+TEST(Optimizer, Nesterov) {
+  Vector params{1.0}, grads{0.5}, velocity{0.0};
+  Momentum nesterov(0.9, true);
+  nesterov.NextStep();
+  nesterov.Update(params.data(), grads.data(), velocity.data(), nullptr, 1,
+                  0.1);
+  EXPECT_NEAR(params[0], 1.0 - 0.1 * (0.5 + 0.9 * 0.5), kTolerance);
+}
+
+TEST(Optimizer, AdamFirstStep) {
+  Vector params{1.0, 2.0}, grads{0.5, -3.0}, first(2), second(2);
+  Adam adam;
+  adam.NextStep();
+  adam.Update(params.data(), grads.data(), first.data(), second.data(), 2,
+              0.01);
+  EXPECT_NEAR(params[0], 0.99, 1e-6);
+  EXPECT_NEAR(params[1], 2.01, 1e-6);
+}
+
+TEST(MLP, AdamReducesLoss) {
+  for (auto type : {Config::ModelType::kMatrix, Config::ModelType::kGraph}) {
+    MLP mlp{Topology{16, 12, 4}};
+    mlp.SetType(type);
+    mlp.SetOptimizer(Config::OptimizerType::kAdam);
+    mlp.SetLearningRate(0.01);
+    mlp.SetTrainDataset(RandomDataset(100, 16, 4));
+    mlp.SetEpochs(30);
+    Vector losses;
+    mlp.SetMFunc([&losses](Metrics metrics) {
+      losses.push_back(metrics.GetLoss());
+    });
+    mlp.Train();
+    EXPECT_LT(losses.back(), losses.front());
+  }
+}
+
+TEST(MLP, CrossEntropyReducesLoss) {
+  for (auto type : {Config::ModelType::kMatrix, Config::ModelType::kGraph}) {
+    MLP mlp{Topology{16, 12, 4}};
+    mlp.SetType(type);
+    mlp.SetOutputActivation(Activation::kSoftmax);
+    mlp.SetLearningRate(0.01);
+    mlp.SetTrainDataset(RandomDataset(100, 16, 4));
+    mlp.SetEpochs(30);
+    Vector losses;
+    mlp.SetMFunc([&losses](Metrics metrics) {
+      EXPECT_TRUE(metrics.IsCrossEntropy());
+      losses.push_back(metrics.GetLoss());
+    });
+    mlp.Train();
+    EXPECT_LT(losses.back(), losses.front());
+  }
+}
+
+TEST(MLP, SoftmaxOnlyForOutputLayer) {
+  Topology topology{16, 8, 4};
+  EXPECT_THROW(topology.SetActivation(Activation::kSoftmax, 0),
+               std::invalid_argument);
+  EXPECT_THROW(topology.SetHiddenActivation(Activation::kSoftmax),
+               std::invalid_argument);
+  topology.SetActivation(Activation::kSoftmax, 1);
+  EXPECT_TRUE(topology.IsCrossEntropy());
+}
+
+TEST(MLP, GrowingSoftmaxNetworkKeepsHiddenActivations) {
+  Topology topology{16, 4};
+  topology.SetOutputActivation(Activation::kSoftmax);
+  for (bool grow : {false, true}) {
+    MLP mlp{topology};
+    mlp.UpdateTopology(2, 8, grow);
+    const std::vector<Activation>& activations =
+        mlp.GetTopology().GetActivations();
+    ASSERT_EQ(activations.size(), 3u);
+    EXPECT_NE(activations[0], Activation::kSoftmax);
+    EXPECT_NE(activations[1], Activation::kSoftmax);
+    EXPECT_EQ(activations[2], Activation::kSoftmax);
+  }
+}
+
+TEST(MLP, PrunedFineTuningKeepsSparsity) {
+  MLP mlp{Topology{16, 12, 4}};
+  mlp.SetTrainDataset(RandomDataset(100, 16, 4));
+  PruneOptions options;
+  options.sparsity = 0.75;
+  mlp.Prune(options);
+  EXPECT_NEAR(GetSparsity(mlp.GetMlp().first), 0.75, 0.01);
+
+  mlp.SetBatchSize(10);
+  mlp.SetEpochs(2);
+  mlp.Train();
+  EXPECT_NEAR(GetSparsity(mlp.GetMlp().first), 0.75, 0.01);
+
+  mlp.SetTrainType(Config::TrainType::kHogwild);
+  mlp.Train();
+  EXPECT_NEAR(GetSparsity(mlp.GetMlp().first), 0.75, 0.01);
+}
+
+TEST(SparseMlp, MatchesDenseAndRoundTrips) {
+  const std::string path = "sparse_test.bin";
+  MLP mlp{Topology{16, 12, 8, 4}};
+  mlp.SetHiddenActivation(Activation::kRelu);
+  PruneOptions options;
+  options.mode = PruneOptions::Mode::kNM;
+  mlp.Prune(options);
+  SparseMlp sparse = mlp.GetSparseMlp();
+  sparse.Save(path);
+  SparseMlp loaded;
+  loaded.Load(path);
+
+  EXPECT_EQ(loaded.GetNonZeros(), (16 * 12 + 12 * 8 + 8 * 4) / 2);
+  for (const Image& image : RandomDataset(5, 16, 4)) {
+    Vector expected = mlp.Predict(image.GetPixels());
+    Vector output = loaded.Predict(image.GetPixels());
+    for (std::size_t j = 0; j < expected.size(); ++j) {
+      EXPECT_NEAR(output[j], expected[j], kTolerance);
+    }
+  }
+  EXPECT_THROW(loaded.Load("missing_file.bin"), std::runtime_error);
+
+  // The first layer starts after the magic and the layer count with its
+  // rows, cols and non-zeros, then 17 row offsets and the column indices
+  std::ifstream file(path, std::ios::binary);
+  const std::string data{std::istreambuf_iterator<char>(file), {}};
+  file.close();
+  auto corrupt = [&path, &data](std::size_t offset, auto value) {
+    std::string copy = data;
+    std::memcpy(&copy[offset], &value, sizeof(value));
+    std::ofstream{path, std::ios::binary}.write(copy.data(), copy.size());
+  };
+  corrupt(48, std::size_t{1} << 40);
+  EXPECT_THROW(loaded.Load(path), std::runtime_error);
+  corrupt(176, std::uint32_t{12});
+  EXPECT_THROW(loaded.Load(path), std::runtime_error);
+  corrupt(32, std::size_t{1} << 60);
+  EXPECT_THROW(loaded.Load(path), std::runtime_error);
+  corrupt(24, std::size_t{11});
+  EXPECT_THROW(loaded.Load(path), std::runtime_error);
+  std::ofstream{path, std::ios::binary}.write(data.data(), data.size() - 1);
+  EXPECT_THROW(loaded.Load(path), std::runtime_error);
+  EXPECT_EQ(loaded.GetNonZeros(), (16 * 12 + 12 * 8 + 8 * 4) / 2);
+  std::remove(path.c_str());
+}
+
+TEST(MLP, MiniBatchRequiresMatrixModel) {
+  MLP mlp{Topology{16, 8, 4}};
+  mlp.SetTrainDataset(RandomDataset(16, 16, 4));
+  mlp.SetType(Config::ModelType::kGraph);
+  mlp.SetBatchSize(4);
+  EXPECT_THROW(mlp.Train(), std::runtime_error);
+}
+
+TEST(MLP, SaveLoadKeepsActivations) {
+  const std::string path = "activations_test.bin";
+  Image image = RandomDataset(1, 16, 4)[0];
+  MLP saved{Topology{16, 8, 8, 4}};
+  saved.SetHiddenActivation(Activation::kLeakyRelu);
+  saved.Save(path);
+
+  MLP loaded{Topology{16, 4}};
+  loaded.Load(path);
+  std::remove(path.c_str());
+
+  std::vector<Activation> expected{Activation::kLeakyRelu,
+                                   Activation::kLeakyRelu,
+                                   Activation::kSigmoid};
+  EXPECT_EQ(loaded.GetTopology().GetActivations(), expected);
+  Vector output1 = saved.Predict(image.GetPixels());
+  Vector output2 = loaded.Predict(image.GetPixels());
+  for (std::size_t j = 0; j < output1.size(); ++j) {
+    EXPECT_NEAR(output1[j], output2[j], kTolerance);
+  }
+}
+
+TEST(LowRank, FullRankReconstructs) {
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> value(-1.0, 1.0);
+  for (auto [rows, cols] : {std::pair{10, 6}, std::pair{6, 10}}) {
+    Matrix weights(rows, Vector(cols));
+    for (Vector& row : weights) {
+      for (double& weight : row) weight = value(gen);
+    }
+    LowRank decomposition(weights);
+    const Vector& singular = decomposition.GetSingularValues();
+    ASSERT_EQ(singular.size(), 6u);
+    EXPECT_TRUE(std::is_sorted(singular.rbegin(), singular.rend()));
+
+    Factorization full = decomposition.Truncate(6);
+    EXPECT_LT(MaxDifference({full.left * full.right}, {weights}), 1e-8);
+
+    // The error of the best rank-r approximation is the next singular value
+    Factorization truncated = decomposition.Truncate(3);
+    EXPECT_EQ(truncated.left.size(), weights.size());
+    EXPECT_EQ(truncated.right.size(), 3u);
+    Matrix residual = weights;
+    Matrix product = truncated.left * truncated.right;
+    double norm = 0.0;
+    for (std::size_t i = 0; i < residual.size(); ++i) {
+      for (std::size_t j = 0; j < residual[i].size(); ++j) {
+        const double diff = residual[i][j] - product[i][j];
+        norm += diff * diff;
+      }
+    }
+    double expected = 0.0;
+    for (std::size_t i = 3; i < singular.size(); ++i) {
+      expected += singular[i] * singular[i];
+    }
+    EXPECT_NEAR(norm, expected, 1e-8);
+  }
+  EXPECT_THROW(LowRank{Matrix{}}, std::invalid_argument);
+}
+
+TEST(LowRank, CompressionKeepsAccuracyBudget) {
+  Dataset dataset = RandomDataset(100, 16, 4);
+  MLP mlp{Topology{16, 32, 32, 4}};
+  EXPECT_THROW(mlp.CompressLowRank(0.1), std::invalid_argument);
+  mlp.SetTestDataset(dataset);
+  mlp.Test();
+  const double accuracy = mlp.GetMetrics().GetAccuracy();
+
+  std::vector<std::size_t> ranks = mlp.CompressLowRank(0.05);
+  mlp.Test();
+  EXPECT_GE(mlp.GetMetrics().GetAccuracy(), accuracy - 0.05 - kTolerance);
+  const std::vector<std::size_t> max_ranks = {10, 15, 3};
+  for (std::size_t i = 0; i < ranks.size(); ++i) {
+    EXPECT_LE(ranks[i], max_ranks[i]);
+  }
+
+  // Any rank meets a full budget, so the smallest one is chosen
+  MLP loose{Topology{16, 32, 32, 4}};
+  loose.SetTestDataset(dataset);
+  EXPECT_EQ(loose.CompressLowRank(1.0), std::vector<std::size_t>(3, 1));
+
+  mlp.SetType(Config::ModelType::kGraph);
+  EXPECT_THROW(mlp.CompressLowRank(0.1), std::runtime_error);
+}
+
+TEST(LowRank, SaveLoadKeepsFactors) {
+  const std::string path = "low_rank_test.bin";
+  Dataset dataset = RandomDataset(100, 16, 4);
+  MLP saved{Topology{16, 32, 4}};
+  saved.SetTestDataset(dataset);
+  const std::vector<std::size_t> ranks = saved.CompressLowRank(1.0);
+  saved.Save(path);
+  {
+    // Factored layers are stored as their factors only
+    const ModelFile file{path};
+    EXPECT_GT(ranks[0], 0u);
+    for (std::size_t i = 0; i < ranks.size(); ++i) {
+      EXPECT_EQ(file.GetRank(i), ranks[i]);
+      EXPECT_EQ(file.GetWeights(i) == nullptr, ranks[i] > 0);
+    }
+  }
+  {
+    // A mapped network hands out the factors of its file
+    const MatrixMlp mapped{std::make_shared<const ModelFile>(path)};
+    const std::vector<Factorization> factorizations =
+        mapped.GetFactorizations();
+    ASSERT_EQ(factorizations.size(), ranks.size());
+    for (std::size_t i = 0; i < ranks.size(); ++i) {
+      EXPECT_EQ(factorizations[i].GetRank(), ranks[i]);
+    }
+  }
+
+  MLP loaded{Topology{16, 4}};
+  loaded.Load(path);
+  std::remove(path.c_str());
+  EXPECT_LT(MaxDifference(loaded.GetMlp().first, saved.GetMlp().first),
+            kTolerance);
+  for (const Image& image : dataset) {
+    Vector output1 = saved.Predict(image.GetPixels());
+    Vector output2 = loaded.Predict(image.GetPixels());
+    for (std::size_t j = 0; j < output1.size(); ++j) {
+      EXPECT_NEAR(output1[j], output2[j], kTolerance);
+    }
+  }
+
+  // Training makes the layers dense again
+  loaded.SetTrainDataset(dataset);
+  loaded.SetEpochs(1);
+  loaded.Train();
+  loaded.Save(path);
+  MLP dense{Topology{16, 4}};
+  dense.Load(path);
+  std::remove(path.c_str());
+  EXPECT_LT(MaxDifference(dense.GetMlp().first, loaded.GetMlp().first),
+            kTolerance);
+}
+
+TEST(LowRank, ParallelTrainingRunsOnDenseWeights) {
+  Dataset dataset = RandomDataset(64, 16, 4);
+  for (auto type : {Config::TrainType::kTrain, Config::TrainType::kHogwild}) {
+    MLP mlp{Topology{16, 32, 4}};
+    mlp.SetTestDataset(dataset);
+    mlp.CompressLowRank(1.0);
+    mlp.SetTrainDataset(dataset);
+    mlp.SetTrainType(type);
+    mlp.SetThreads(4);
+    mlp.SetBatchSize(8);
+    mlp.SetEpochs(2);
+    mlp.Train();
+
+    // The forward pass runs on the trained weights, not on stale factors
+    MLP dense{Topology{16, 4}};
+    const auto [weights, biases] = mlp.GetMlp();
+    dense.UpdateMlp(weights, biases);
+    for (const Image& image : dataset) {
+      EXPECT_EQ(mlp.Predict(image.GetPixels()),
+                dense.Predict(image.GetPixels()));
+    }
+  }
+}
+
+TEST(LrSchedule, FollowsSchedules) {
+  Config config;
+  config.SetLearningRate(0.1);
+  config.SetEpochs(4);
+  config.SetScheduleStep(2);
+  config.SetDecay(0.5);
+
+  config.SetSchedule(Config::Schedule::kStep);
+  LrSchedule step(config);
+  std::vector<double> rates;
+  for (int i = 0; i < 4; ++i, step.Step(1.0)) rates.push_back(step.GetRate());
+  EXPECT_EQ(rates, (std::vector<double>{0.1, 0.1, 0.05, 0.05}));
+
+  config.SetSchedule(Config::Schedule::kCosine);
+  LrSchedule cosine(config);
+  for (int i = 0; i < 2; ++i) cosine.Step(1.0);
+  EXPECT_NEAR(cosine.GetRate(), 0.05, kTolerance);
+  for (int i = 0; i < 2; ++i) cosine.Step(1.0);
+  EXPECT_NEAR(cosine.GetRate(), 0.0, kTolerance);
+
+  config.SetSchedule(Config::Schedule::kPlateau);
+  LrSchedule plateau(config);
+  plateau.Step(1.0);
+  plateau.Step(0.5);
+  plateau.Step(0.6);
+  EXPECT_DOUBLE_EQ(plateau.GetRate(), 0.1);
+  plateau.Step(0.5);
+  EXPECT_DOUBLE_EQ(plateau.GetRate(), 0.05);
+}
+
+TEST(MLP, EarlyStoppingReportsSavedEpochs) {
+  MLP mlp{Topology{16, 8, 4}};
+  mlp.SetTrainDataset(RandomDataset(200, 16, 4));
+  mlp.SetLearningRate(0.0);
+  mlp.SetEpochs(10);
+  mlp.SetValidationSplit(0.25);
+  mlp.SetPatience(2);
+  std::vector<Metrics> reports;
+  mlp.SetMFunc([&reports](Metrics metrics) { reports.push_back(metrics); });
+  mlp.Train();
+
+  // Nothing improves after the first epoch
+  ASSERT_EQ(reports.size(), 3u);
+  EXPECT_EQ(reports[1].GetEpochsSaved(), 0u);
+  EXPECT_EQ(reports.back().GetEpochsSaved(), 7u);
+  EXPECT_GT(reports.back().GetLoss(), 0.0);
+  EXPECT_EQ(mlp.GetMetrics().GetEpochsSaved(), 7u);
+  EXPECT_GT(mlp.GetMetrics().GetValidationLoss(), 0.0);
+  EXPECT_EQ(mlp.GetTrainDatasetSize(), 200u);
+}
+
+TEST(MLP, ValidationKeepsBestWeights) {
+  MLP mlp{Topology{16, 8, 4}};
+  mlp.SetTrainDataset(RandomDataset(200, 16, 4));
+  mlp.SetLearningRate(2.0);
+  mlp.SetEpochs(6);
+  mlp.SetValidationSplit(0.3);
+  mlp.SetSchedule(Config::Schedule::kCosine);
+  std::vector<double> losses;
+  std::vector<Tensor> weights;
+  mlp.SetMFunc([&](Metrics metrics) {
+    losses.push_back(metrics.GetValidationLoss());
+    weights.push_back(mlp.GetMlp().first);
+  });
+  mlp.Train();
+
+  ASSERT_EQ(losses.size(), 6u);
+  EXPECT_EQ(mlp.GetMetrics().GetEpochsSaved(), 0u);
+  std::size_t best = std::min_element(losses.begin(), losses.end()) -
+                     losses.begin();
+  EXPECT_LT(MaxDifference(mlp.GetMlp().first, weights[best]), kTolerance);
+}
+
+TEST(Net2Net, GrowingKeepsFunction) {
+  Dataset dataset = RandomDataset(100, 16, 4);
+  for (auto type : {Config::ModelType::kMatrix, Config::ModelType::kGraph}) {
+    for (Activation hidden : {Activation::kSigmoid, Activation::kTanh}) {
+      MLP mlp{Topology{16, 8, 4}};
+      mlp.SetType(type);
+      mlp.SetHiddenActivation(hidden);
+      Matrix expected;
+      for (const Image& image : dataset) {
+        expected.push_back(mlp.Predict(image.GetPixels()));
+      }
+
+      mlp.Widen(1, 12);
+      mlp.Deepen(1);
+      mlp.Deepen(0);
+      const std::size_t width = hidden == Activation::kTanh ? 24 : 12;
+      EXPECT_EQ(mlp.GetTopology().GetLayersCount(), 5u);
+      EXPECT_EQ(mlp.GetTopology().GetLayerSize(1), 32u);
+      EXPECT_EQ(mlp.GetTopology().GetLayerSize(2), 12u);
+      EXPECT_EQ(mlp.GetTopology().GetLayerSize(3), width);
+      EXPECT_EQ(mlp.GetType(), type);
+      for (std::size_t i = 0; i < dataset.size(); ++i) {
+        Vector output = mlp.Predict(dataset[i].GetPixels());
+        for (std::size_t j = 0; j < output.size(); ++j) {
+          EXPECT_NEAR(output[j], expected[i][j], kTolerance);
+        }
+      }
+    }
+  }
+}
+
+TEST(Net2Net, GrowTopologyContinuesTraining) {
+  Dataset dataset = RandomDataset(100, 16, 4);
+  MLP mlp{Topology{16, 8, 4}};
+  mlp.SetTrainDataset(dataset);
+  mlp.SetTestDataset(dataset);
+  mlp.SetEpochs(3);
+  mlp.Train();
+  mlp.Test();
+  const double loss = mlp.GetMetrics().GetLoss();
+
+  mlp.UpdateTopology(2, 10, true);
+  EXPECT_EQ(mlp.GetTopology().GetHiddenCount(), 2u);
+  EXPECT_EQ(mlp.GetTopology().GetLayerSize(1), 10u);
+  EXPECT_EQ(mlp.GetTopology().GetLayerSize(2), 10u);
+  mlp.Test();
+  EXPECT_NEAR(mlp.GetMetrics().GetLoss(), loss, kTolerance);
+  mlp.Train();
+
+  EXPECT_THROW(mlp.UpdateTopology(1, 10, true), std::invalid_argument);
+  EXPECT_THROW(mlp.UpdateTopology(2, 4, true), std::invalid_argument);
+  EXPECT_THROW(mlp.Widen(0, 20), std::invalid_argument);
+  EXPECT_THROW(mlp.Deepen(3), std::invalid_argument);
+
+  // The second layer can't shrink, so the first one isn't widened either
+  mlp.Widen(2, 12);
+  const Tensor weights = mlp.GetMlp().first;
+  EXPECT_THROW(mlp.UpdateTopology(2, 11, true), std::invalid_argument);
+  EXPECT_EQ(mlp.GetTopology().GetLayerSize(1), 10u);
+  EXPECT_EQ(mlp.GetMlp().first, weights);
+}
+
+TEST(ReplayBuffer, KeepsUniformSample) {
+  ReplayBuffer buffer(100, 3);
+  for (std::size_t i = 0; i < 1000; ++i) {
+    buffer.Add(Image(Image::Pixels{static_cast<double>(i)}));
+  }
+  EXPECT_EQ(buffer.GetSize(), 100u);
+  EXPECT_EQ(buffer.GetSeen(), 1000u);
+
+  Dataset sample;
+  buffer.Sample(10000, sample);
+  ASSERT_EQ(sample.size(), 10000u);
+  std::size_t early = 0;
+  for (const Image& image : sample) early += image.GetPixels()[0] < 500.0;
+  EXPECT_NEAR(early / 10000.0, 0.5, 0.15);
+
+  buffer.SetCapacity(10);
+  EXPECT_EQ(buffer.GetSize(), 10u);
+  buffer.Clear();
+  sample.clear();
+  buffer.Sample(5, sample);
+  EXPECT_TRUE(sample.empty());
+}
+
+TEST(MLP, OnlineLearningReducesLoss) {
+  Dataset dataset = RandomDataset(100, 16, 4);
+  for (std::size_t batch : {1, 8}) {
+    MLP mlp{Topology{16, 12, 4}};
+    mlp.SetReplayCapacity(32);
+    mlp.SetReplayRatio(2.0);
+    mlp.SetBatchSize(batch);
+    mlp.SetLearningRate(batch == 1 ? 0.1 : 0.5);
+    double first = 0.0, last = 0.0;
+    for (std::size_t round = 0; round < 20; ++round) {
+      double loss = 0.0;
+      for (std::size_t i = 0; i < dataset.size(); i += 4) {
+        loss += mlp.Learn(Dataset(dataset.begin() + i,
+                                  dataset.begin() + i + 4));
+      }
+      if (round == 0) first = loss;
+      last = loss;
+    }
+    EXPECT_LT(last, first);
+
+    const OnlineStats& stats = mlp.GetOnlineStats();
+    EXPECT_EQ(stats.steps, 500u);
+    EXPECT_EQ(stats.samples, 2000u);
+    EXPECT_GE(stats.replayed, 3990u);
+    EXPECT_GT(stats.GetThroughput(), 0.0);
+    EXPECT_GE(stats.max_latency, stats.GetAverageLatency());
+    EXPECT_EQ(mlp.GetReplaySize(), 32u);
+    EXPECT_DOUBLE_EQ(mlp.Learn(Dataset{}), 0.0);
+
+    mlp.ResetOnline();
+    EXPECT_EQ(mlp.GetReplaySize(), 0u);
+    EXPECT_EQ(mlp.GetOnlineStats().steps, 0u);
+  }
+}
+
+TEST(MLP, OnlineStepOrderFollowsTheSeed) {
+  const Dataset dataset = RandomDataset(64, 16, 4);
+  auto learn = [&dataset](const Tensor& weights, const Tensor& biases,
+                          unsigned seed) {
+    MLP mlp{Topology{16, 12, 4}};
+    mlp.UpdateMlp(weights, biases);
+    mlp.SetReplayRatio(0.0);
+    mlp.SetBatchSize(4);
+    mlp.SetLearningRate(0.5);
+    mlp.SetSeed(seed);
+    for (std::size_t i = 0; i < dataset.size(); i += 16) {
+      mlp.Learn(Dataset(dataset.begin() + i, dataset.begin() + i + 16));
+    }
+    return mlp.GetMlp().first;
+  };
+  const auto [weights, biases] = MLP{Topology{16, 12, 4}}.GetMlp();
+  EXPECT_EQ(learn(weights, biases, 3), learn(weights, biases, 3));
+  EXPECT_NE(learn(weights, biases, 3), learn(weights, biases, 4));
+}
+
+TEST(MLP, AsyncValidationReportsSnapshots) {
+  Dataset dataset = RandomDataset(100, 16, 4);
+  MLP mlp{Topology{16, 12, 4}};
+  mlp.SetTrainDataset(dataset);
+  mlp.SetTestDataset(dataset);
+  mlp.SetEpochs(4);
+  mlp.SetAsyncValidation(2);
+  std::vector<Metrics> validations;
+  std::size_t train_reports = 0;
+  mlp.SetMFunc([&](Metrics metrics) {
+    if (metrics.GetSnapshotEpoch()) {
+      validations.push_back(metrics);
+    } else {
+      ++train_reports;
+    }
+  });
+  mlp.Train();
+
+  EXPECT_EQ(train_reports, 4u);
+  ASSERT_EQ(validations.size(), 2u);
+  EXPECT_EQ(validations[0].GetSnapshotEpoch(), 2u);
+  EXPECT_EQ(validations[1].GetSnapshotEpoch(), 4u);
+
+  // The last snapshot holds the final weights
+  mlp.SetMFunc([](Metrics) {});
+  mlp.Test();
+  EXPECT_NEAR(validations[1].GetAccuracy(), mlp.GetMetrics().GetAccuracy(),
+              kTolerance);
+  EXPECT_NEAR(validations[1].GetLoss(), mlp.GetMetrics().GetLoss(),
+              kTolerance);
+}
+
+TEST(LrRange, RecommendsSteepestDescent) {
+  LrRange range;
+  const std::vector<double> losses = {1.0, 0.99, 0.9, 0.5, 0.4, 0.45, 2.0};
+  for (std::size_t i = 0; i < losses.size(); ++i) {
+    range.Add(std::pow(10.0, i) * 1e-4, losses[i], 0.0);
+  }
+  EXPECT_EQ(range.smoothed, losses);
+  EXPECT_DOUBLE_EQ(range.Recommend(), 1e-1);
+
+  std::string csv = range.ToCsv();
+  EXPECT_EQ(csv.substr(0, csv.find('\n')), "rate,loss,smoothed_loss");
+  EXPECT_EQ(std::count(csv.begin(), csv.end(), '\n'), 8);
+
+  EXPECT_THROW(range.Add(1.0, 1.0, 1.0), std::invalid_argument);
+  EXPECT_THROW(range.Add(1.0, 1.0, -0.1), std::invalid_argument);
+}
+
+TEST(MLP, FindLearningRateKeepsWeights) {
+  for (std::size_t batch : {1, 16}) {
+    MLP mlp{Topology{16, 12, 4}};
+    EXPECT_THROW(mlp.FindLearningRate(), std::runtime_error);
+    mlp.SetTrainDataset(RandomDataset(100, 16, 4));
+    mlp.SetBatchSize(batch);
+    const Tensor weights = mlp.GetMlp().first;
+
+    LrRangeOptions options;
+    options.steps = 50;
+    options.min_rate = 1e-4;
+    options.max_rate = 100.0;
+    LrRange range = mlp.FindLearningRate(options);
+    EXPECT_LT(MaxDifference(mlp.GetMlp().first, weights), kTolerance);
+    ASSERT_GE(range.rates.size(), 2u);
+    EXPECT_LE(range.rates.size(), 50u);
+    EXPECT_DOUBLE_EQ(range.rates[0], 1e-4);
+    EXPECT_GT(range.recommended, 0.0);
+    EXPECT_LE(range.recommended, 100.0);
+
+    // A test that fails halfway leaves the weights as they were too
+    options.smoothing = 1.0;
+    EXPECT_THROW(mlp.FindLearningRate(options), std::invalid_argument);
+    EXPECT_LT(MaxDifference(mlp.GetMlp().first, weights), kTolerance);
+
+    options.smoothing = 0.98;
+    options.max_rate = options.min_rate;
+    EXPECT_THROW(mlp.FindLearningRate(options), std::invalid_argument);
+  }
+}
+
+TEST(ImportanceSampler, CorrectsSamplingBias) {
+  ImportanceSampler sampler{4, 0.2, 7};
+  const Vector values = {1.0, 2.0, 3.0, 4.0};
+  for (std::size_t i = 0; i < values.size(); ++i) sampler.Update(i, values[i]);
+
+  std::vector<std::size_t> indices = sampler.Draw(40000);
+  std::vector<std::size_t> counts(4);
+  double weighted = 0.0;
+  for (std::size_t idx : indices) {
+    ++counts[idx];
+    weighted += sampler.GetWeight(idx) * values[idx];
+    EXPECT_LE(sampler.GetWeight(idx), 1.0 / 0.2);
+  }
+  // p = 0.8 * loss / 10 + 0.05
+  EXPECT_NEAR(counts[0] / 40000.0, 0.13, 0.01);
+  EXPECT_NEAR(counts[3] / 40000.0, 0.37, 0.01);
+  EXPECT_NEAR(weighted / 40000.0, 2.5, 0.05);
+  EXPECT_DOUBLE_EQ(sampler.GetWeight(0), 1.0 / (4 * 0.13));
+  EXPECT_TRUE(ImportanceSampler(0).Draw(3).empty());
+}
+
+TEST(MatrixMlp, WeightedGradientsScaleErrors) {
+  MatrixMlp mlp{Topology{16, 8, 4}};
+  Dataset dataset = RandomDataset(3, 16, 4);
+  Labels labels;
+  Tensor values(1);
+  for (const Image& image : dataset) {
+    values[0].push_back(image.GetPixels());
+    labels.push_back(image.GetLabel());
+  }
+  Checkpoints checkpoints(3, true);
+  Tensor grads1 = mlp.GetWeights(), grads2 = mlp.GetWeights();
+  Tensor bias_grads1 = mlp.GetBiases(), bias_grads2 = mlp.GetBiases();
+  for (Tensor* tensor : {&grads1, &grads2, &bias_grads1, &bias_grads2}) {
+    for (Matrix& matrix : *tensor) {
+      for (Vector& row : matrix) std::fill(row.begin(), row.end(), 0.0);
+    }
+  }
+
+  mlp.ForwardPropagation(values, checkpoints);
+  double loss = mlp.ComputeGradients(values, checkpoints, labels, grads1,
+                                     bias_grads1);
+  const Vector scales(3, 2.0);
+  Vector losses;
+  double weighted = mlp.ComputeGradients(values, checkpoints, labels, grads2,
+                                         bias_grads2, &scales, &losses);
+  for (Matrix& matrix : grads1) {
+    for (Vector& row : matrix) {
+      for (double& value : row) value *= 2.0;
+    }
+  }
+
+  EXPECT_NEAR(loss, weighted, kTolerance);
+  ASSERT_EQ(losses.size(), 3u);
+  EXPECT_NEAR(losses[0] + losses[1] + losses[2], loss, kTolerance);
+  EXPECT_LT(MaxDifference(grads1, grads2), kTolerance);
+}
+
+TEST(MLP, ImportanceSamplingTrains) {
+  for (std::size_t batch : {1, 16}) {
+    MLP mlp{Topology{16, 12, 4}};
+    mlp.SetTrainDataset(RandomDataset(100, 16, 4));
+    mlp.SetBatchSize(batch);
+    mlp.SetLearningRate(batch == 1 ? 0.1 : 0.5);
+    mlp.SetEpochs(10);
+    mlp.SetImportanceSampling(true);
+    std::vector<double> losses;
+    mlp.SetMFunc([&losses](Metrics metrics) {
+      losses.push_back(metrics.GetLoss());
+    });
+    mlp.Train();
+
+    ASSERT_EQ(losses.size(), 10u);
+    EXPECT_LT(losses.back(), losses.front());
+    EXPECT_EQ(mlp.GetTrainDatasetSize(), 100u);
+  }
+}
+
+TEST(MLP, ImportanceSamplingLeavesOtherTrainersShuffled) {
+  const Dataset dataset = RandomDataset(64, 16, 4);
+  MLP sampled{Topology{16, 12, 4}}, plain{Topology{16, 12, 4}};
+  const auto [weights, biases] = sampled.GetMlp();
+  plain.UpdateMlp(weights, biases);
+  for (MLP* mlp : {&sampled, &plain}) {
+    mlp->SetTrainDataset(dataset);
+    mlp->SetBatchSize(8);
+    mlp->SetPrecision(Config::Precision::kMixed);
+    mlp->SetEpochs(3);
+    mlp->SetSeed(5);
+  }
+  sampled.SetImportanceSampling(true);
+  sampled.Train();
+  plain.Train();
+  EXPECT_EQ(sampled.GetMlp().first, plain.GetMlp().first);
+}
+
+TEST(FoldSummary, MergesMeanAndDeviation) {
+  Metrics right{4}, wrong{4};
+  right.AddPrediction(1, 1);
+  wrong.AddPrediction(2, 1);
+  FoldSummary summary({right, wrong, right});
+
+  EXPECT_EQ(summary.folds.size(), 3u);
+  EXPECT_NEAR(summary.accuracy.mean, 2.0 / 3.0, kTolerance);
+  EXPECT_NEAR(summary.accuracy.stddev, std::sqrt(1.0 / 3.0), kTolerance);
+  EXPECT_DOUBLE_EQ(FoldSummary({right}).accuracy.stddev, 0.0);
+}
+
+TEST(MLP, CrossValidationTrainsFoldReplicas) {
+  for (std::size_t batch : {1, 16}) {
+    MLP mlp{Topology{16, 12, 4}};
+    mlp.SetTrainDataset(RandomDataset(200, 16, 4));
+    mlp.SetTrainType(Config::TrainType::kCrossValidation);
+    mlp.SetKFolds(4);
+    mlp.SetEpochs(3);
+    mlp.SetBatchSize(batch);
+    const Tensor weights = mlp.GetMlp().first;
+    std::vector<double> accuracies;
+    double progress = 0.0;
+    mlp.SetMFunc([&accuracies](Metrics metrics) {
+      accuracies.push_back(metrics.GetAccuracy());
+    });
+    mlp.SetFPFunc([&progress](double value) { progress = value; });
+    mlp.Train();
+
+    const FoldSummary& summary = mlp.GetFoldSummary();
+    ASSERT_EQ(accuracies.size(), 4u);
+    ASSERT_EQ(summary.folds.size(), 4u);
+    EXPECT_NEAR(summary.accuracy.mean,
+                std::accumulate(accuracies.begin(), accuracies.end(), 0.0) / 4,
+                kTolerance);
+    EXPECT_GE(summary.accuracy.stddev, 0.0);
+    EXPECT_GT(summary.loss.mean, 0.0);
+    EXPECT_DOUBLE_EQ(progress, 100.0);
+    EXPECT_DOUBLE_EQ(mlp.GetMetrics().GetAccuracy(),
+                     *std::max_element(accuracies.begin(), accuracies.end()));
+    EXPECT_GT(MaxDifference(mlp.GetMlp().first, weights), 0.0);
+    EXPECT_EQ(mlp.GetTrainDatasetSize(), 200u);
+
+    mlp.SetKFolds(1);
+    EXPECT_THROW(mlp.Train(), std::invalid_argument);
+  }
+}
+
+TEST(Sweep, HalvingPrunesWeakTrials) {
+  const Dataset train = RandomDataset(100, 16, 4);
+  const Dataset validation = RandomDataset(40, 16, 4);
+  SweepSpace space;
+  space.learning_rates = {0.0, 0.5, 1.0};
+  space.hidden_sizes = {8, 12};
+  space.hidden_counts = {1};
+  space.epochs = {9};
+  space.batch_sizes = {1, 16};
+  for (std::size_t threads : {1, 4}) {
+    SweepOptions options;
+    options.threads = threads;
+    Sweep sweep{Topology{16, 8, 4}, Config{}, space, options};
+    std::size_t rungs = 0;
+    const Leaderboard leaderboard =
+        sweep.Run(train, validation, [&rungs](const SweepTrial&) { ++rungs; });
+
+    ASSERT_EQ(leaderboard.trials.size(), 12u);
+    const SweepTrial& best = leaderboard.trials.front();
+    EXPECT_FALSE(best.pruned);
+    EXPECT_EQ(best.trained_epochs, 9u);
+    EXPECT_GT(best.learning_rate, 0.0);
+    std::size_t pruned = 0;
+    for (const SweepTrial& trial : leaderboard.trials) {
+      pruned += trial.pruned;
+      EXPECT_TRUE(trial.trained_epochs == 1 or trial.trained_epochs == 3 or
+                  trial.trained_epochs == 9);
+      EXPECT_GE(trial.accuracy, 0.0);
+      EXPECT_LE(trial.accuracy, 1.0);
+      ASSERT_FALSE(trial.rung_losses.empty());
+      EXPECT_DOUBLE_EQ(trial.rung_losses.back(), trial.loss);
+    }
+    EXPECT_GE(pruned, 6u);
+    EXPECT_GT(rungs, 12u);
+
+    const std::string csv = leaderboard.ToCsv();
+    EXPECT_EQ(std::count(csv.begin(), csv.end(), '\n'), 13);
+    EXPECT_EQ(csv.substr(0, 8), "rank,id,");
+    const std::string json = leaderboard.ToJson();
+    EXPECT_EQ(json.front(), '[');
+    EXPECT_NE(json.find("\"pruned\": true"), std::string::npos);
+  }
+}
+
+TEST(Sweep, RandomSearchIsReproducible) {
+  SweepSpace space;
+  space.learning_rates = {0.01, 1.0};
+  space.hidden_sizes = {8};
+  space.hidden_counts = {1, 2};
+  space.epochs = {2};
+  SweepOptions options;
+  options.search = SweepOptions::Search::kRandom;
+  options.trials = 5;
+  options.reduction = 1;
+  Sweep sweep1{Topology{16, 8, 4}, Config{}, space, options};
+  Sweep sweep2{Topology{16, 8, 4}, Config{}, space, options};
+  const Dataset train = RandomDataset(100, 16, 4);
+  const Leaderboard leaderboard = sweep1.Run(train, train);
+  sweep2.Run(train, train);
+
+  ASSERT_EQ(leaderboard.trials.size(), 5u);
+  for (std::size_t i = 0; i < 5; ++i) {
+    const SweepTrial& trial = sweep1.GetTrials()[i];
+    EXPECT_FALSE(trial.pruned);
+    EXPECT_EQ(trial.trained_epochs, 2u);
+    EXPECT_GE(trial.learning_rate, 0.01);
+    EXPECT_LE(trial.learning_rate, 1.0);
+    EXPECT_DOUBLE_EQ(trial.learning_rate,
+                     sweep2.GetTrials()[i].learning_rate);
+    EXPECT_DOUBLE_EQ(trial.loss, sweep2.GetTrials()[i].loss);
+  }
+  EXPECT_THROW(sweep1.Run(Dataset{}, train), std::runtime_error);
+  space.learning_rates = {0.0, 1.0};
+  EXPECT_THROW(Sweep(Topology{16, 8, 4}, Config{}, space, options)
+                   .Run(train, train),
+               std::invalid_argument);
+  space.batch_sizes.clear();
+  EXPECT_THROW(Sweep(Topology{16, 8, 4}, Config{}, space, options),
+               std::invalid_argument);
+}
+
+TEST(Evaluator, ShardsMatchSingleThread) {
+  MatrixMlp mlp{Topology{16, 12, 4}};
+  const Topology topology{16, 12, 4};
+  const Dataset dataset = RandomDataset(601, 16, 4);
+  std::vector<std::size_t> indices(dataset.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  Metrics expected{4};
+  Evaluator(1).Evaluate(mlp, topology, dataset, indices, expected);
+
+  for (std::size_t threads : {3, 8}) {
+    Metrics metrics{4};
+    std::vector<int> progress;
+    Evaluator(threads).Evaluate(mlp, topology, dataset, indices, metrics,
+                                [&progress](int value) {
+                                  progress.push_back(value);
+                                });
+    EXPECT_NEAR(metrics.GetLoss(), expected.GetLoss(), kTolerance);
+    EXPECT_DOUBLE_EQ(metrics.GetAccuracy(), expected.GetAccuracy());
+    EXPECT_DOUBLE_EQ(metrics.GetF1Score(), expected.GetF1Score());
+    ASSERT_EQ(progress.size(), threads);
+    EXPECT_EQ(progress.back(), 100);
+  }
+
+  Metrics empty{4};
+  EXPECT_NO_THROW(Evaluator(4).Evaluate(mlp, topology, dataset, {}, empty));
+}
+
+TEST(MLP, TestMatchesPerImagePredictions) {
+  for (auto type : {Config::ModelType::kMatrix, Config::ModelType::kGraph}) {
+    MLP mlp{Topology{16, 12, 4}};
+    mlp.SetType(type);
+    const Dataset dataset = RandomDataset(50, 16, 4);
+    mlp.SetTestDataset(dataset);
+    Metrics expected{4};
+    expected.StartMeasure(dataset.size());
+    for (const Image& image : dataset) {
+      expected.AddLoss(mlp.Predict(image.GetPixels()), image.GetLabel());
+      expected.AddPrediction(mlp.PredictLabel(image), image.GetLabel());
+    }
+    mlp.Test();
+
+    EXPECT_NEAR(mlp.GetMetrics().GetLoss(), expected.GetLoss(), kTolerance);
+    EXPECT_DOUBLE_EQ(mlp.GetMetrics().GetAccuracy(), expected.GetAccuracy());
+  }
+}
+
+TEST(EventChannel, CoalescesProgressAndKeepsMetrics) {
+  EventChannel channel{4};
+  for (int i = 0; i <= 100; ++i) {
+    channel.PublishProgress(Event::Type::kProgress, i);
+  }
+  EXPECT_EQ(channel.GetDropped(), 97u);
+  Metrics metrics{4};
+  for (std::size_t epoch = 1; epoch <= 6; ++epoch) {
+    metrics.SetSnapshotEpoch(epoch);
+    channel.PublishMetrics(metrics);
+  }
+
+  // The metrics that didn't fit in the ring come from the spill, in order
+  std::vector<Event> events;
+  channel.Drain([&events](const Event& event) { events.push_back(event); });
+  ASSERT_EQ(events.size(), 7u);
+  for (std::size_t i = 0; i < 6; ++i) {
+    EXPECT_EQ(events[i].metrics->GetSnapshotEpoch(), i + 1);
+  }
+  EXPECT_EQ(events[6].type, Event::Type::kProgress);
+  EXPECT_DOUBLE_EQ(events[6].value, 3.0);
+
+  channel.PublishMetrics(metrics);
+  channel.PublishProgress(Event::Type::kFullProgress, 50.0);
+  std::ostringstream log;
+  EXPECT_EQ(ExportEvents(channel, log), 2u);
+  const std::string text = log.str();
+  EXPECT_EQ(std::count(text.begin(), text.end(), '\n'), 2);
+  EXPECT_NE(text.find("metrics,"), std::string::npos);
+  EXPECT_NE(text.find("full_progress,50"), std::string::npos);
+}
+
+TEST(EventChannel, DeliversAcrossThreads) {
+  EventChannel channel{16};
+  std::atomic<bool> done{false};
+  std::thread producer([&] {
+    Metrics metrics{4};
+    for (int i = 1; i <= 1000; ++i) {
+      channel.PublishProgress(Event::Type::kProgress, i / 10);
+      if (i % 50 == 0) channel.PublishMetrics(metrics);
+    }
+    done = true;
+  });
+  std::size_t metrics = 0;
+  double last = 0.0;
+  auto drain = [&](const Event& event) {
+    if (event.type == Event::Type::kMetrics) {
+      ++metrics;
+    } else {
+      EXPECT_GE(event.value, last);
+      last = event.value;
+    }
+  };
+  while (!done) channel.Drain(drain);
+  producer.join();
+  channel.Drain(drain);
+
+  // Progress may be dropped while the ring is full, metrics never are
+  EXPECT_EQ(metrics, 20u);
+  EXPECT_GT(last, 0.0);
+  EXPECT_LE(last, 100.0);
+}
+
+TEST(MLP, SmallDatasetsReportThroughChannel) {
+  MLP mlp{Topology{16, 8, 4}};
+  mlp.SetTrainDataset(RandomDataset(30, 16, 4));
+  mlp.SetTestDataset(RandomDataset(30, 16, 4));
+  mlp.SetEpochs(3);
+  bool called = false;
+  mlp.SetMFunc([&called](Metrics) { called = true; });
+  mlp.SetPFunc([&called](int) { called = true; });
+  auto channel = std::make_shared<EventChannel>();
+  mlp.SetEventChannel(channel);
+  mlp.Train();
+  mlp.Test();
+
+  std::size_t metrics = 0;
+  std::vector<Event> progress;
+  channel->Drain([&](const Event& event) {
+    if (event.type == Event::Type::kMetrics) {
+      ++metrics;
+    } else {
+      progress.push_back(event);
+    }
+  });
+  EXPECT_FALSE(called);
+  EXPECT_EQ(metrics, 4u);
+  ASSERT_EQ(progress.size(), 3u);
+  for (const Event& event : progress) EXPECT_DOUBLE_EQ(event.value, 100.0);
+
+  std::vector<int> percents;
+  mlp.SetEventChannel(nullptr);
+  mlp.SetPFunc([&percents](int percent) { percents.push_back(percent); });
+  mlp.SetEpochs(1);
+  mlp.Train();
+  EXPECT_EQ(percents.size(), 30u);
+  EXPECT_EQ(percents.back(), 100);
+}
+
+TEST(MLP, TrainLeavesOverflowingMetricsToTheConsumer) {
+  MLP mlp{Topology{16, 8, 4}};
+  mlp.SetTrainDataset(RandomDataset(20, 16, 4));
+  mlp.SetEpochs(6);
+  auto channel = std::make_shared<EventChannel>(2);
+  mlp.SetEventChannel(channel);
+
+  // Nothing drains during the run, which must still end
+  mlp.Train();
+  std::size_t metrics = 0;
+  channel->Drain([&metrics](const Event& event) {
+    metrics += event.type == Event::Type::kMetrics;
+  });
+  EXPECT_EQ(metrics, 6u);
+}
+
+TEST(MLP, SteadyStateEpochsDoNotAllocate) {
+  AllocationCounter::Enable(true);
+  for (auto type : {Config::ModelType::kMatrix, Config::ModelType::kGraph}) {
+    MLP mlp{Topology{16, 8, 4}};
+    mlp.SetType(type);
+    mlp.SetOptimizer(Config::OptimizerType::kMomentum);
+    mlp.SetTrainDataset(RandomDataset(30, 16, 4));
+    mlp.SetEpochs(3);
+    std::vector<std::size_t> allocations;
+    mlp.SetMFunc([&allocations](Metrics metrics) {
+      allocations.push_back(metrics.GetAllocations());
+    });
+    mlp.Train();
+    ASSERT_EQ(allocations.size(), 3u);
+    EXPECT_GT(allocations[0], 0u);
+    EXPECT_EQ(allocations[1], 0u);
+    EXPECT_EQ(allocations[2], 0u);
+  }
+  AllocationCounter::Enable(false);
+}
+
+TEST(Checkpoint, RoundTripsAndRejectsTruncatedFiles) {
+  Checkpoint checkpoint;
+  checkpoint.weights = {{{1.0, 2.0}, {3.0, 4.0}}};
+  checkpoint.biases = {{{0.5, -0.5}}};
+  checkpoint.activations = {Activation::kSoftmax};
+  checkpoint.weight_slots = {checkpoint.weights};
+  checkpoint.bias_slots = {checkpoint.biases};
+  checkpoint.optimizer_step = 12;
+  checkpoint.epoch = 3;
+  checkpoint.sample = 40;
+  checkpoint.seed = 7;
+  checkpoint.learning_rate = 0.05;
+  checkpoint.loss_scale = 1024.0;
+  checkpoint.good_steps = 9;
+  const std::string path = "checkpoint_test.bin";
+  {
+    CheckpointWriter writer{path};
+    writer.Submit(checkpoint);
+    writer.Wait();
+    EXPECT_EQ(writer.GetWritten(), 1u);
+  }
+  std::ifstream temp(path + ".tmp");
+  EXPECT_FALSE(temp.is_open());
+
+  const Checkpoint loaded = ReadCheckpoint(path);
+  EXPECT_EQ(loaded.weights, checkpoint.weights);
+  EXPECT_EQ(loaded.biases, checkpoint.biases);
+  EXPECT_EQ(loaded.activations, checkpoint.activations);
+  EXPECT_EQ(loaded.weight_slots, checkpoint.weight_slots);
+  EXPECT_EQ(loaded.bias_slots, checkpoint.bias_slots);
+  EXPECT_EQ(loaded.optimizer_step, 12u);
+  EXPECT_EQ(loaded.epoch, 3u);
+  EXPECT_EQ(loaded.sample, 40u);
+  EXPECT_EQ(loaded.seed, 7u);
+  EXPECT_DOUBLE_EQ(loaded.learning_rate, 0.05);
+  EXPECT_DOUBLE_EQ(loaded.loss_scale, 1024.0);
+  EXPECT_EQ(loaded.good_steps, 9u);
+
+  std::ifstream file(path, std::ios::binary);
+  std::string data{std::istreambuf_iterator<char>(file), {}};
+  file.close();
+  std::ofstream truncated(path, std::ios::binary | std::ios::trunc);
+  truncated.write(data.data(), data.size() - 8);
+  truncated.close();
+  EXPECT_THROW(ReadCheckpoint(path), std::runtime_error);
+  std::remove(path.c_str());
+}
+
+TEST(MLP, ResumeContinuesInterruptedRun) {
+  const Dataset dataset = RandomDataset(60, 16, 4);
+  const std::string path = "resume_test.bin";
+  auto make = [&dataset](const Tensor& weights, const Tensor& biases) {
+    auto mlp = std::make_unique<MLP>(Topology{16, 8, 4});
+    if (!weights.empty()) mlp->UpdateMlp(weights, biases);
+    mlp->SetOptimizer(Config::OptimizerType::kMomentum);
+    mlp->SetLearningRate(0.05);
+    mlp->SetTrainDataset(dataset);
+    mlp->SetEpochs(2);
+    mlp->SetSeed(7);
+    return mlp;
+  };
+
+  auto uninterrupted = make({}, {});
+  const auto [weights, biases] = uninterrupted->GetMlp();
+  uninterrupted->Train();
+
+  // Stops at sample 50 of the second epoch, after the checkpoint of
+  // sample 40
+  auto interrupted = make(weights, biases);
+  interrupted->SetCheckpoint(path, 20);
+  std::size_t reports = 0;
+  interrupted->SetPFunc([&reports](int) {
+    if (++reports == 110) throw std::runtime_error("crash");
+  });
+  EXPECT_THROW(interrupted->Train(), std::runtime_error);
+  const Checkpoint checkpoint = ReadCheckpoint(path);
+  EXPECT_EQ(checkpoint.epoch, 1u);
+  EXPECT_EQ(checkpoint.sample, 40u);
+
+  auto resumed = make({}, {});
+  resumed->Resume(path);
+  EXPECT_EQ(resumed->GetMlp().first, uninterrupted->GetMlp().first);
+  EXPECT_EQ(resumed->GetMlp().second, uninterrupted->GetMlp().second);
+  std::remove(path.c_str());
+}
+
+TEST(MLP, ResumeContinuesMixedPrecisionRun) {
+  const Dataset dataset = RandomDataset(60, 16, 4);
+  const std::string path = "resume_mixed_test.bin";
+  auto make = [&dataset](const Tensor& weights, const Tensor& biases) {
+    auto mlp = std::make_unique<MLP>(Topology{16, 8, 4});
+    if (!weights.empty()) mlp->UpdateMlp(weights, biases);
+    mlp->SetPrecision(Config::Precision::kMixed);
+    mlp->SetBatchSize(10);
+    mlp->SetTrainDataset(dataset);
+    mlp->SetEpochs(2);
+    mlp->SetSeed(7);
+    return mlp;
+  };
+
+  auto uninterrupted = make({}, {});
+  const auto [weights, biases] = uninterrupted->GetMlp();
+  uninterrupted->Train();
+
+  // Stops after the third batch of the second epoch, after the checkpoint
+  // of sample 20
+  auto interrupted = make(weights, biases);
+  interrupted->SetCheckpoint(path, 20);
+  std::size_t reports = 0;
+  interrupted->SetPFunc([&reports](int) {
+    if (++reports == 9) throw std::runtime_error("crash");
+  });
+  EXPECT_THROW(interrupted->Train(), std::runtime_error);
+  const Checkpoint checkpoint = ReadCheckpoint(path);
+  EXPECT_EQ(checkpoint.epoch, 1u);
+  EXPECT_EQ(checkpoint.sample, 20u);
+  EXPECT_GT(checkpoint.loss_scale, 0.0);
+
+  auto resumed = make({}, {});
+  resumed->Resume(path);
+  EXPECT_EQ(resumed->GetMlp().first, uninterrupted->GetMlp().first);
+  EXPECT_EQ(resumed->GetMlp().second, uninterrupted->GetMlp().second);
+  std::remove(path.c_str());
+}
+
+TEST(MLP, ResumeRefusesRunsItCantContinueExactly) {
+  const std::string path = "resume_refused_test.bin";
+  {
+    MLP mlp{Topology{16, 8, 4}};
+    mlp.SetTrainDataset(RandomDataset(40, 16, 4));
+    mlp.SetEpochs(1);
+    mlp.SetCheckpoint(path, 10);
+    mlp.Train();
+  }
+  const std::vector<std::function<void(MLP&)>> setups = {
+      [](MLP& mlp) {
+        mlp.SetType(Config::ModelType::kGraph);
+        mlp.SetOptimizer(Config::OptimizerType::kAdam);
+      },
+      [](MLP& mlp) { mlp.SetImportanceSampling(true); },
+      [](MLP& mlp) { mlp.SetSchedule(Config::Schedule::kPlateau); },
+      [](MLP& mlp) { mlp.SetValidationSplit(0.25); },
+  };
+  for (const auto& setup : setups) {
+    MLP mlp{Topology{16, 8, 4}};
+    mlp.SetTrainDataset(RandomDataset(40, 16, 4));
+    setup(mlp);
+    const Tensor weights = mlp.GetMlp().first;
+    EXPECT_THROW(mlp.Resume(path), std::runtime_error);
+    EXPECT_EQ(mlp.GetMlp().first, weights);
+  }
+  std::remove(path.c_str());
+}
+
+TEST(MLP, FailedCheckpointStillRestoresValidationSplit) {
+  MLP mlp{Topology{16, 8, 4}};
+  mlp.SetTrainDataset(RandomDataset(60, 16, 4));
+  mlp.SetEpochs(2);
+  mlp.SetValidationSplit(0.25);
+  mlp.SetCheckpoint("missing_directory/checkpoint.bin", 10);
+  EXPECT_THROW(mlp.Train(), std::runtime_error);
+  EXPECT_EQ(mlp.GetTrainDatasetSize(), 60u);
+}
+
+TEST(ModelFile, MapsAlignedBlocksAndRejectsCorruption) {
+  const std::string path = "model_file_test.bin";
+  MLP saved{Topology{16, 8, 4}};
+  saved.SetHiddenActivation(Activation::kRelu);
+  saved.Save(path);
+  {
+    const ModelFile file{path};
+    const Topology topology = file.GetTopology();
+    EXPECT_EQ(topology.GetLayersCount(), 3u);
+    EXPECT_EQ(topology.GetLayerSize(1), 8u);
+    EXPECT_EQ(file.GetActivation(0), Activation::kRelu);
+    EXPECT_EQ(file.GetActivation(1), Activation::kSigmoid);
+    EXPECT_EQ(file.GetLeft(0), nullptr);
+    const auto [weights, biases] = saved.GetMlp();
+    for (std::size_t i = 0; i < file.GetLayersCount(); ++i) {
+      for (const double* block : {file.GetWeights(i), file.GetBiases(i)}) {
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(block) %
+                      ModelFile::kAlignment,
+                  0u);
+      }
+      EXPECT_EQ(file.GetWeights(i)[file.GetCols(i) + 1], weights[i][1][1]);
+      EXPECT_EQ(file.GetBiases(i)[2], biases[i][0][2]);
+    }
+  }
+
+  std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+  file.seekp(-1, std::ios::end);
+  file.put('\x7f');
+  file.close();
+  EXPECT_THROW(ModelFile{path}, std::runtime_error);
+  std::remove(path.c_str());
+}
+
+TEST(MLP, LoadsLegacyFiles) {
+  const std::string path = "legacy_test.bin";
+  const Tensor weights{{{0.5, -0.5}, {0.25, 1.0}, {-1.0, 2.0}}};
+  const Tensor biases{{{0.1, -0.1}}};
+  {
+    std::ofstream file(path, std::ios::binary);
+    auto write = [&file](const auto& value) {
+      file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    write(std::size_t{1});
+    write(std::size_t{3});
+    write(std::size_t{2});
+    for (const Vector& row : weights[0]) {
+      for (double weight : row) write(weight);
+    }
+    for (double bias : biases[0][0]) write(bias);
+    write(static_cast<std::int32_t>(Activation::kSoftmax));
+  }
+  EXPECT_FALSE(ModelFile::IsModelFile(path));
+
+  MLP loaded{Topology{16, 4}};
+  loaded.Load(path);
+  std::remove(path.c_str());
+  EXPECT_EQ(loaded.GetMlp().first, weights);
+  EXPECT_EQ(loaded.GetMlp().second, biases);
+  EXPECT_EQ(loaded.GetTopology().GetActivations(),
+            std::vector<Activation>{Activation::kSoftmax});
+}
+
+TEST(MLP, MappedNetworkPredictsLikeLoadedOne) {
+  const std::string path = "mapped_test.bin";
+  const Dataset dataset = RandomDataset(50, 16, 4);
+  MLP saved{Topology{16, 32, 8, 4}};
+  saved.SetTestDataset(dataset);
+  saved.CompressLowRank(1.0);
+  saved.Save(path);
+
+  MLP loaded{Topology{16, 4}};
+  loaded.Load(path);
+  MLP mapped{Topology{16, 4}};
+  mapped.Map(path);
+  // Saving over the file replaces it, so the mapping keeps the old weights
+  MLP{Topology{16, 8, 4}}.Save(path);
+
+  EXPECT_EQ(mapped.GetTopology().GetLayersCount(), 4u);
+  EXPECT_EQ(mapped.GetMlp().first, loaded.GetMlp().first);
+  for (const Image& image : dataset) {
+    EXPECT_EQ(mapped.Predict(image.GetPixels()),
+              loaded.Predict(image.GetPixels()));
+  }
+  loaded.SetTestDataset(dataset);
+  loaded.Test();
+  mapped.SetTestDataset(dataset);
+  mapped.Test();
+  EXPECT_EQ(mapped.GetMetrics().GetAccuracy(),
+            loaded.GetMetrics().GetAccuracy());
+
+  mapped.SetTrainDataset(dataset);
+  EXPECT_THROW(mapped.Train(), std::logic_error);
+  mapped.Load(path);
+  EXPECT_NO_THROW(mapped.Train());
+  std::remove(path.c_str());
+}
+
+TEST(InferenceServer, AnswersSocketRequestsInDynamicBatches) {
+  const Topology topology{16, 8, 4};
+  MatrixMlp mlp{topology};
+  ServerOptions options;
+  options.socket_path = "server_test.sock";
+  options.max_delay = std::chrono::milliseconds(100);
+  InferenceServer server{mlp, topology, options};
+  EXPECT_THROW(server.Submit(Matrix(1, Vector(16))), std::logic_error);
+  server.Start();
+
+  std::vector<unsigned char> pixels(3 * 16);
+  Tensor values(1, Matrix(3, Vector(16)));
+  for (std::size_t i = 0; i < pixels.size(); ++i) {
+    pixels[i] = static_cast<unsigned char>(i * 37 % 256);
+    values[0][i / 16][i % 16] = pixels[i] / Image::kMaxPixel;
+  }
+  const Matrix inputs = values[0];
+  mlp.ForwardPropagation(values);
+
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, options.socket_path.c_str());
+  ASSERT_EQ(::connect(fd, reinterpret_cast<sockaddr*>(&address),
+                      sizeof(address)),
+            0);
+  auto read = [fd](void* data, std::size_t size) {
+    EXPECT_EQ(::recv(fd, data, size, MSG_WAITALL),
+              static_cast<ssize_t>(size));
+  };
+  std::uint32_t count = 3;
+  ::send(fd, &count, sizeof(count), 0);
+  ::send(fd, pixels.data(), pixels.size(), 0);
+  read(&count, sizeof(count));
+  EXPECT_EQ(count, 3u);
+  for (std::size_t i = 0; i < count; ++i) {
+    std::uint32_t label;
+    Vector output(4);
+    read(&label, sizeof(label));
+    read(output.data(), output.size() * sizeof(double));
+    EXPECT_EQ(output, values.back()[i]);
+    EXPECT_EQ(label, std::max_element(output.begin(), output.end()) -
+                         output.begin() + 1);
+  }
+
+  std::vector<std::future<Prediction>> futures;
+  for (std::size_t i = 0; i < 8; ++i) {
+    futures.push_back(server.Submit(Matrix{inputs[i % 3]}));
+  }
+  for (std::size_t i = 0; i < futures.size(); ++i) {
+    EXPECT_EQ(futures[i].get().outputs[0], values.back()[i % 3]);
+  }
+
+  count = 0;
+  ::send(fd, &count, sizeof(count), 0);
+  std::uint32_t length;
+  read(&count, sizeof(count));
+  read(&length, sizeof(length));
+  std::string json(length, '\0');
+  read(json.data(), length);
+  ::close(fd);
+  EXPECT_NE(json.find("\"requests\": 9"), std::string::npos);
+
+  server.Stop();
+  EXPECT_THROW(server.Submit(Matrix(1, Vector(16))), std::logic_error);
+  const ServerStats stats = server.GetStats();
+  EXPECT_EQ(stats.images, 11u);
+  EXPECT_LT(stats.batches, stats.requests);
+  EXPECT_GT(stats.p50_ms, 0.0);
+  EXPECT_GE(stats.p99_ms, stats.p50_ms);
+  EXPECT_GT(stats.images_per_second, 0.0);
+}
+
+TEST(InferenceServer, StopsWhileClientIgnoresAnswers) {
+  const Topology topology{16, 8, 4};
+  MatrixMlp mlp{topology};
+  ServerOptions options;
+  options.socket_path = "server_stop_test.sock";
+  InferenceServer server{mlp, topology, options};
+  server.Start();
+
+  // The answers of the largest request overflow the socket buffers, so the
+  // server blocks sending them to a client that never reads
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, options.socket_path.c_str());
+  ASSERT_EQ(::connect(fd, reinterpret_cast<sockaddr*>(&address),
+                      sizeof(address)),
+            0);
+  const std::uint32_t count = InferenceServer::kMaxImages;
+  std::vector<unsigned char> pixels(count * 16, 128);
+  ::send(fd, &count, sizeof(count), 0);
+  ::send(fd, pixels.data(), pixels.size(), 0);
+
+  auto stopped = std::async(std::launch::async, [&server] { server.Stop(); });
+  EXPECT_EQ(stopped.wait_for(std::chrono::seconds(10)),
+            std::future_status::ready);
+  ::close(fd);
+  stopped.wait();
+}
@@ -0,0 +1,102 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "mlp.h"
+
+using namespace s21;
+
+constexpr std::size_t kBenchmarkBatch = 256;
+constexpr std::size_t kBenchmarkRepeats = 10;
+constexpr unsigned kBenchmarkSeed = 42;
+
+double Accuracy(const SparseMlp& mlp, const Dataset& test) {
+  std::size_t correct = 0;
+  for (const Image& image : test) {
+    correct += mlp.PredictLabel(image.GetPixels()) == image.GetLabel();
+  }
+  return static_cast<double>(correct) / test.size();
+}
+
+template <typename Func>
+double Seconds(Func func) {
+  auto start = std::chrono::high_resolution_clock::now();
+  for (std::size_t i = 0; i < kBenchmarkRepeats; ++i) func();
+  std::chrono::duration<double> elapsed =
+      std::chrono::high_resolution_clock::now() - start;
+  return elapsed.count() / kBenchmarkRepeats;
+}
+
+PruneOptions ParseOptions(int argc, char** argv) {
+  PruneOptions options;
+  if (argc > 3) options.sparsity = std::stod(argv[3]);
+  if (argc > 4) {
+    std::string mode = argv[4];
+    std::size_t colon = mode.find(':');
+    if (mode == "block") {
+      options.mode = PruneOptions::Mode::kBlock;
+    } else if (colon != std::string::npos) {
+      options.mode = PruneOptions::Mode::kNM;
+      options.n = std::stoul(mode.substr(0, colon));
+      options.m = std::stoul(mode.substr(colon + 1));
+    } else if (mode != "unstructured") {
+      throw std::invalid_argument("Unknown pruning mode: " + mode);
+    }
+  }
+  return options;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cout << "Usage: " << argv[0]
+              << " <weights> <output> [sparsity] [unstructured|N:M|block]"
+                 " [fine-tune epochs]\n";
+    return 1;
+  }
+  const PruneOptions options = ParseOptions(argc, argv);
+  const std::size_t epochs = argc > 5 ? std::stoul(argv[5]) : 0;
+
+  MLP mlp{Topology{}};
+  mlp.Load(argv[1]);
+  Dataset test = ParseEmnist("../datasets/emnist-letters-test.csv");
+  std::cout << "Dense accuracy: " << Accuracy(mlp.GetSparseMlp(), test)
+            << "\n";
+
+  mlp.Prune(options);
+  std::cout << "Sparsity: " << GetSparsity(mlp.GetMlp().first)
+            << "\nPruned accuracy: " << Accuracy(mlp.GetSparseMlp(), test)
+            << "\n";
+
+  if (epochs) {
+    mlp.SetTrainDataset("../datasets/emnist-letters-train.csv");
+    mlp.SetEpochs(epochs);
+    mlp.SetLearningRate(0.01);
+    mlp.Train();
+    std::cout << "Fine-tuned accuracy: " << Accuracy(mlp.GetSparseMlp(), test)
+              << "\n";
+  }
+
+  SparseMlp sparse = mlp.GetSparseMlp();
+  sparse.Save(argv[2]);
+  std::cout << "Saved " << sparse.GetNonZeros() << " non-zero weights to "
+            << argv[2] << "\n";
+
+  // Dense random inputs: the letters are mostly blank pixels, which would
+  // skew the timings by the sparsity of the inputs instead of the weights
+  const auto [weights, biases] = mlp.GetMlp();
+  const Matrix& dense_weights = weights[0];
+  std::mt19937 gen(kBenchmarkSeed);
+  std::uniform_real_distribution<double> pixel(0.0, 1.0);
+  Matrix batch(kBenchmarkBatch, Vector(dense_weights.size()));
+  for (Vector& input : batch) {
+    for (double& value : input) value = pixel(gen);
+  }
+  Matrix output;
+  double dense_time = Seconds([&] { output = batch * dense_weights; });
+  double sparse_time =
+      Seconds([&] { MultiplySparse(batch, sparse.GetWeights(0), output); });
+  std::cout << "First layer " << dense_weights.size() << "x"
+            << dense_weights[0].size() << ", batch " << batch.size()
+            << ": dense " << dense_time << " sec, sparse " << sparse_time
+            << " sec, speedup " << dense_time / sparse_time << "x\n";
+}
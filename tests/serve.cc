@@ -0,0 +1,60 @@
+#include <csignal>
+#include <iostream>
+
+#include "mlp.h"
+
+using namespace s21;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cout << "Usage: " << argv[0]
+              << " <model> [socket path|port] [max batch] [max delay us]\n";
+    return 1;
+  }
+  ServerOptions options;
+  const std::string endpoint = argc > 2 ? argv[2] : "0";
+  if (endpoint.find_first_not_of("0123456789") == std::string::npos) {
+    options.port = static_cast<std::uint16_t>(std::stoul(endpoint));
+  } else {
+    options.socket_path = endpoint;
+  }
+  if (argc > 3) options.max_batch = std::stoul(argv[3]);
+  if (argc > 4) {
+    options.max_delay = std::chrono::microseconds(std::stol(argv[4]));
+  }
+
+  // v2 files are served straight from the mapping, legacy ones from a copy
+  std::unique_ptr<MatrixMlp> mlp;
+  Topology topology;
+  if (ModelFile::IsModelFile(argv[1])) {
+    auto file = std::make_shared<const ModelFile>(argv[1]);
+    topology = file->GetTopology();
+    mlp = std::make_unique<MatrixMlp>(std::move(file));
+  } else {
+    MLP loaded{topology};
+    loaded.Load(argv[1]);
+    topology = loaded.GetTopology();
+    mlp = std::make_unique<MatrixMlp>(topology);
+    const auto [weights, biases] = loaded.GetMlp();
+    mlp->SetMlp(weights, biases);
+  }
+
+  // Block the signals before the server threads start, so they inherit it
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  InferenceServer server{*mlp, topology, options};
+  server.Start();
+  std::cout << "Serving on "
+            << (options.socket_path.empty()
+                    ? "127.0.0.1:" + std::to_string(server.GetPort())
+                    : options.socket_path)
+            << ", press Ctrl+C to stop\n";
+  int signal;
+  sigwait(&signals, &signal);
+  server.Stop();
+  std::cout << server.GetStats().ToJson() << "\n";
+}
@@ -0,0 +1,97 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "mlp.h"
+
+using namespace s21;
+
+constexpr double kTargetAccuracy = 0.7;
+constexpr std::size_t kMaxEpochs = 10;
+
+struct Mode {
+  std::string name;
+  Config::TrainType type;
+  std::size_t threads;
+  std::size_t batch_size;
+  Config::OptimizerType optimizer = Config::OptimizerType::kSgd;
+  double learning_rate = 0.1;
+  Activation output = Activation::kSigmoid;
+  Config::Precision precision = Config::Precision::kDouble;
+};
+
+void TimeToAccuracy(const Mode& mode, const Dataset& train,
+                    const Dataset& test, const Tensor& weights,
+                    const Tensor& biases) {
+  MLP mlp{Topology{}};
+  mlp.UpdateMlp(weights, biases);
+  mlp.SetOutputActivation(mode.output);
+  mlp.SetPrecision(mode.precision);
+  mlp.SetTrainDataset(train);
+  mlp.SetTestDataset(test);
+  mlp.SetTrainType(mode.type);
+  mlp.SetThreads(mode.threads);
+  mlp.SetBatchSize(mode.batch_size);
+  mlp.SetOptimizer(mode.optimizer);
+  mlp.SetLearningRate(mode.learning_rate);
+  mlp.SetEpochs(1);
+  mlp.SetTestSample(0.2);
+
+  std::chrono::duration<double> elapsed{0};
+  for (std::size_t epoch = 1; epoch <= kMaxEpochs; ++epoch) {
+    auto start = std::chrono::high_resolution_clock::now();
+    mlp.Train();
+    elapsed += std::chrono::high_resolution_clock::now() - start;
+    const std::size_t allocations = mlp.GetMetrics().GetAllocations();
+    mlp.Test();
+    double accuracy = mlp.GetMetrics().GetAccuracy();
+    std::cout << mode.name << " epoch " << epoch << ": accuracy " << accuracy
+              << ", " << std::to_string(elapsed.count()) << " sec, "
+              << allocations << " allocations\n";
+    if (accuracy >= kTargetAccuracy) break;
+  }
+  std::cout << mode.name << " time to accuracy: "
+            << std::to_string(elapsed.count()) << " sec\n\n";
+}
+
+int main() {
+  system("clear");
+  std::cout << "\n"
+            << GetColor(Color::kCyan) << Align("TRAINING SPEED TEST")
+            << GetColor(Color::kEnd) << "\n\n";
+
+  Dataset train = ParseEmnist("../datasets/emnist-letters-train.csv");
+  Dataset test = ParseEmnist("../datasets/emnist-letters-test.csv");
+  const auto [weights, biases] = MLP{Topology{}}.GetMlp();
+  const std::size_t cores =
+      std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+  AllocationCounter::Enable(true);
+
+  std::vector<Mode> modes{
+      {"SGD", Config::TrainType::kTrain, 1, 1},
+      {"Hogwild x" + std::to_string(cores), Config::TrainType::kHogwild, cores,
+       1},
+      {"Data parallel x" + std::to_string(cores), Config::TrainType::kTrain,
+       cores, 32},
+      {"Pipeline x" + std::to_string(cores), Config::TrainType::kPipeline,
+       cores, 32},
+      {"SGD + momentum", Config::TrainType::kTrain, 1, 1,
+       Config::OptimizerType::kMomentum, 0.01},
+      {"SGD + Nesterov", Config::TrainType::kTrain, 1, 1,
+       Config::OptimizerType::kNesterov, 0.01},
+      {"Adam", Config::TrainType::kTrain, 1, 1, Config::OptimizerType::kAdam,
+       0.001},
+      {"Softmax + cross-entropy", Config::TrainType::kTrain, 1, 1,
+       Config::OptimizerType::kSgd, 0.01, Activation::kSoftmax},
+      {"Double precision, batch 32", Config::TrainType::kTrain, 1, 32},
+      {"Mixed precision, batch 32", Config::TrainType::kTrain, 1, 32,
+       Config::OptimizerType::kSgd, 0.1, Activation::kSigmoid,
+       Config::Precision::kMixed},
+  };
+  for (const Mode& mode : modes) {
+    TimeToAccuracy(mode, train, test, weights, biases);
+  }
+
+  std::cout << GetColor(Color::kCyan) << Align(" ") << GetColor(Color::kEnd)
+            << "\n\n";
+}
@@ -0,0 +1,50 @@
+#include <fstream>
+#include <iostream>
+
+#include "mlp.h"
+
+using namespace s21;
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cout << "Usage: " << argv[0]
+              << " <train> <validation> [grid|random] [trials] [output]\n";
+    return 1;
+  }
+  const std::string search = argc > 3 ? argv[3] : "grid";
+  const std::string output = argc > 5 ? argv[5] : "leaderboard";
+
+  std::cout << "Reading datasets...\n";
+  const Dataset train = ParseEmnist(argv[1]);
+  const Dataset validation = ParseEmnist(argv[2]);
+
+  SweepSpace space;
+  space.learning_rates = {0.005, 0.01, 0.05, 0.1};
+  space.hidden_sizes = {64, 128, 256};
+  space.hidden_counts = {1, 2, 3};
+  space.epochs = {9};
+  space.batch_sizes = {1, 32};
+  SweepOptions options;
+  options.search = search == "random" ? SweepOptions::Search::kRandom
+                                      : SweepOptions::Search::kGrid;
+  if (argc > 4) options.trials = std::stoul(argv[4]);
+
+  Sweep sweep{Topology{}, Config{}, space, options};
+  const Leaderboard leaderboard =
+      sweep.Run(train, validation, [](const SweepTrial& trial) {
+        std::cout << "Trial " << trial.id << " (rate " << trial.learning_rate
+                  << ", " << trial.hidden_count << "x" << trial.hidden_size
+                  << ", batch " << trial.batch_size << ") after "
+                  << trial.trained_epochs << " epochs: loss " << trial.loss
+                  << ", accuracy " << trial.accuracy << "\n";
+      });
+
+  std::ofstream(output + ".csv") << leaderboard.ToCsv();
+  std::ofstream(output + ".json") << leaderboard.ToJson();
+  if (!leaderboard.trials.empty()) {
+    const SweepTrial& best = leaderboard.trials.front();
+    std::cout << "Best: trial " << best.id << ", accuracy " << best.accuracy
+              << "\n";
+  }
+  std::cout << "Saved to " << output << ".csv and " << output << ".json\n";
+}
@@ -1,4 +1,8 @@
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include <iostream>
+#include <thread>
 
 #include "mlp.h"
 
@@ -24,7 +28,33 @@ int main() {
   // mlp.SetTestSample(0.2);
   // mlp.SetTrainType(Config::TrainType::kCrossValidation);
   std::cout << "\nStart training on " << mlp.GetEpochs() << " epochs...\n";
-  mlp.Train();
+  auto events = std::make_shared<EventChannel>();
+  mlp.SetEventChannel(events);
+  std::atomic<bool> done{false};
+  std::exception_ptr error;
+  std::thread trainer([&mlp, &done, &error] {
+    try {
+      mlp.Train();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    done = true;
+  });
+  auto print = [](const Event& event) {
+    if (event.type == Event::Type::kProgress) {
+      std::cout << "\rEpoch progress: " << event.value << "%" << std::flush;
+    } else if (event.type == Event::Type::kMetrics) {
+      std::cout << "\nEpoch loss: " << event.metrics->GetLoss() << "\n";
+    }
+  };
+  while (!done) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    events->Drain(print);
+  }
+  trainer.join();
+  events->Drain(print);
+  mlp.SetEventChannel(nullptr);
+  if (error) std::rethrow_exception(error);
   std::cout << "Start testing on " << mlp.GetTestSample() * 100
             << "% of test dataset...\n";
   mlp.Test();
@@ -5,10 +5,14 @@
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
       ui_(new Ui::MainWindow),
-      controller_(new s21::Controller) {
+      controller_(new s21::Controller),
+      events_(std::make_shared<s21::EventChannel>()) {
   ui_->setupUi(this);
   ui_->WidgetForPainting->SetWindow(this);
   graph_ = new Graph(ui_->graph);
+  controller_->SetEventChannel(events_);
+  event_timer_ = new QTimer(this);
+  event_timer_->start(kEventInterval);
 
   ConnectSignals();
 }
@@ -20,14 +24,7 @@ MainWindow::~MainWindow() {
 }
 
 void MainWindow::ConnectSignals() {
-  connect(this, &MainWindow::signalMetrics, this, &MainWindow::ExperimentOver);
-  connect(this, &MainWindow::signalMetrics, graph_, &Graph::Draw);
-  connect(this, &MainWindow::signalTestProgress, this,
-          &MainWindow::UpdateTestBar);
-  connect(this, &MainWindow::signalTrainProgress, this,
-          &MainWindow::UpdateTrainBar);
-  connect(this, &MainWindow::signalFullTrainProgress, this,
-          &MainWindow::UpdateFullTrainBar);
+  connect(event_timer_, &QTimer::timeout, this, &MainWindow::DrainEvents);
 
 
   connect(ui_->LoadWeights, SIGNAL(clicked()), this, SLOT(LoadWeightsClicked()));
@@ -157,13 +154,6 @@ void MainWindow::RunTestingClicked() {
     if (file_train_) {
       ui_->ProgressTraining->setValue(0);
       ui_->ProgressTrainingEpoch->setValue(0);
-
-      controller_->SetMFunc(
-          std::bind(&MainWindow::signalMetrics, this, std::placeholders::_1));
-      controller_->SetPFunc(std::bind(&MainWindow::signalTrainProgress, this,
-                                      std::placeholders::_1));
-      controller_->SetFPFunc(std::bind(&MainWindow::signalFullTrainProgress,
-                                       this, std::placeholders::_1));
       BlockButton(false);
       if (ui_->tabWidgetTraining->currentIndex() == 0) {
         graph_->SetRange(ui_->EpochNumber->currentText().toInt());
@@ -200,10 +190,6 @@ void MainWindow::RunExperimentClicked() {
   ClearExperimentLabel();
   try {
     if (file_experiment_) {
-      controller_->SetMFunc(
-          std::bind(&MainWindow::signalMetrics, this, std::placeholders::_1));
-      controller_->SetPFunc(std::bind(&MainWindow::signalTestProgress, this,
-                                      std::placeholders::_1));
       BlockButton(false);
       std::thread trd(
 
@@ -252,6 +238,28 @@ void MainWindow::UpdateFullTrainBar(int percent) {
   ui_->ProgressTrainingEpoch->setValue(percent);
 }
 
+// The model publishes progress and metrics without waiting for the GUI; the
+// timer drains them, at most one progress update of each bar per tick
+void MainWindow::DrainEvents() {
+  events_->Drain([this](const s21::Event &event) {
+    switch (event.type) {
+      case s21::Event::Type::kProgress:
+        UpdateTrainBar(static_cast<int>(event.value));
+        break;
+      case s21::Event::Type::kFullProgress:
+        UpdateFullTrainBar(static_cast<int>(event.value));
+        break;
+      case s21::Event::Type::kTestProgress:
+        UpdateTestBar(static_cast<int>(event.value));
+        break;
+      case s21::Event::Type::kMetrics:
+        ExperimentOver(*event.metrics);
+        graph_->Draw(*event.metrics);
+        break;
+    }
+  });
+}
+
 void MainWindow::BlockButton(bool state) {
   state_ = state;
   ui_->PerceptronTypeComboBox->setEnabled(state);
@@ -6,6 +6,7 @@
 #include <QLabel>
 #include <QMainWindow>
 #include <QMessageBox>
+#include <QTimer>
 #include <QVBoxLayout>
 #include <QVector>
 #include <QWidget>
@@ -50,6 +51,7 @@ class MainWindow : public QMainWindow {
   void UpdateTestBar(int percent);
   void UpdateTrainBar(int percent);
   void UpdateFullTrainBar(int percent);
+  void DrainEvents();
 
  private:
   Ui::MainWindow *ui_;
@@ -58,6 +60,8 @@ class MainWindow : public QMainWindow {
   Graph *graph_;
   bool file_experiment_ = 0, file_train_ = 0;
   bool state_ = true;
+  std::shared_ptr<s21::EventChannel> events_;
+  QTimer *event_timer_;
 
   void ConnectSignals();
   void ShowExeption(QString exept);
@@ -66,11 +70,7 @@ class MainWindow : public QMainWindow {
   void BlockButton(bool state);
   void closeEvent(QCloseEvent *event) override;
 
- signals:
-  void signalMetrics(s21::Metrics metrics);
-  void signalTrainProgress(int);
-  void signalFullTrainProgress(int);
-  void signalTestProgress(int);
+  static constexpr int kEventInterval = 50;
 };
 
 #endif  // MAINWINDOW_H